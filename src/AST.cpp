@@ -53,7 +53,7 @@ bool ParseTokenStream(TokenStream* stream) {
 	if (stream->index == stream->tokCount) {
 		ASTNode* node = stream->ast->addNode();
 		node->type = ANT_Root;
-		node->Root_value.topLevelStatements = topLevelStatements;
+		StealVector(&node->Root_value.topLevelStatements, &topLevelStatements);
 
 		return true;
 	}
@@ -194,27 +194,133 @@ bool ParseBoolLiteral(TokenStream* stream) {
 	return false;
 }
 
+static bool NextIsBinaryOperator(TokenStream* stream) {
+	stream->PushFrame();
+	int opIdx = -1;
+	bool isBinaryOp = ExpectAndEatOneOfWords(stream, binaryOperators, BNS_ARRAY_COUNT(binaryOperators), &opIdx);
+	stream->PopFrame();
+
+	return isBinaryOp;
+}
+
+struct BinaryOpChainEntry {
+	int opIdx;
+	ASTIndex prefixNode;
+	int precedence;
+};
+
+// Parses the whole 'a op b op c ...' chain in one loop, rather than recursing once per operator,
+// so machine-generated expressions aren't limited by the native stack. Precedence is resolved here
+// with an operator stack, which leaves FixUpOperators only the unary and array access cases.
 bool ParseBinaryOp(TokenStream* stream) {
 	PUSH_STREAM_FRAME(stream);
-	if (ParseSingleValue(stream)) {
-		ASTIndex left = stream->ast->GetCurrIdx();
+	// Most values aren't followed by an operator, so check before allocating anything
+	if (!ParseSingleValue(stream) || !NextIsBinaryOperator(stream)) {
+		return false;
+	}
+
+	Vector<ASTIndex> operands;
+	Vector<int> opIndices;
+	operands.PushBack(stream->ast->GetCurrIdx());
+
+	while (true) {
+		// Rolled back if the operand after it doesn't parse, leaving the chain up to here
+		stream->PushFrame();
+
 		int opIdx = -1;
-		if (ExpectAndEatOneOfWords(stream, binaryOperators, BNS_ARRAY_COUNT(binaryOperators), &opIdx)) {
-			if (ParseValue(stream)) {
-				ASTIndex right = stream->ast->GetCurrIdx();
+		if (!ExpectAndEatOneOfWords(stream, binaryOperators, BNS_ARRAY_COUNT(binaryOperators), &opIdx)) {
+			stream->PopFrame();
+			break;
+		}
+
+		// Only a single value can be followed by another operator,
+		// the last operand can also be a unary op, the same as in ParseValue
+		stream->PushFrame();
+		if (ParseSingleValue(stream) && NextIsBinaryOperator(stream)) {
+			stream->frames.PopBack();
+			stream->frames.PopBack();
+			operands.PushBack(stream->ast->GetCurrIdx());
+			opIndices.PushBack(opIdx);
+			continue;
+		}
+		stream->PopFrame();
+
+		if (ParseUnaryOp(stream) || ParseSingleValue(stream)) {
+			stream->frames.PopBack();
+			operands.PushBack(stream->ast->GetCurrIdx());
+			opIndices.PushBack(opIdx);
+		}
+		else {
+			stream->PopFrame();
+		}
+
+		break;
+	}
+
+	if (opIndices.count == 0) {
+		return false;
+	}
+
+	// Prefix unary ops go on the operator stack too, since they bind looser than '.'
+	// and so can take in more than the operand they were parsed with (e.g. '-a.b')
+	Vector<ASTIndex> valueStack;
+	Vector<BinaryOpChainEntry> opStack;
+	for (int i = 0; i <= opIndices.count; i++) {
+		ASTIndex operand = operands.data[i];
+		while (stream->ast->nodes.data[operand].type == ANT_UnaryOp && stream->ast->nodes.data[operand].UnaryOp_value.isPre) {
+			BinaryOpChainEntry prefixEntry = { -1, operand, unaryOpPrecedence };
+			opStack.PushBack(prefixEntry);
+			operand = stream->ast->nodes.data[operand].UnaryOp_value.val;
+		}
+		valueStack.PushBack(operand);
+
+		const BinaryOperator* opInfo = (i < opIndices.count) ? GetBinaryInfoForOp(binaryOperators[opIndices.data[i]]) : nullptr;
+		while (opStack.count > 0) {
+			BinaryOpChainEntry top = opStack.Back();
+			bool reduce = (opInfo == nullptr)
+				|| (top.precedence < opInfo->precedence)
+				|| (top.precedence == opInfo->precedence && opInfo->assoc == OA_Left);
+
+			if (!reduce) {
+				break;
+			}
+
+			opStack.PopBack();
+
+			ASTIndex right = valueStack.Back();
+			valueStack.PopBack();
+
+			if (top.prefixNode >= 0) {
+				// A fresh node keeps the root of the chain last, the parsed one is left unreferenced
+				ASTNode* node = stream->ast->addNode();
+				node->type = ANT_UnaryOp;
+				node->UnaryOp_value = stream->ast->nodes.data[top.prefixNode].UnaryOp_value;
+				node->UnaryOp_value.val = right;
+
+				valueStack.PushBack(stream->ast->GetCurrIdx());
+			}
+			else {
+				ASTIndex left = valueStack.Back();
+				valueStack.PopBack();
 
 				ASTNode* node = stream->ast->addNode();
 				node->type = ANT_BinaryOp;
-				node->BinaryOp_value.op = binaryOperators[opIdx];
+				node->BinaryOp_value.op = binaryOperators[top.opIdx];
 				node->BinaryOp_value.left = left;
 				node->BinaryOp_value.right = right;
 
-				FRAME_SUCCES();
+				valueStack.PushBack(stream->ast->GetCurrIdx());
 			}
 		}
+
+		if (opInfo != nullptr) {
+			BinaryOpChainEntry opEntry = { opIndices.data[i], -1, opInfo->precedence };
+			opStack.PushBack(opEntry);
+		}
 	}
 
-	return false;
+	ASSERT(valueStack.count == 1);
+	FRAME_SUCCES();
 }
 
 bool ParseUnaryOp(TokenStream* stream) {
@@ -384,6 +490,8 @@ bool ParseArrayAccess(TokenStream* stream) {
 bool ParseType(TokenStream* stream) {
 	PUSH_STREAM_FRAME(stream);
 
+	bool isSoA = ExpectAndEatWord(stream, "soa");
+
 	if (ParseGenericType(stream) || ParseIdentifier(stream)) {
 		ASTIndex identIdx = stream->ast->GetCurrIdx();
 
@@ -409,6 +517,7 @@ bool ParseType(TokenStream* stream) {
 						node->type = ANT_TypeArray;
 						node->TypeArray_value.childType = currIdx;
 						node->TypeArray_value.length = arrLenIdx;
+						node->TypeArray_value.isSoA = false;
 					}
 					// deal_with_it.gif
 					else { success = false; break; }
@@ -418,6 +527,7 @@ bool ParseType(TokenStream* stream) {
 					node->type = ANT_TypeArray;
 					node->TypeArray_value.childType = currIdx;
 					node->TypeArray_value.length = ARRAY_DYNAMIC_LEN;
+					node->TypeArray_value.isSoA = false;
 				}
 				else { success = false; break; }
 			}
@@ -426,6 +536,17 @@ bool ParseType(TokenStream* stream) {
 			}
 		}
 
+		if (success && isSoA) {
+			// The annotation applies to the outermost array
+			ASTNode* outer = &stream->ast->nodes.Back();
+			if (outer->type == ANT_TypeArray) {
+				outer->TypeArray_value.isSoA = true;
+			}
+			else {
+				success = false;
+			}
+		}
+
 		if (success) {
 			FRAME_SUCCES();
 		}
@@ -441,7 +562,8 @@ bool ParseGenericType(TokenStream* stream) {
 		if (ExpectAndEatWord(stream, "(")) {
 			Vector<ASTIndex> argIndices;
 			while (true) {
-				if (ParseValue(stream) || ParseType(stream)) {
+				// Types first, since e.g. 'int^' would otherwise parse as a dereference
+				if (ParseType(stream) || ParseValue(stream)) {
 					argIndices.PushBack(stream->ast->GetCurrIdx());
 
 					if (ExpectAndEatWord(stream, ",")) {
@@ -463,7 +585,7 @@ bool ParseGenericType(TokenStream* stream) {
 				ASTNode* node = stream->ast->addNode();
 				node->type = ANT_TypeGeneric;
 				node->TypeGeneric_value.childType = callIdx;
-				node->TypeGeneric_value.args = argIndices;
+				StealVector(&node->TypeGeneric_value.args, &argIndices);
 
 				FRAME_SUCCES();
 			}
@@ -502,7 +624,7 @@ bool ParseFunctionCall(TokenStream* stream) {
 				ASTNode* node = stream->ast->addNode();
 				node->type = ANT_FunctionCall;
 				node->FunctionCall_value.func = callIdx;
-				node->FunctionCall_value.args = argIndices;
+				StealVector(&node->FunctionCall_value.args, &argIndices);
 
 				FRAME_SUCCES();
 			}
@@ -537,7 +659,7 @@ bool CheckNextWord(TokenStream* stream, const char* str) {
 	return false;
 }
 
-bool ExpectAndEatOneOfWords(TokenStream* stream, const char** strs, const int count, int* outIdx) {
+bool ExpectAndEatOneOfWords(TokenStream* stream, const char* const* strs, const int count, int* outIdx) {
 	if (stream->index >= stream->tokCount - 1) {
 		return false;
 	}
@@ -553,7 +675,7 @@ bool ExpectAndEatOneOfWords(TokenStream* stream, const char** strs, const int co
 	return false;
 }
 
-const char* reservedWords[] = {
+const char* const reservedWords[] = {
 	"if",
 	"while",
 	"return"
@@ -660,7 +782,7 @@ bool ParseScope(TokenStream* stream) {
 		if (ExpectAndEatWord(stream, "}")) {
 			ASTNode* node = stream->ast->addNode();
 			node->type = ANT_Scope;
-			node->Scope_value.statements = statements;
+			StealVector(&node->Scope_value.statements, &statements);
 
 			FRAME_SUCCES();
 		}
@@ -736,8 +858,27 @@ bool ParseStructDefinition(TokenStream* stream) {
 	if (ParseIdentifier(stream)) {
 		ASTIndex structNameIdx = stream->ast->GetCurrIdx();
 		Vector<ASTIndex> fieldIndices;
+		Vector<ASTIndex> genericParamIndices;
 		if (ExpectAndEatWord(stream, "::")) {
 			if (ExpectAndEatWord(stream, "struct")) {
+				if (ExpectAndEatWord(stream, "(")) {
+					while (true) {
+						if (ParseVariableDecl(stream)) {
+							genericParamIndices.PushBack(stream->ast->GetCurrIdx());
+						}
+						else {
+							return false;
+						}
+
+						if (ExpectAndEatWord(stream, ")")) {
+							break;
+						}
+						else if (!ExpectAndEatWord(stream, ",")) {
+							return false;
+						}
+					}
+				}
+
 				if (ExpectAndEatWord(stream, "{")) {
 					while (true) {
 						if (ParseVariableDecl(stream)) {
@@ -756,7 +897,8 @@ bool ParseStructDefinition(TokenStream* stream) {
 					ASTNode* node = stream->ast->addNode();
 					node->type = ANT_StructDefinition;
 					node->StructDefinition_value.structName = structNameIdx;
-					node->StructDefinition_value.fieldDecls = fieldIndices;
+					StealVector(&node->StructDefinition_value.fieldDecls, &fieldIndices);
+					StealVector(&node->StructDefinition_value.genericParams, &genericParamIndices);
 
 					FRAME_SUCCES();
 				}
@@ -819,7 +961,7 @@ bool ParseFunctionDefinition(TokenStream* stream) {
 									ASTNode* node = stream->ast->addNode();
 									node->type = ANT_FunctionDefinition;
 									node->FunctionDefinition_value.name = funcNameIdx;
-									node->FunctionDefinition_value.params = parameters;
+									StealVector(&node->FunctionDefinition_value.params, &parameters);
 									node->FunctionDefinition_value.returnType = retType;
 									node->FunctionDefinition_value.bodyScope = bodyScope;
 
@@ -836,14 +978,51 @@ bool ParseFunctionDefinition(TokenStream* stream) {
 	return false;
 }
 
+// Past this, the depth is printed as a number so deep trees don't print quadratically many spaces
+#define MAX_DISPLAY_INDENTATION 32
+
+static void PrintIndentation(int indentation) {
+	int spaceCount = (indentation < MAX_DISPLAY_INDENTATION) ? indentation : MAX_DISPLAY_INDENTATION;
+	for (int i = 0; i < spaceCount; i++) {
+		printf("    ");
+	}
+
+	if (indentation > MAX_DISPLAY_INDENTATION) {
+		printf("[%d] ", indentation);
+	}
+}
+
+struct DisplayTreeItem {
+	ASTIndex node;
+	int indentation;
+};
+
 void DisplayTree(ASTNode* node, int indentation /*= 0*/) {
-#define INDENT(x) for (int i = 0; i < x; i++) {printf("    ");}
+#define INDENT(x) PrintIndentation(x)
 	switch (node->type) {
 	case ANT_BinaryOp: {
-		INDENT(indentation);
-		printf("Binary Op: '%s'\n", node->BinaryOp_value.op);
-		DisplayTree(&node->ast->nodes.data[node->BinaryOp_value.left], indentation + 1);
-		DisplayTree(&node->ast->nodes.data[node->BinaryOp_value.right], indentation + 1);
+		// Chains of binary ops can be as long as the input, so they're walked with an explicit stack
+		Vector<DisplayTreeItem> stack;
+		DisplayTreeItem rootItem = { node->GetIndex(), indentation };
+		stack.PushBack(rootItem);
+		while (stack.count > 0) {
+			DisplayTreeItem item = stack.Back();
+			stack.PopBack();
+
+			ASTNode* curr = &node->ast->nodes.data[item.node];
+			if (curr->type == ANT_BinaryOp) {
+				INDENT(item.indentation);
+				printf("Binary Op: '%s'\n", curr->BinaryOp_value.op);
+
+				DisplayTreeItem rightItem = { curr->BinaryOp_value.right, item.indentation + 1 };
+				DisplayTreeItem leftItem = { curr->BinaryOp_value.left, item.indentation + 1 };
+				stack.PushBack(rightItem);
+				stack.PushBack(leftItem);
+			}
+			else {
+				DisplayTree(curr, item.indentation);
+			}
+		}
 	} break;
 
 	case ANT_IntegerLiteral: {
@@ -905,8 +1084,11 @@ void DisplayTree(ASTNode* node, int indentation /*= 0*/) {
 		ASTNode* var = &node->ast->nodes.data[node->VariableAssign_value.var];
 
 		INDENT(indentation);
-		printf("Assign to var: '%.*s'\n", BNS_LEN_START(var->Identifier_value.name));
+		printf("Assign to:\n");
+		DisplayTree(var, indentation + 1);
 
+		INDENT(indentation);
+		printf("Value:\n");
 		ASTNode* val = &node->ast->nodes.data[node->VariableAssign_value.val];
 		DisplayTree(val, indentation + 1);
 	} break;
@@ -1003,14 +1185,19 @@ void DisplayTree(ASTNode* node, int indentation /*= 0*/) {
 
 	case ANT_TypeSimple: {
 		ASTNode* type = &node->ast->nodes.data[node->TypeSimple_value.name];
-		INDENT(indentation);
-		printf("Type '%.*s'\n", BNS_LEN_START(type->Identifier_value.name));
+		if (type->type == ANT_TypeGeneric) {
+			DisplayTree(type, indentation);
+		}
+		else {
+			INDENT(indentation);
+			printf("Type '%.*s'\n", BNS_LEN_START(type->Identifier_value.name));
+		}
 	} break;
 
 	case ANT_TypeArray: {
 		ASTNode* subtype = &node->ast->nodes.data[node->TypeArray_value.childType];
 		INDENT(indentation);
-		printf("Type Array\n");
+		printf("Type Array%s\n", node->TypeArray_value.isSoA ? " (SoA)" : "");
 
 		INDENT(indentation);
 		printf("Array len:\n");
@@ -1059,6 +1246,15 @@ void DisplayTree(ASTNode* node, int indentation /*= 0*/) {
 			DisplayTree(name, indentation + 1);
 		}
 
+		if (node->StructDefinition_value.genericParams.count > 0) {
+			INDENT(indentation);
+			printf("Generic params:\n");
+			for (int i = 0; i < node->StructDefinition_value.genericParams.count; i++) {
+				ASTNode* param = &node->ast->nodes.data[node->StructDefinition_value.genericParams.data[i]];
+				DisplayTree(param, indentation + 1);
+			}
+		}
+
 		INDENT(indentation);
 		printf("Fields:\n");
 		for (int i = 0; i < node->StructDefinition_value.fieldDecls.count; i++) {
@@ -1120,138 +1316,88 @@ void DisplayTree(ASTNode* node, int indentation /*= 0*/) {
 	}
 }
 
-void SwapBinaryOperators(ASTNode* parent, ASTNode* child) {
-	ASSERT(parent->type == ANT_BinaryOp);
-	ASSERT(child->type == ANT_BinaryOp);
-
-	ASTIndex childIdx = child->GetIndex();
-	if (parent->BinaryOp_value.left == childIdx) {
-		{
-			AST_BinaryOp tmp = parent->BinaryOp_value;
-			parent->BinaryOp_value = child->BinaryOp_value;
-			child->BinaryOp_value = tmp;
-		}
-
-		ASTIndex parentRight = parent->BinaryOp_value.right;
-		parent->BinaryOp_value.right = child->GetIndex();
-		child->BinaryOp_value.left = parentRight;
-	}
-	else if (parent->BinaryOp_value.right == childIdx) {
-		{
-			AST_BinaryOp tmp = parent->BinaryOp_value;
-			parent->BinaryOp_value = child->BinaryOp_value;
-			child->BinaryOp_value = tmp;
-		}
-
-		ASTIndex parentLeft = parent->BinaryOp_value.left;
-		parent->BinaryOp_value.left = child->GetIndex();
-		child->BinaryOp_value.right = parentLeft;
-	}
-	else {
-		ASSERT(false);
-	}
-}
-
-void FixUpOperators(ASTNode* node, ASTNode* root = nullptr) {
-	switch (node->type) {
-	case ANT_BinaryOp: {
+// Binary precedence is already resolved by ParseBinaryOp, what's left is rotating a binary op
+// into a unary op or array access that binds looser than it (e.g. '-a.b' or 'a.b[0]').
+// The rotated op moves down into its old operand's slot, so keep going from there.
+static void RotateBinaryOpOperands(ASTNode* node) {
+	while (node->type == ANT_BinaryOp) {
+		const BinaryOperator* opInfo = GetBinaryInfoForOp(node->BinaryOp_value.op);
 		ASTNode* left = &node->ast->nodes.data[node->BinaryOp_value.left];
 		ASTNode* right = &node->ast->nodes.data[node->BinaryOp_value.right];
 
-		FixUpOperators(left);
-		FixUpOperators(right);
+		if (left->type == ANT_UnaryOp && left->UnaryOp_value.isPre && opInfo->precedence < unaryOpPrecedence) {
+			AST_BinaryOp tmp = node->BinaryOp_value;
+			node->UnaryOp_value = left->UnaryOp_value;
+			left->BinaryOp_value = tmp;
 
-		const BinaryOperator* opInfo = GetBinaryInfoForOp(node->BinaryOp_value.op);
+			left->BinaryOp_value.left = node->UnaryOp_value.val;
+			node->UnaryOp_value.val = left->GetIndex();
 
-		int idx = node->GetIndex();
+			node->type = ANT_UnaryOp;
+			left->type = ANT_BinaryOp;
 
-		bool didFixup = false;
-
-		if (left->type == ANT_BinaryOp) {
-			// If the precedence is higher
-			const BinaryOperator* leftInfo = GetBinaryInfoForOp(left->BinaryOp_value.op);
-			if (opInfo->precedence < leftInfo->precedence) {
-				SwapBinaryOperators(node, left);
-				FixUpOperators(node, root);
-				didFixup = true;
-			}
-			else {
-				FixUpOperators(left, root);
-			}
+			node = left;
 		}
-		else if (left->type == ANT_UnaryOp && left->UnaryOp_value.isPre) {
-			if (opInfo->precedence < unaryOpPrecedence) {
-				AST_BinaryOp tmp = node->BinaryOp_value;
-				node->UnaryOp_value = left->UnaryOp_value;
-				left->BinaryOp_value = tmp;
-				
-				left->BinaryOp_value.left = node->UnaryOp_value.val;
-				node->UnaryOp_value.val = left->GetIndex();
+		else if (right->type == ANT_UnaryOp && !right->UnaryOp_value.isPre && opInfo->precedence < unaryOpPrecedence) {
+			AST_BinaryOp tmp = node->BinaryOp_value;
+			node->UnaryOp_value = right->UnaryOp_value;
+			right->BinaryOp_value = tmp;
 
-				node->type = ANT_UnaryOp;
-				left->type = ANT_BinaryOp;
+			right->BinaryOp_value.right = node->UnaryOp_value.val;
+			node->UnaryOp_value.val = right->GetIndex();
 
-				didFixup = true;
-				node = left;
-				opInfo = GetBinaryInfoForOp(node->BinaryOp_value.op);
-			}
-		}
+			node->type = ANT_UnaryOp;
+			right->type = ANT_BinaryOp;
 
-		if (right->type == ANT_BinaryOp) {
-			// If the precedence is higher, or its equal and left-assoc (so most)
-			const BinaryOperator* rightInfo = GetBinaryInfoForOp(right->BinaryOp_value.op);
-			if (opInfo->precedence < rightInfo->precedence) {
-				ASTIndex oldNodeIdx = idx;
-				SwapBinaryOperators(node, right);
-				ASTNode* oldNode = &node->ast->nodes.data[oldNodeIdx];
-				FixUpOperators(oldNode, root);
-			}
-			else if (opInfo->precedence == rightInfo->precedence && opInfo->assoc == OA_Left) {
-				SwapBinaryOperators(node, right);
-				FixUpOperators(node, root);
-				didFixup = true;
-			}
-			else {
-				FixUpOperators(right, root);
-			}
+			node = right;
 		}
-		else if (right->type == ANT_UnaryOp && !right->UnaryOp_value.isPre) {
-			if (opInfo->precedence < unaryOpPrecedence) {
-				AST_BinaryOp tmp = node->BinaryOp_value;
-				node->UnaryOp_value = right->UnaryOp_value;
-				right->BinaryOp_value = tmp;
+		else if (right->type == ANT_ArrayAccess && opInfo->precedence <= arrayOpPrecedence) {
+			AST_BinaryOp nodeTmp = node->BinaryOp_value;
+			AST_ArrayAccess rightTmp = right->ArrayAccess_value;
+			nodeTmp.right = rightTmp.arr;
+			rightTmp.arr = right->GetIndex();
 
-				right->BinaryOp_value.right = node->UnaryOp_value.val;
-				node->UnaryOp_value.val = right->GetIndex();
+			node->ArrayAccess_value = rightTmp;
+			node->type = ANT_ArrayAccess;
+			right->BinaryOp_value = nodeTmp;
+			right->type = ANT_BinaryOp;
 
-				node->type = ANT_UnaryOp;
-				right->type = ANT_BinaryOp;
-				didFixup = true;
-				node = right;
-			}
+			node = right;
 		}
-		else if (right->type == ANT_ArrayAccess) {
-			if (opInfo->precedence <= arrayOpPrecedence) {
-				AST_BinaryOp nodeTmp = node->BinaryOp_value;
-				AST_ArrayAccess rightTmp = right->ArrayAccess_value;
-				nodeTmp.right = rightTmp.arr;
-				rightTmp.arr = right->GetIndex();
-
-				node->ArrayAccess_value = rightTmp;
-				node->type = ANT_ArrayAccess;
-				right->BinaryOp_value = nodeTmp;
-				right->type = ANT_BinaryOp;
+		else {
+			break;
+		}
+	}
+}
 
-				didFixup = true;
+void FixUpOperators(ASTNode* node, ASTNode* root = nullptr) {
+	switch (node->type) {
+	case ANT_BinaryOp: {
+		// Chains of binary ops can be as long as the input, so they're walked with an explicit stack.
+		// Every op in the chain comes after its parent, so going backwards rotates operands first
+		Vector<ASTIndex> chain;
+		Vector<ASTIndex> stack;
+		stack.PushBack(node->GetIndex());
+		while (stack.count > 0) {
+			ASTIndex idx = stack.Back();
+			stack.PopBack();
+			chain.PushBack(idx);
+
+			ASTNode* binOp = &node->ast->nodes.data[idx];
+			ASTIndex operands[2] = { binOp->BinaryOp_value.left, binOp->BinaryOp_value.right };
+			for (int i = 0; i < 2; i++) {
+				ASTNode* operand = &node->ast->nodes.data[operands[i]];
+				if (operand->type == ANT_BinaryOp) {
+					stack.PushBack(operands[i]);
+				}
+				else {
+					FixUpOperators(operand, root);
+				}
 			}
 		}
 
-
-		if (didFixup) {
-			FixUpOperators(&node->ast->nodes.data[idx], root);
-
-			if (opInfo->precedence < unaryOpPrecedence) {
-			}
+		for (int i = chain.count - 1; i >= 0; i--) {
+			RotateBinaryOpOperands(&node->ast->nodes.data[chain.data[i]]);
 		}
 	} break;
 
@@ -1317,6 +1463,9 @@ void FixUpOperators(ASTNode* node, ASTNode* root = nullptr) {
 	} break;
 
 	case ANT_VariableAssign: {
+		ASTNode* var = &node->ast->nodes.data[node->VariableAssign_value.var];
+		FixUpOperators(var, root);
+
 		ASTNode* val = &node->ast->nodes.data[node->VariableAssign_value.val];
 		FixUpOperators(val, root);
 	} break;
@@ -1442,3 +1591,136 @@ void FixUpOperators(ASTNode* node, ASTNode* root = nullptr) {
 	}
 }
 
+
+void GetChildNodes(ASTNode* node, Vector<ASTIndex>* outChildren) {
+	switch (node->type) {
+	case ANT_BinaryOp: {
+		outChildren->PushBack(node->BinaryOp_value.left);
+		outChildren->PushBack(node->BinaryOp_value.right);
+	} break;
+
+	case ANT_UnaryOp: {
+		outChildren->PushBack(node->UnaryOp_value.val);
+	} break;
+
+	case ANT_Parentheses: {
+		outChildren->PushBack(node->Parentheses_value.val);
+	} break;
+
+	case ANT_Statement: {
+		outChildren->PushBack(node->Statement_value.root);
+	} break;
+
+	case ANT_ReturnStatement: {
+		outChildren->PushBack(node->ReturnStatement_value.retVal);
+	} break;
+
+	case ANT_FieldAccess: {
+		outChildren->PushBack(node->FieldAccess_value.val);
+		outChildren->PushBack(node->FieldAccess_value.field);
+	} break;
+
+	case ANT_ArrayAccess: {
+		outChildren->PushBack(node->ArrayAccess_value.arr);
+		outChildren->PushBack(node->ArrayAccess_value.index);
+	} break;
+
+	case ANT_FunctionCall: {
+		outChildren->PushBack(node->FunctionCall_value.func);
+		BNS_VEC_FOREACH(node->FunctionCall_value.args) {
+			outChildren->PushBack(*ptr);
+		}
+	} break;
+
+	case ANT_VariableAssign: {
+		outChildren->PushBack(node->VariableAssign_value.var);
+		outChildren->PushBack(node->VariableAssign_value.val);
+	} break;
+
+	case ANT_VariableDecl: {
+		outChildren->PushBack(node->VariableDecl_value.varName);
+		outChildren->PushBack(node->VariableDecl_value.type);
+		if (node->VariableDecl_value.initValue >= 0) {
+			outChildren->PushBack(node->VariableDecl_value.initValue);
+		}
+	} break;
+
+	case ANT_TypeSimple: {
+		outChildren->PushBack(node->TypeSimple_value.name);
+	} break;
+
+	case ANT_TypePointer: {
+		outChildren->PushBack(node->TypePointer_value.childType);
+	} break;
+
+	case ANT_TypeArray: {
+		outChildren->PushBack(node->TypeArray_value.childType);
+		if (node->TypeArray_value.length != ARRAY_DYNAMIC_LEN) {
+			outChildren->PushBack(node->TypeArray_value.length);
+		}
+	} break;
+
+	case ANT_TypeGeneric: {
+		outChildren->PushBack(node->TypeGeneric_value.childType);
+		BNS_VEC_FOREACH(node->TypeGeneric_value.args) {
+			outChildren->PushBack(*ptr);
+		}
+	} break;
+
+	case ANT_Scope: {
+		BNS_VEC_FOREACH(node->Scope_value.statements) {
+			outChildren->PushBack(*ptr);
+		}
+	} break;
+
+	case ANT_IfStatement: {
+		outChildren->PushBack(node->IfStatement_value.condition);
+		outChildren->PushBack(node->IfStatement_value.bodyScope);
+	} break;
+
+	case ANT_StructDefinition: {
+		outChildren->PushBack(node->StructDefinition_value.structName);
+		BNS_VEC_FOREACH(node->StructDefinition_value.genericParams) {
+			outChildren->PushBack(*ptr);
+		}
+		BNS_VEC_FOREACH(node->StructDefinition_value.fieldDecls) {
+			outChildren->PushBack(*ptr);
+		}
+	} break;
+
+	case ANT_FunctionDefinition: {
+		outChildren->PushBack(node->FunctionDefinition_value.name);
+		BNS_VEC_FOREACH(node->FunctionDefinition_value.params) {
+			outChildren->PushBack(*ptr);
+		}
+		outChildren->PushBack(node->FunctionDefinition_value.returnType);
+		outChildren->PushBack(node->FunctionDefinition_value.bodyScope);
+	} break;
+
+	case ANT_Root: {
+		BNS_VEC_FOREACH(node->Root_value.topLevelStatements) {
+			outChildren->PushBack(*ptr);
+		}
+	} break;
+
+	default: {
+		// Leaf nodes (literals, identifiers) have no children
+	} break;
+	}
+}
+
+int CountASTNodes(ASTNode* node) {
+	int count = 0;
+
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(node->GetIndex());
+	while (toVisit.count > 0) {
+		ASTIndex idx = toVisit.Back();
+		toVisit.PopBack();
+		count++;
+
+		GetChildNodes(&node->ast->nodes.data[idx], &toVisit);
+	}
+
+	return count;
+}
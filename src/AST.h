@@ -39,6 +39,24 @@ enum ASTNodeType {
 
 typedef int ASTIndex;
 
+// Hands src's elements to dst without copying them, leaving src empty.
+// Child lists are built up in locals while parsing and then given to their node this way
+template<typename T>
+void StealVector(Vector<T>* dst, Vector<T>* src) {
+	dst->Clear();
+
+	T* dstData = dst->data;
+	int dstCapacity = dst->capacity;
+
+	dst->data = src->data;
+	dst->count = src->count;
+	dst->capacity = src->capacity;
+
+	src->data = dstData;
+	src->count = 0;
+	src->capacity = dstCapacity;
+}
+
 struct AST_FunctionDefinition {
 	ASTIndex name;
 	Vector<ASTIndex> params;
@@ -85,6 +103,8 @@ struct AST_TypeSimple{
 struct AST_TypeArray{
 	ASTIndex childType;
 	ASTIndex length;
+	// Declared with the 'soa' annotation, e.g. 'pts: soa vec3[256];'
+	bool isSoA;
 };
 
 struct AST_TypeGeneric{
@@ -160,6 +180,8 @@ struct AST_Parentheses {
 struct AST_StructDefinition {
 	ASTIndex structName;
 	Vector<ASTIndex> fieldDecls;
+	// Declarations like 'T : Type', for generic structs such as 'Vec :: struct(T : Type) {...}'
+	Vector<ASTIndex> genericParams;
 };
 
 struct AST_Root {
@@ -330,7 +352,7 @@ bool ParseArrayAccess(TokenStream* stream);
 
 bool CheckNextWord(TokenStream* stream, const char* str);
 bool ExpectAndEatWord(TokenStream* stream, const char* str);
-bool ExpectAndEatOneOfWords(TokenStream* stream, const char** strs, const int count, int* outIdx);
+bool ExpectAndEatOneOfWords(TokenStream* stream, const char* const* strs, const int count, int* outIdx);
 
 inline bool IsAlpha(char c) {
 	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
@@ -361,11 +383,11 @@ const BinaryOperator binOpInfo[] = {
 	{ "<=", OA_Left, 9 },
 	{ "<",  OA_Left, 9 },
 	{ ">=", OA_Left, 9 },
-	{ ".",  OA_Left, 9 },
+	{ ">",  OA_Left, 9 },
 };
 
 
-const char* binaryOperators[] = {
+const char* const binaryOperators[] = {
 	"*", "-", "+", "/", ".", "==", "<=", "<", ">", ">="
 };
 
@@ -380,7 +402,7 @@ struct UnaryOperator {
 	UnaryOperatorPos pos;
 };
 
-UnaryOperator unOpInfo[] = {
+const UnaryOperator unOpInfo[] = {
 	{ "!",  UOP_Pre },
 	{ "-",  UOP_Pre },
 	{ "^",  UOP_Both },
@@ -388,7 +410,7 @@ UnaryOperator unOpInfo[] = {
 	{ "--", UOP_Post }
 };
 
-const char* unaryOperators[] = {
+const char* const unaryOperators[] = {
 	"!", "-", "^", "++", "--"
 };
 
@@ -400,4 +422,10 @@ const int arrayOpPrecedence = 2;
 
 void DisplayTree(ASTNode* node, int indentation = 0);
 
+// Appends the indices of all direct children of node (in source order)
+void GetChildNodes(ASTNode* node, Vector<ASTIndex>* outChildren);
+
+// Number of nodes in the subtree rooted at node, including itself
+int CountASTNodes(ASTNode* node);
+
 #endif
\ No newline at end of file
@@ -1,20 +1,248 @@
 #include "backend.h"
 
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void OutputDeclaratorToCCode(ASTNode* typeNode, ASTNode* nameNode, SemanticContext* sc, FILE* fileHandle, int outerLen = ARRAY_DYNAMIC_LEN);
+
+// Work stack entry for walking binary op chains, either visiting a node or emitting its operator
+struct BinaryOpWorkItem {
+	ASTIndex node;
+	bool emitOp;
+};
+
+TypeIndex GetSliceStructDependency(TypeIndex sliceType, SemanticContext* sc);
+
+static void OutputSliceTypedefs(SemanticContext* sc, int afterStructIndex, FILE* fileHandle);
+
+// Structs have to be defined before anything that holds them by value, including arrays of them
+TypeIndex GetByValueStructDependency(TypeIndex typeIdx, SemanticContext* sc) {
+	// Fields whose type semantics couldn't resolve have already been reported
+	if (typeIdx < 0) {
+		return -1;
+	}
+
+	while (sc->knownTypes.data[typeIdx].type == TypeInfo::UE_ArrayTypeInfo) {
+		const ArrayTypeInfo& arrInfo = sc->knownTypes.data[typeIdx].AsArrayTypeInfo();
+		if (arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+			return GetSliceStructDependency(typeIdx, sc);
+		}
+
+		typeIdx = arrInfo.subType;
+	}
+
+	return (sc->knownTypes.data[typeIdx].type == TypeInfo::UE_StructTypeInfo) ? typeIdx : -1;
+}
+
+// Slices only point at their elements, but C can't declare a pointer to an array of an incomplete
+// struct, so a slice of arrays of structs has to wait for the struct. Slices of those slices wait too
+TypeIndex GetSliceStructDependency(TypeIndex sliceType, SemanticContext* sc) {
+	TypeIndex elemType = sc->knownTypes.data[sliceType].AsArrayTypeInfo().subType;
+	if (sc->knownTypes.data[elemType].type != TypeInfo::UE_ArrayTypeInfo) {
+		return -1;
+	}
+
+	return GetByValueStructDependency(elemType, sc);
+}
+
+void OutputMangledTypeName(TypeIndex typeIdx, SemanticContext* sc, FILE* fileHandle);
+
+// Instances of a generic get its name followed by their arguments, e.g. 'Pair_int_float'
+void OutputStructName(StructDef* def, SemanticContext* sc, FILE* fileHandle) {
+	fprintf(fileHandle, "%.*s", BNS_LEN_START(def->name));
+	BNS_VEC_FOREACH(def->genericArgs) {
+		fprintf(fileHandle, "_");
+		OutputMangledTypeName(*ptr, sc, fileHandle);
+	}
+}
+
+void OutputMangledTypeName(TypeIndex typeIdx, SemanticContext* sc, FILE* fileHandle) {
+	const TypeInfo& info = sc->knownTypes.data[typeIdx];
+	if (info.type == TypeInfo::UE_BuiltinTypeInfo) {
+		fprintf(fileHandle, "%s", info.AsBuiltinTypeInfo().name);
+	}
+	else if (info.type == TypeInfo::UE_StructTypeInfo) {
+		OutputStructName(&sc->definedStructs.data[info.AsStructTypeInfo().index], sc, fileHandle);
+	}
+	else if (info.type == TypeInfo::UE_PointerTypeInfo) {
+		OutputMangledTypeName(info.AsPointerTypeInfo().subType, sc, fileHandle);
+		fprintf(fileHandle, "_ptr");
+	}
+	else if (info.type == TypeInfo::UE_ArrayTypeInfo) {
+		const ArrayTypeInfo& arrInfo = info.AsArrayTypeInfo();
+		OutputMangledTypeName(arrInfo.subType, sc, fileHandle);
+		if (arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+			fprintf(fileHandle, "_arr");
+		}
+		else {
+			fprintf(fileHandle, arrInfo.isSoA ? "_soa%d" : "_arr%d", arrInfo.arrayLen);
+		}
+	}
+}
+
+void OutputSoAContainerName(const ArrayTypeInfo& arrInfo, SemanticContext* sc, FILE* fileHandle) {
+	const StructTypeInfo& structInfo = sc->knownTypes.data[arrInfo.subType].AsStructTypeInfo();
+	fprintf(fileHandle, "struct ");
+	OutputStructName(&sc->definedStructs.data[structInfo.index], sc, fileHandle);
+	fprintf(fileHandle, "_soa%d", arrInfo.arrayLen);
+}
+
+bool IsSliceType(TypeIndex typeIdx, SemanticContext* sc) {
+	const TypeInfo& info = sc->knownTypes.data[typeIdx];
+	return info.type == TypeInfo::UE_ArrayTypeInfo && !info.AsArrayTypeInfo().isSoA
+		&& info.AsArrayTypeInfo().arrayLen == ARRAY_DYNAMIC_LEN;
+}
+
+static bool IsFixedArrayType(TypeIndex typeIdx, SemanticContext* sc) {
+	const TypeInfo& info = sc->knownTypes.data[typeIdx];
+	return info.type == TypeInfo::UE_ArrayTypeInfo && !info.AsArrayTypeInfo().isSoA
+		&& info.AsArrayTypeInfo().arrayLen != ARRAY_DYNAMIC_LEN;
+}
+
+void OutputSliceTypeName(TypeIndex sliceType, SemanticContext* sc, FILE* fileHandle) {
+	fprintf(fileHandle, "slice_");
+	OutputMangledTypeName(sc->knownTypes.data[sliceType].AsArrayTypeInfo().subType, sc, fileHandle);
+}
+
+// Same as writing out a type node, but from its resolved type
+void OutputTypeIndexToCCode(TypeIndex typeIdx, SemanticContext* sc, FILE* fileHandle) {
+	const TypeInfo& info = sc->knownTypes.data[typeIdx];
+	if (info.type == TypeInfo::UE_BuiltinTypeInfo) {
+		fprintf(fileHandle, "%s", info.AsBuiltinTypeInfo().name);
+	}
+	else if (info.type == TypeInfo::UE_StructTypeInfo) {
+		fprintf(fileHandle, "struct ");
+		OutputStructName(&sc->definedStructs.data[info.AsStructTypeInfo().index], sc, fileHandle);
+	}
+	else if (info.type == TypeInfo::UE_PointerTypeInfo) {
+		OutputTypeIndexToCCode(info.AsPointerTypeInfo().subType, sc, fileHandle);
+		fprintf(fileHandle, "*");
+	}
+	else if (info.type == TypeInfo::UE_ArrayTypeInfo) {
+		const ArrayTypeInfo& arrInfo = info.AsArrayTypeInfo();
+		if (arrInfo.isSoA) {
+			OutputSoAContainerName(arrInfo, sc, fileHandle);
+		}
+		else if (arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+			OutputSliceTypeName(typeIdx, sc, fileHandle);
+		}
+		else {
+			OutputTypeIndexToCCode(arrInfo.subType, sc, fileHandle);
+			fprintf(fileHandle, "*");
+		}
+	}
+}
+
+// Instances share their generic's field nodes, which name its parameters rather than the
+// arguments, so their fields are written out from the resolved types instead
+void OutputStructFieldToCCode(StructDef* def, VariableDecl* decl, SemanticContext* sc, AST* ast, FILE* fileHandle, int outerLen = ARRAY_DYNAMIC_LEN) {
+	ASTNode* field = &ast->nodes.data[decl->idx];
+	ASTNode* nameNode = &ast->nodes.data[field->VariableDecl_value.varName];
+	if (def->genericIndex < 0) {
+		ASTNode* typeNode = &ast->nodes.data[field->VariableDecl_value.type];
+		OutputDeclaratorToCCode(typeNode, nameNode, sc, fileHandle, outerLen);
+		return;
+	}
+
+	TypeIndex typeIdx = decl->typeIndex;
+	Vector<int> lengths;
+	while (sc->knownTypes.data[typeIdx].type == TypeInfo::UE_ArrayTypeInfo) {
+		const ArrayTypeInfo& arrInfo = sc->knownTypes.data[typeIdx].AsArrayTypeInfo();
+		if (arrInfo.isSoA || arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+			break;
+		}
+
+		lengths.PushBack(arrInfo.arrayLen);
+		typeIdx = arrInfo.subType;
+	}
+
+	OutputTypeIndexToCCode(typeIdx, sc, fileHandle);
+	fprintf(fileHandle, " ");
+	OutputASTToCCode(nameNode, sc, fileHandle);
+
+	if (outerLen != ARRAY_DYNAMIC_LEN) {
+		fprintf(fileHandle, "[%d]", outerLen);
+	}
+
+	BNS_VEC_FOREACH(lengths) {
+		fprintf(fileHandle, "[%d]", *ptr);
+	}
+}
+
+void OutputSoAContainerDefinitions(StructDef* def, SemanticContext* sc, AST* ast, FILE* fileHandle) {
+	BNS_VEC_FOREACH(sc->knownTypes) {
+		if (ptr->type != TypeInfo::UE_ArrayTypeInfo || !ptr->AsArrayTypeInfo().isSoA) {
+			continue;
+		}
+
+		const ArrayTypeInfo& arrInfo = ptr->AsArrayTypeInfo();
+		int structIndex = sc->knownTypes.data[arrInfo.subType].AsStructTypeInfo().index;
+		if (&sc->definedStructs.data[structIndex] != def) {
+			continue;
+		}
+
+		OutputSoAContainerName(arrInfo, sc, fileHandle);
+		fprintf(fileHandle, " {\n");
+		BNS_VEC_FOREACH_NAME(def->fieldDecls, declPtr) {
+			fprintf(fileHandle, "\t");
+			OutputStructFieldToCCode(def, declPtr, sc, ast, fileHandle, arrInfo.arrayLen);
+			fprintf(fileHandle, ";\n");
+		}
+		fprintf(fileHandle, "};\n");
+	}
+}
+
+void OutputDeclaratorToCCode(ASTNode* typeNode, ASTNode* nameNode, SemanticContext* sc, FILE* fileHandle, int outerLen /*= ARRAY_DYNAMIC_LEN*/) {
+	// C puts array lengths after the name, outermost first
+	Vector<ASTIndex> lengths;
+	ASTNode* baseType = typeNode;
+	while (baseType->type == ANT_TypeArray && !baseType->TypeArray_value.isSoA
+		&& baseType->TypeArray_value.length != ARRAY_DYNAMIC_LEN) {
+		lengths.PushBack(baseType->TypeArray_value.length);
+		baseType = &baseType->ast->nodes.data[baseType->TypeArray_value.childType];
+	}
+
+	OutputASTToCCode(baseType, sc, fileHandle);
+	fprintf(fileHandle, " ");
+	OutputASTToCCode(nameNode, sc, fileHandle);
+
+	if (outerLen != ARRAY_DYNAMIC_LEN) {
+		fprintf(fileHandle, "[%d]", outerLen);
+	}
+
+	BNS_VEC_FOREACH(lengths) {
+		fprintf(fileHandle, "[");
+		OutputASTToCCode(&typeNode->ast->nodes.data[*ptr], sc, fileHandle);
+		fprintf(fileHandle, "]");
+	}
+}
+
 bool OutputStructDeclarations(SemanticContext* sc, AST* ast, FILE* fileHandle) {
-	BNS_VEC_FOREACH(sc->definedStructs) {
-		fprintf(fileHandle, "struct %.*s;\n", BNS_LEN_START(ptr->name));
+	// Indices into sc->definedStructs, so the defs (and their field lists) aren't copied
+	Vector<int> structsToDefine;
+	for (int i = 0; i < sc->definedStructs.count; i++) {
+		StructDef* def = &sc->definedStructs.data[i];
+		if (def->isReachable) {
+			fprintf(fileHandle, "struct ");
+			OutputStructName(def, sc, fileHandle);
+			fprintf(fileHandle, ";\n");
+			structsToDefine.PushBack(i);
+		}
 	}
 
-	Vector<StructDef> structsToDefine = sc->definedStructs;
 	while (structsToDefine.count > 0) {
 		bool madeProgress = false;
 		BNS_VEC_FOREACH(structsToDefine) {
+			StructDef* def = &sc->definedStructs.data[*ptr];
 			bool canBeDefined = true;
-			BNS_VEC_FOREACH_NAME(ptr->fieldDecls, fieldPtr) {
-				TypeInfo fType = sc->knownTypes.data[fieldPtr->typeIndex];
-				if (fType.type == TypeInfo::UE_StructTypeInfo) {
+			BNS_VEC_FOREACH_NAME(def->fieldDecls, fieldPtr) {
+				TypeIndex depType = GetByValueStructDependency(fieldPtr->typeIndex, sc);
+				if (depType >= 0) {
+					int depIndex = sc->knownTypes.data[depType].AsStructTypeInfo().index;
 					BNS_VEC_FOREACH_NAME(structsToDefine, defPtr) {
-						if (defPtr->idx == sc->definedStructs.data[fType.AsStructTypeInfo().index].idx) {
+						if (*defPtr == depIndex) {
 							canBeDefined = false;
 							break;
 						}
@@ -24,53 +252,1058 @@ bool OutputStructDeclarations(SemanticContext* sc, AST* ast, FILE* fileHandle) {
 				if (!canBeDefined) { break; }
 			}
 
-			if (canBeDefined) {
+			if (canBeDefined) {
+
+				fprintf(fileHandle, "struct ");
+				OutputStructName(def, sc, fileHandle);
+				fprintf(fileHandle, " {\n");
+				BNS_VEC_FOREACH_NAME(def->fieldDecls, declPtr) {
+					fprintf(fileHandle, "\t");
+					OutputStructFieldToCCode(def, declPtr, sc, ast, fileHandle);
+					fprintf(fileHandle, ";\n");
+				}
+				fprintf(fileHandle, "};\n");
+
+				OutputSoAContainerDefinitions(def, sc, ast, fileHandle);
+				OutputSliceTypedefs(sc, *ptr, fileHandle);
+
+				*ptr = structsToDefine.data[structsToDefine.count - 1];
+				structsToDefine.PopBack();
+				ptr--;
+				madeProgress = true;
+			}
+		}
+
+		if (!madeProgress) {
+			fprintf(sc->diagnosticsFile, "Error, could not make progress in struct definition graph.\n");
+			ASSERT(false);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Vector types are lowered to GCC/Clang vector extensions, which give element-wise operators
+void OutputBuiltinVectorTypedefs(SemanticContext* sc, FILE* fileHandle) {
+	fprintf(fileHandle, "\n//Builtin vector types\n");
+	fprintf(fileHandle, "#if defined(__GNUC__) || defined(__clang__)\n");
+	BNS_VEC_FOREACH(sc->knownTypes) {
+		if (ptr->type == TypeInfo::UE_BuiltinTypeInfo && ptr->AsBuiltinTypeInfo().laneCount > 0) {
+			const BuiltinTypeInfo& vecInfo = ptr->AsBuiltinTypeInfo();
+			const BuiltinTypeInfo& laneInfo = sc->knownTypes.data[vecInfo.laneType].AsBuiltinTypeInfo();
+			fprintf(fileHandle, "typedef %s %s __attribute__((vector_size(%d)));\n", laneInfo.name, vecInfo.name, vecInfo.size);
+		}
+	}
+	fprintf(fileHandle, "#endif\n");
+}
+
+void MarkInlineFunctions(SemanticContext* sc) {
+	for (int i = 0; i < sc->definedFunctions.count; i++) {
+		FuncDef* def = &sc->definedFunctions.data[i];
+		def->shouldInline = sc->options.inlineSmallFunctions
+			&& def->bodySize <= sc->options.inlineMaxNodes
+			&& !def->isRecursive;
+	}
+}
+
+static bool IsLargeStructType(TypeIndex typeIdx, SemanticContext* sc) {
+	return typeIdx >= 0 && sc->knownTypes.data[typeIdx].type == TypeInfo::UE_StructTypeInfo
+		&& GetTypeSize(typeIdx, sc) > sc->options.structByValueMaxSize;
+}
+
+static ASTNode* GetParamDeclOfUse(ASTNode* node, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(node, sc);
+	if (node->type != ANT_Identifier || info == nullptr || !(info->flags & NIF_HasSymbol) || info->symbolKind != NSK_Variable) {
+		return nullptr;
+	}
+
+	return &node->ast->nodes.data[info->symbolIndex];
+}
+
+// An identifier naming a parameter that's passed as a const pointer
+static bool IsPointerParamUse(ASTNode* node, SemanticContext* sc) {
+	ASTNode* decl = GetParamDeclOfUse(node, sc);
+	return decl != nullptr && (GetNodeInfo(decl, sc)->flags & NIF_PassedByPointer);
+}
+
+static FuncDef* GetOutPointerCallee(ASTNode* node, SemanticContext* sc) {
+	if (node->type != ANT_FunctionCall) {
+		return nullptr;
+	}
+
+	FuncDef* callee = GetResolvedFuncDef(node, sc);
+	return (callee != nullptr && callee->returnsThroughPointer) ? callee : nullptr;
+}
+
+// Follows an lvalue (or an array that decays to a pointer) down to the variable it's part of,
+// and stops passing that variable by pointer if it's a parameter. Writes through a pointer stop the walk
+static void RuleOutParamWrittenThrough(ASTNode* node, SemanticContext* sc) {
+	while (true) {
+		if (node->type == ANT_Parentheses) {
+			node = &node->ast->nodes.data[node->Parentheses_value.val];
+		}
+		else if (node->type == ANT_BinaryOp && StrEqual(node->BinaryOp_value.op, ".")) {
+			node = &node->ast->nodes.data[node->BinaryOp_value.left];
+		}
+		else if (node->type == ANT_ArrayAccess) {
+			node = &node->ast->nodes.data[node->ArrayAccess_value.arr];
+		}
+		else {
+			break;
+		}
+	}
+
+	ASTNode* decl = GetParamDeclOfUse(node, sc);
+	if (decl != nullptr) {
+		GetNodeInfo(decl, sc)->flags &= ~NIF_PassedByPointer;
+	}
+}
+
+// Fixed arrays decay to pointers wherever they're passed on, which would let a struct's array field be written
+static void RuleOutParamArrayEscape(ASTNode* val, SemanticContext* sc) {
+	TypeIndex valType;
+	if (TypeCheckValue(val, sc, &valType) == TCR_Success && sc->knownTypes.data[valType].type == TypeInfo::UE_ArrayTypeInfo) {
+		RuleOutParamWrittenThrough(val, sc);
+	}
+}
+
+static void RuleOutMutatedParams(ASTNode* body, SemanticContext* sc) {
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(body->GetIndex());
+	while (toVisit.count > 0) {
+		ASTNode* node = &body->ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		if (node->type == ANT_VariableAssign) {
+			RuleOutParamWrittenThrough(&node->ast->nodes.data[node->VariableAssign_value.var], sc);
+			RuleOutParamArrayEscape(&node->ast->nodes.data[node->VariableAssign_value.val], sc);
+		}
+		else if (node->type == ANT_UnaryOp && StrEqual(node->UnaryOp_value.op, "^") && !node->UnaryOp_value.isPre) {
+			RuleOutParamWrittenThrough(&node->ast->nodes.data[node->UnaryOp_value.val], sc);
+		}
+		else if (node->type == ANT_VariableDecl && node->VariableDecl_value.initValue >= 0) {
+			RuleOutParamArrayEscape(&node->ast->nodes.data[node->VariableDecl_value.initValue], sc);
+		}
+		else if (node->type == ANT_ReturnStatement) {
+			RuleOutParamArrayEscape(&node->ast->nodes.data[node->ReturnStatement_value.retVal], sc);
+		}
+		else if (node->type == ANT_FunctionCall) {
+			BNS_VEC_FOREACH(node->FunctionCall_value.args) {
+				RuleOutParamArrayEscape(&node->ast->nodes.data[*ptr], sc);
+			}
+		}
+
+		GetChildNodes(node, &toVisit);
+	}
+}
+
+// Out-pointer calls have to be written as statements, so they can only be the whole value
+// of a declaration, assignment or return. Calls anywhere else keep their callee returning by value
+static void RuleOutValueOutPointerCalls(ASTNode* node, bool inFunctionBody, SemanticContext* sc) {
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(node->GetIndex());
+	while (toVisit.count > 0) {
+		ASTNode* curr = &node->ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		if (curr->type == ANT_Statement && inFunctionBody) {
+			ASTNode* stmt = &curr->ast->nodes.data[curr->Statement_value.root];
+			ASTIndex call = -1;
+			if (stmt->type == ANT_VariableDecl) {
+				call = stmt->VariableDecl_value.initValue;
+			}
+			else if (stmt->type == ANT_VariableAssign) {
+				call = stmt->VariableAssign_value.val;
+				toVisit.PushBack(stmt->VariableAssign_value.var);
+			}
+			else if (stmt->type == ANT_ReturnStatement) {
+				call = stmt->ReturnStatement_value.retVal;
+			}
+
+			if (call >= 0 && curr->ast->nodes.data[call].type == ANT_FunctionCall) {
+				BNS_VEC_FOREACH(curr->ast->nodes.data[call].FunctionCall_value.args) {
+					toVisit.PushBack(*ptr);
+				}
+				continue;
+			}
+		}
+		else if (curr->type == ANT_FunctionCall) {
+			FuncDef* callee = GetResolvedFuncDef(curr, sc);
+			if (callee != nullptr) {
+				callee->returnsThroughPointer = false;
+			}
+		}
+
+		GetChildNodes(curr, &toVisit);
+	}
+}
+
+static void MarkOutPointerReturns(ASTNode* body, SemanticContext* sc) {
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(body->GetIndex());
+	while (toVisit.count > 0) {
+		ASTNode* node = &body->ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		if (node->type == ANT_ReturnStatement) {
+			GetNodeInfo(node, sc)->flags |= NIF_ReturnsThroughPointer;
+		}
+
+		GetChildNodes(node, &toVisit);
+	}
+}
+
+// Chooses which struct parameters are passed as const pointers, and which functions return through an
+// out-pointer. A parameter qualifies if the body never writes to it, takes its address, or lets one of its
+// array fields decay to a pointer, since the callee would otherwise be able to change the caller's copy
+void MarkStructPassing(AST* ast, SemanticContext* sc) {
+	if (!sc->options.passLargeStructsByPointer) {
+		return;
+	}
+
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		ASTNode* defNode = &ast->nodes.data[ptr->idx];
+		ptr->returnsThroughPointer = ptr->isReachable && IsLargeStructType(ptr->retType, sc);
+
+		if (ptr->isReachable) {
+			const Vector<ASTIndex>& params = defNode->FunctionDefinition_value.params;
+			for (int i = 0; i < params.count; i++) {
+				if (IsLargeStructType(ptr->argTypes.data[i], sc)) {
+					sc->nodeInfo.data[params.data[i]].flags |= NIF_PassedByPointer;
+				}
+			}
+
+			RuleOutMutatedParams(&ast->nodes.data[defNode->FunctionDefinition_value.bodyScope], sc);
+		}
+	}
+
+	const Vector<ASTIndex>& topStmts = ast->nodes.Back().Root_value.topLevelStatements;
+	BNS_VEC_FOREACH(topStmts) {
+		ASTNode* stmt = &ast->nodes.data[*ptr];
+		if (stmt->type == ANT_FunctionDefinition) {
+			FuncDef* def = GetResolvedFuncDef(stmt, sc);
+			if (def != nullptr && def->isReachable) {
+				RuleOutValueOutPointerCalls(&ast->nodes.data[stmt->FunctionDefinition_value.bodyScope], true, sc);
+			}
+		}
+		else {
+			RuleOutValueOutPointerCalls(stmt, false, sc);
+		}
+	}
+
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		if (ptr->returnsThroughPointer) {
+			ASTNode* defNode = &ast->nodes.data[ptr->idx];
+			MarkOutPointerReturns(&ast->nodes.data[defNode->FunctionDefinition_value.bodyScope], sc);
+		}
+	}
+}
+
+static bool IsAddressableValue(ASTNode* val) {
+	switch (val->type) {
+	case ANT_Identifier:
+	case ANT_ArrayAccess: {
+		return true;
+	} break;
+
+	case ANT_Parentheses: {
+		return IsAddressableValue(&val->ast->nodes.data[val->Parentheses_value.val]);
+	} break;
+
+	case ANT_BinaryOp: {
+		return StrEqual(val->BinaryOp_value.op, ".") && IsAddressableValue(&val->ast->nodes.data[val->BinaryOp_value.left]);
+	} break;
+
+	case ANT_UnaryOp: {
+		return StrEqual(val->UnaryOp_value.op, "^") && val->UnaryOp_value.isPre;
+	} break;
+
+	default: {
+		return false;
+	} break;
+	}
+}
+
+// What a pointer argument may point into: the ASTIndex of a variable declaration, or one of these
+enum PointerBase {
+	PB_Unknown = -1,
+	// A temporary only this call can see
+	PB_Fresh = -2,
+	// Not a pointer at all
+	PB_None = -3
+};
+
+static bool IsPointerType(TypeIndex typeIdx, SemanticContext* sc) {
+	return typeIdx >= 0 && sc->knownTypes.data[typeIdx].type == TypeInfo::UE_PointerTypeInfo;
+}
+
+// Whether a value of this type can point at other memory. Fixed arrays decay to pointers
+// when passed on, but are copied along with a struct holding them
+static bool IsPointerCarryingType(TypeIndex typeIdx, bool arraysDecay, SemanticContext* sc) {
+	const TypeInfo& info = sc->knownTypes.data[typeIdx];
+	switch (info.type) {
+	case TypeInfo::UE_PointerTypeInfo: {
+		return true;
+	} break;
+
+	case TypeInfo::UE_ArrayTypeInfo: {
+		const ArrayTypeInfo& arrInfo = info.AsArrayTypeInfo();
+		if (arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+			return true;
+		}
+
+		return (arraysDecay && !arrInfo.isSoA) || IsPointerCarryingType(arrInfo.subType, false, sc);
+	} break;
+
+	case TypeInfo::UE_StructTypeInfo: {
+		StructDef* def = &sc->definedStructs.data[info.AsStructTypeInfo().index];
+		BNS_VEC_FOREACH(def->fieldDecls) {
+			if (ptr->typeIndex < 0 || IsPointerCarryingType(ptr->typeIndex, false, sc)) {
+				return true;
+			}
+		}
+		return false;
+	} break;
+
+	default: {
+		return false;
+	} break;
+	}
+}
+
+static ASTNode* SkipParentheses(ASTNode* node) {
+	while (node->type == ANT_Parentheses) {
+		node = &node->ast->nodes.data[node->Parentheses_value.val];
+	}
+
+	return node;
+}
+
+static bool IsRestrictParamUse(ASTNode* node, SemanticContext* sc) {
+	ASTNode* decl = GetParamDeclOfUse(node, sc);
+	return decl != nullptr && (GetNodeInfo(decl, sc)->flags & NIF_RestrictPointer);
+}
+
+// The variable whose storage an lvalue is part of. Memory behind a pointer only has a known base
+// if that pointer is itself a restrict parameter
+static int GetLvalueBase(ASTNode* node, const Vector<unsigned char>& declKinds, SemanticContext* sc) {
+	while (true) {
+		node = SkipParentheses(node);
+		if (node->type == ANT_BinaryOp && StrEqual(node->BinaryOp_value.op, ".")) {
+			node = &node->ast->nodes.data[node->BinaryOp_value.left];
+		}
+		else if (node->type == ANT_ArrayAccess) {
+			node = &node->ast->nodes.data[node->ArrayAccess_value.arr];
+
+			TypeIndex arrType;
+			if (TypeCheckValue(node, sc, &arrType) != TCR_Success || IsSliceType(arrType, sc)) {
+				return PB_Unknown;
+			}
+		}
+		else if (node->type == ANT_UnaryOp && StrEqual(node->UnaryOp_value.op, "^") && node->UnaryOp_value.isPre) {
+			ASTNode* ptrNode = SkipParentheses(&node->ast->nodes.data[node->UnaryOp_value.val]);
+			return IsRestrictParamUse(ptrNode, sc) ? GetNodeInfo(ptrNode, sc)->symbolIndex : PB_Unknown;
+		}
+		else {
+			break;
+		}
+	}
+
+	ASTNode* decl = GetParamDeclOfUse(node, sc);
+	if (decl == nullptr) {
+		return PB_Unknown;
+	}
+
+	// Array and const pointer parameters are the caller's storage, not ours
+	ASTIndex declIdx = decl->GetIndex();
+	if (declKinds.data[declIdx] == DK_Param) {
+		TypeIndex declType;
+		if ((GetNodeInfo(decl, sc)->flags & NIF_PassedByPointer)
+			|| TypeCheckValue(node, sc, &declType) != TCR_Success
+			|| sc->knownTypes.data[declType].type == TypeInfo::UE_ArrayTypeInfo) {
+			return PB_Unknown;
+		}
+	}
+
+	return declIdx;
+}
+
+static int GetPointerArgBase(ASTNode* arg, TypeIndex paramType, ASTNode* paramDecl, const Vector<unsigned char>& declKinds, SemanticContext* sc) {
+	if (GetNodeInfo(paramDecl, sc)->flags & NIF_PassedByPointer) {
+		if (IsPointerParamUse(arg, sc)) {
+			return PB_Unknown;
+		}
+
+		return IsAddressableValue(arg) ? GetLvalueBase(arg, declKinds, sc) : PB_Fresh;
+	}
+
+	if (!IsPointerCarryingType(paramType, true, sc)) {
+		return PB_None;
+	}
+
+	NodeInfo* argInfo = GetNodeInfo(arg, sc);
+	arg = SkipParentheses(arg);
+	TypeIndex argType;
+	if (TypeCheckValue(arg, sc, &argType) != TCR_Success) {
+		return PB_Unknown;
+	}
+
+	if ((argInfo->flags & NIF_ConvertsToSlice) || IsFixedArrayType(argType, sc)) {
+		return GetLvalueBase(arg, declKinds, sc);
+	}
+	else if (arg->type == ANT_UnaryOp && StrEqual(arg->UnaryOp_value.op, "^") && !arg->UnaryOp_value.isPre) {
+		return GetLvalueBase(&arg->ast->nodes.data[arg->UnaryOp_value.val], declKinds, sc);
+	}
+	else if (IsPointerType(argType, sc) && IsRestrictParamUse(arg, sc)) {
+		return GetNodeInfo(arg, sc)->symbolIndex;
+	}
+
+	return PB_Unknown;
+}
+
+// Drops restrict from any of the callee's parameters whose argument might share memory with another
+// argument, including the out-pointer. Returns whether anything was dropped
+static bool CheckRestrictCall(ASTNode* call, int outPointerBase, const Vector<unsigned char>& declKinds, SemanticContext* sc) {
+	FuncDef* callee = GetResolvedFuncDef(call, sc);
+	if (callee == nullptr) {
+		return false;
+	}
+
+	ASTNode* calleeNode = &call->ast->nodes.data[callee->idx];
+	const Vector<ASTIndex>& params = calleeNode->FunctionDefinition_value.params;
+	const Vector<ASTIndex>& args = call->FunctionCall_value.args;
+	if (params.count != args.count) {
+		return false;
+	}
+
+	Vector<int> bases;
+	for (int i = 0; i < args.count; i++) {
+		ASTNode* paramDecl = &call->ast->nodes.data[params.data[i]];
+		bases.PushBack(GetPointerArgBase(&call->ast->nodes.data[args.data[i]], callee->argTypes.data[i], paramDecl, declKinds, sc));
+	}
+	bases.PushBack(outPointerBase);
+
+	bool anyDropped = false;
+	for (int i = 0; i < params.count; i++) {
+		NodeInfo* paramInfo = &sc->nodeInfo.data[params.data[i]];
+		if (!(paramInfo->flags & NIF_RestrictPointer)) {
+			continue;
+		}
+
+		bool isDistinct = (bases.data[i] >= 0);
+		for (int j = 0; j < bases.count && isDistinct; j++) {
+			if (j != i && bases.data[j] != PB_None && bases.data[j] != PB_Fresh) {
+				isDistinct = (bases.data[j] >= 0 && bases.data[j] != bases.data[i]);
+			}
+		}
+
+		if (!isDistinct) {
+			paramInfo->flags &= ~NIF_RestrictPointer;
+			anyDropped = true;
+		}
+	}
+
+	return anyDropped;
+}
+
+static bool CheckRestrictCalls(ASTNode* node, const Vector<unsigned char>& declKinds, SemanticContext* sc) {
+	bool anyDropped = false;
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(node->GetIndex());
+	while (toVisit.count > 0) {
+		ASTNode* curr = &node->ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		// Out-pointer calls are only ever statements, so their destination is found from there
+		if (curr->type == ANT_Statement) {
+			ASTNode* stmt = &curr->ast->nodes.data[curr->Statement_value.root];
+			if (stmt->type == ANT_VariableDecl && stmt->VariableDecl_value.initValue >= 0) {
+				ASTNode* init = &curr->ast->nodes.data[stmt->VariableDecl_value.initValue];
+				if (GetOutPointerCallee(init, sc) != nullptr) {
+					anyDropped |= CheckRestrictCall(init, PB_Fresh, declKinds, sc);
+				}
+			}
+			else if (stmt->type == ANT_VariableAssign) {
+				ASTNode* val = &curr->ast->nodes.data[stmt->VariableAssign_value.val];
+				if (GetOutPointerCallee(val, sc) != nullptr) {
+					int targetBase = GetLvalueBase(&curr->ast->nodes.data[stmt->VariableAssign_value.var], declKinds, sc);
+					anyDropped |= CheckRestrictCall(val, targetBase, declKinds, sc);
+				}
+			}
+			else if (stmt->type == ANT_ReturnStatement) {
+				ASTNode* retVal = &curr->ast->nodes.data[stmt->ReturnStatement_value.retVal];
+				if (GetOutPointerCallee(retVal, sc) != nullptr) {
+					// Our own out-pointer could be anything the caller has
+					bool forwardsOutPointer = (GetNodeInfo(stmt, sc)->flags & NIF_ReturnsThroughPointer) != 0;
+					anyDropped |= CheckRestrictCall(retVal, forwardsOutPointer ? PB_Unknown : PB_Fresh, declKinds, sc);
+				}
+			}
+		}
+		else if (curr->type == ANT_FunctionCall && GetOutPointerCallee(curr, sc) == nullptr) {
+			anyDropped |= CheckRestrictCall(curr, PB_None, declKinds, sc);
+		}
+
+		GetChildNodes(curr, &toVisit);
+	}
+
+	return anyDropped;
+}
+
+// Whether a function body only reaches memory through its parameters and its own locals: it names no
+// globals, and only dereferences or indexes through parameters
+static bool IsBodyMemoryClosed(ASTNode* body, const Vector<unsigned char>& declKinds, SemanticContext* sc) {
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(body->GetIndex());
+	while (toVisit.count > 0) {
+		ASTNode* node = &body->ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		if (node->type == ANT_Identifier) {
+			ASTNode* decl = GetParamDeclOfUse(node, sc);
+			if (decl != nullptr && declKinds.data[decl->GetIndex()] == DK_Global) {
+				return false;
+			}
+		}
+		else if (node->type == ANT_UnaryOp && StrEqual(node->UnaryOp_value.op, "^") && node->UnaryOp_value.isPre) {
+			ASTNode* decl = GetParamDeclOfUse(SkipParentheses(&node->ast->nodes.data[node->UnaryOp_value.val]), sc);
+			if (decl == nullptr || declKinds.data[decl->GetIndex()] != DK_Param) {
+				return false;
+			}
+		}
+		else if (node->type == ANT_ArrayAccess) {
+			ASTNode* arr = SkipParentheses(&node->ast->nodes.data[node->ArrayAccess_value.arr]);
+			TypeIndex arrType;
+			if (TypeCheckValue(arr, sc, &arrType) != TCR_Success) {
+				return false;
+			}
+
+			ASTNode* decl = GetParamDeclOfUse(arr, sc);
+			if (IsSliceType(arrType, sc) && (decl == nullptr || declKinds.data[decl->GetIndex()] != DK_Param)) {
+				return false;
+			}
+		}
+
+		GetChildNodes(node, &toVisit);
+	}
+
+	return true;
+}
+
+static bool IsRootFunction(FuncDef* def, SemanticContext* sc) {
+	BNS_VEC_FOREACH(sc->options.rootFunctionNames) {
+		if (def->name == *ptr) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Pointer parameters are restrict if the function can't reach memory other than through its
+// parameters, including in anything it calls, and every call passes each one a different variable
+// than all of its other pointer arguments. Restrict parameters of a caller count as different
+// variables, which is checked optimistically: everything starts out restrict and gets dropped
+// until no call contradicts it. Root functions can be called with anything, so never qualify
+void MarkRestrictParams(AST* ast, SemanticContext* sc) {
+	if (!sc->options.restrictPointerParams || sc->options.rootFunctionNames.count == 0) {
+		return;
+	}
+
+	ASTNode* root = &ast->nodes.Back();
+	Vector<unsigned char> declKinds;
+	GetDeclKinds(ast, &declKinds);
+
+	Vector<int> memoryClosed;
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		ASTNode* defNode = &ast->nodes.data[ptr->idx];
+		bool isClosed = ptr->isReachable && IsBodyMemoryClosed(&ast->nodes.data[defNode->FunctionDefinition_value.bodyScope], declKinds, sc);
+		memoryClosed.PushBack(isClosed ? 1 : 0);
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int i = 0; i < sc->definedFunctions.count; i++) {
+			if (!memoryClosed.data[i]) {
+				continue;
+			}
+
+			BNS_VEC_FOREACH(sc->definedFunctions.data[i].calledFuncs) {
+				if (!memoryClosed.data[*ptr]) {
+					memoryClosed.data[i] = 0;
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < sc->definedFunctions.count; i++) {
+		FuncDef* def = &sc->definedFunctions.data[i];
+		if (!memoryClosed.data[i] || IsRootFunction(def, sc)) {
+			continue;
+		}
+
+		const Vector<ASTIndex>& params = ast->nodes.data[def->idx].FunctionDefinition_value.params;
+		for (int j = 0; j < params.count; j++) {
+			if (IsPointerType(def->argTypes.data[j], sc)) {
+				sc->nodeInfo.data[params.data[j]].flags |= NIF_RestrictPointer;
+			}
+		}
+	}
+
+	changed = true;
+	while (changed) {
+		changed = false;
+		BNS_VEC_FOREACH(root->Root_value.topLevelStatements) {
+			ASTNode* stmt = &ast->nodes.data[*ptr];
+			if (stmt->type == ANT_FunctionDefinition) {
+				FuncDef* def = GetResolvedFuncDef(stmt, sc);
+				if (def == nullptr || !def->isReachable) {
+					continue;
+				}
+			}
+
+			changed |= CheckRestrictCalls(stmt, declKinds, sc);
+		}
+	}
+}
+
+void OutputInlineFunctionDefinition(int funcIndex, AST* ast, SemanticContext* sc, Vector<int>* emitted, FILE* fileHandle) {
+	if (emitted->data[funcIndex]) {
+		return;
+	}
+
+	emitted->data[funcIndex] = 1;
+
+	// Inlined functions can't be recursive, so callees can always be emitted first
+	FuncDef* def = &sc->definedFunctions.data[funcIndex];
+	BNS_VEC_FOREACH(def->calledFuncs) {
+		if (sc->definedFunctions.data[*ptr].shouldInline) {
+			OutputInlineFunctionDefinition(*ptr, ast, sc, emitted, fileHandle);
+		}
+	}
+
+	OutputASTToCCode(&ast->nodes.data[def->idx], sc, fileHandle);
+}
+
+void OutputFunctionHeaderToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle) {
+	FuncDef* def = GetResolvedFuncDef(node, sc);
+	if (def != nullptr && def->shouldInline) {
+		fprintf(fileHandle, "static inline ");
+	}
+
+	if (def != nullptr && def->returnsThroughPointer) {
+		fprintf(fileHandle, "void");
+	}
+	else {
+		OutputASTToCCode(&node->ast->nodes.data[node->FunctionDefinition_value.returnType], sc, fileHandle);
+	}
+	fprintf(fileHandle, " ");
+	OutputASTToCCode(&node->ast->nodes.data[node->FunctionDefinition_value.name], sc, fileHandle);
+	fprintf(fileHandle, "(");
+	bool first = true;
+	BNS_VEC_FOREACH(node->FunctionDefinition_value.params) {
+		if (!first) {
+			fprintf(fileHandle, ", ");
+		}
+
+		ASTNode* param = &node->ast->nodes.data[*ptr];
+		NodeInfo* paramInfo = GetNodeInfo(param, sc);
+		if (paramInfo != nullptr && (paramInfo->flags & NIF_PassedByPointer)) {
+			int paramIndex = ptr - node->FunctionDefinition_value.params.data;
+			fprintf(fileHandle, "const ");
+			OutputTypeIndexToCCode(def->argTypes.data[paramIndex], sc, fileHandle);
+			fprintf(fileHandle, "* ");
+			OutputASTToCCode(&node->ast->nodes.data[param->VariableDecl_value.varName], sc, fileHandle);
+		}
+		else if (paramInfo != nullptr && (paramInfo->flags & NIF_RestrictPointer)) {
+			OutputASTToCCode(&node->ast->nodes.data[param->VariableDecl_value.type], sc, fileHandle);
+			fprintf(fileHandle, " restrict ");
+			OutputASTToCCode(&node->ast->nodes.data[param->VariableDecl_value.varName], sc, fileHandle);
+		}
+		else {
+			OutputASTToCCode(param, sc, fileHandle);
+		}
+
+		first = false;
+	}
+
+	if (def != nullptr && def->returnsThroughPointer) {
+		fprintf(fileHandle, first ? "" : ", ");
+		OutputTypeIndexToCCode(def->retType, sc, fileHandle);
+		fprintf(fileHandle, "* bnc_ret");
+	}
+	fprintf(fileHandle, ")");
+}
+
+// A pointer to elemType, split around its name since pointers to arrays are written 'int (*name)[4]'
+static void OutputElementPointerStartToCCode(TypeIndex elemType, SemanticContext* sc, FILE* fileHandle) {
+	if (!IsFixedArrayType(elemType, sc)) {
+		OutputTypeIndexToCCode(elemType, sc, fileHandle);
+		fprintf(fileHandle, "* ");
+		return;
+	}
+
+	while (IsFixedArrayType(elemType, sc)) {
+		elemType = sc->knownTypes.data[elemType].AsArrayTypeInfo().subType;
+	}
+
+	OutputTypeIndexToCCode(elemType, sc, fileHandle);
+	fprintf(fileHandle, " (*");
+}
+
+static void OutputElementPointerEndToCCode(TypeIndex elemType, SemanticContext* sc, FILE* fileHandle) {
+	if (!IsFixedArrayType(elemType, sc)) {
+		return;
+	}
+
+	fprintf(fileHandle, ")");
+	while (IsFixedArrayType(elemType, sc)) {
+		fprintf(fileHandle, "[%d]", sc->knownTypes.data[elemType].AsArrayTypeInfo().arrayLen);
+		elemType = sc->knownTypes.data[elemType].AsArrayTypeInfo().subType;
+	}
+}
+
+// Slices (T[]) carry their length. Element types are always created before arrays of them,
+// so inner slices are defined first. Those with no struct dependency are written before any
+// struct, the rest right after the struct they wait on (afterStructIndex), which is still
+// before any struct holding them by value
+static void OutputSliceTypedefs(SemanticContext* sc, int afterStructIndex, FILE* fileHandle) {
+	bool anySlices = false;
+	for (int i = 0; i < sc->knownTypes.count; i++) {
+		if (!IsSliceType(i, sc)) {
+			continue;
+		}
+
+		TypeIndex depType = GetSliceStructDependency(i, sc);
+		int depIndex = (depType >= 0) ? sc->knownTypes.data[depType].AsStructTypeInfo().index : -1;
+		if (depIndex != afterStructIndex) {
+			continue;
+		}
+
+		if (!anySlices && afterStructIndex < 0) {
+			fprintf(fileHandle, "\n//Slice types\n");
+			anySlices = true;
+		}
+
+		TypeIndex elemType = sc->knownTypes.data[i].AsArrayTypeInfo().subType;
+		fprintf(fileHandle, "typedef struct {\n\t");
+		OutputElementPointerStartToCCode(elemType, sc, fileHandle);
+		fprintf(fileHandle, "data");
+		OutputElementPointerEndToCCode(elemType, sc, fileHandle);
+		fprintf(fileHandle, ";\n\tint length;\n} ");
+		OutputSliceTypeName(i, sc, fileHandle);
+		fprintf(fileHandle, ";\n");
+	}
+}
+
+// Indexing needs complete element types, so these go after the struct definitions
+static void OutputBoundsCheckFunctions(SemanticContext* sc, FILE* fileHandle) {
+	fprintf(fileHandle, "\n//Bounds checks\n");
+	fprintf(fileHandle, "#include <stdlib.h>\n");
+	fprintf(fileHandle, "static inline int bnc_check_index(int index, int length) {\n");
+	fprintf(fileHandle, "\tif ((unsigned int)index >= (unsigned int)length) {\n\t\tabort();\n\t}\n");
+	fprintf(fileHandle, "\treturn index;\n}\n");
+
+	for (int i = 0; i < sc->knownTypes.count; i++) {
+		if (!IsSliceType(i, sc)) {
+			continue;
+		}
+
+		// Taking the slice by value means it's only evaluated once
+		TypeIndex elemType = sc->knownTypes.data[i].AsArrayTypeInfo().subType;
+		fprintf(fileHandle, "static inline ");
+		OutputElementPointerStartToCCode(elemType, sc, fileHandle);
+		OutputSliceTypeName(i, sc, fileHandle);
+		fprintf(fileHandle, "_at(");
+		OutputSliceTypeName(i, sc, fileHandle);
+		fprintf(fileHandle, " s, int index)");
+		OutputElementPointerEndToCCode(elemType, sc, fileHandle);
+		fprintf(fileHandle, " {\n\treturn &s.data[bnc_check_index(index, s.length)];\n}\n");
+	}
+}
+
+// Values converted to a slice are wrapped up with their length, everything else is written as is
+static void OutputValueToCCode(ASTNode* val, SemanticContext* sc, FILE* fileHandle) {
+	NodeInfo* info = GetNodeInfo(val, sc);
+	if (info == nullptr || !(info->flags & NIF_ConvertsToSlice)) {
+		OutputASTToCCode(val, sc, fileHandle);
+		return;
+	}
+
+	const ArrayTypeInfo& arrInfo = sc->knownTypes.data[info->type].AsArrayTypeInfo();
+	TypeIndex sliceType = GetOrCreateArrayTypeOf(arrInfo.subType, ARRAY_DYNAMIC_LEN, sc);
+	fprintf(fileHandle, "((");
+	OutputSliceTypeName(sliceType, sc, fileHandle);
+	fprintf(fileHandle, "){ ");
+	OutputASTToCCode(val, sc, fileHandle);
+	fprintf(fileHandle, ", %d })", arrInfo.arrayLen);
+}
+
+// Temporaries are put in a one-element compound literal array, which decays to a pointer to them
+static void OutputArgByPointerToCCode(ASTNode* arg, TypeIndex argType, SemanticContext* sc, FILE* fileHandle) {
+	if (IsPointerParamUse(arg, sc)) {
+		fprintf(fileHandle, "%.*s", BNS_LEN_START(arg->Identifier_value.name));
+	}
+	else if (IsAddressableValue(arg)) {
+		fprintf(fileHandle, "&");
+		OutputASTToCCode(arg, sc, fileHandle);
+	}
+	else {
+		fprintf(fileHandle, "(");
+		OutputTypeIndexToCCode(argType, sc, fileHandle);
+		fprintf(fileHandle, "[1]){ ");
+		OutputASTToCCode(arg, sc, fileHandle);
+		fprintf(fileHandle, " }");
+	}
+}
+
+// Writes the call up to its closing paren, so an out-pointer can still be added
+static void OutputCallStartToCCode(ASTNode* call, SemanticContext* sc, FILE* fileHandle) {
+	FuncDef* callee = GetResolvedFuncDef(call, sc);
+	ASTNode* calleeNode = (callee != nullptr) ? &call->ast->nodes.data[callee->idx] : nullptr;
+
+	OutputASTToCCode(&call->ast->nodes.data[call->FunctionCall_value.func], sc, fileHandle);
+	fprintf(fileHandle, "(");
+	const Vector<ASTIndex>& args = call->FunctionCall_value.args;
+	for (int i = 0; i < args.count; i++) {
+		ASTNode* arg = &call->ast->nodes.data[args.data[i]];
+		if (i > 0) {
+			fprintf(fileHandle, ", ");
+		}
+
+		NodeInfo* paramInfo = nullptr;
+		if (calleeNode != nullptr && i < calleeNode->FunctionDefinition_value.params.count) {
+			paramInfo = GetNodeInfo(&call->ast->nodes.data[calleeNode->FunctionDefinition_value.params.data[i]], sc);
+		}
+
+		if (paramInfo != nullptr && (paramInfo->flags & NIF_PassedByPointer)) {
+			OutputArgByPointerToCCode(arg, callee->argTypes.data[i], sc, fileHandle);
+		}
+		else {
+			OutputValueToCCode(arg, sc, fileHandle);
+		}
+	}
+}
+
+static void OutputPurityAttributeMacros(FILE* fileHandle) {
+	fprintf(fileHandle, "\n//Function attributes\n");
+	fprintf(fileHandle, "#if defined(__GNUC__) || defined(__clang__)\n");
+	fprintf(fileHandle, "#define BNC_PURE __attribute__((pure))\n");
+	fprintf(fileHandle, "#define BNC_CONST __attribute__((const))\n");
+	fprintf(fileHandle, "#else\n");
+	fprintf(fileHandle, "#define BNC_PURE\n");
+	fprintf(fileHandle, "#define BNC_CONST\n");
+	fprintf(fileHandle, "#endif\n");
+}
+
+// Semantics judges purity on BNC values, but struct parameters passed as const pointers are
+// reads of the caller's memory in C, and an out-pointer return is a write
+static void OutputPurityAttributeToCCode(FuncDef* def, ASTNode* funcNode, SemanticContext* sc, FILE* fileHandle) {
+	if (def->purity == FP_Impure || def->returnsThroughPointer) {
+		return;
+	}
+
+	bool readsThroughParams = false;
+	BNS_VEC_FOREACH(funcNode->FunctionDefinition_value.params) {
+		if (sc->nodeInfo.data[*ptr].flags & NIF_PassedByPointer) {
+			readsThroughParams = true;
+		}
+	}
+
+	fprintf(fileHandle, (def->purity == FP_Const && !readsThroughParams) ? "BNC_CONST " : "BNC_PURE ");
+}
+
+// Types, structs and prototypes: everything that has to precede function bodies
+static void OutputCDeclarations(ASTNode* root, SemanticContext* sc, FILE* fileHandle) {
+	if (sc->usesVectorTypes) {
+		OutputBuiltinVectorTypedefs(sc, fileHandle);
+	}
+
+	OutputSliceTypedefs(sc, -1, fileHandle);
+
+	fprintf(fileHandle, "\n//Struct definitions\n");
+	OutputStructDeclarations(sc, root->ast, fileHandle);
+
+	if (sc->options.boundsChecks) {
+		OutputBoundsCheckFunctions(sc, fileHandle);
+	}
+
+	MarkInlineFunctions(sc);
+	MarkStructPassing(root->ast, sc);
+	MarkRestrictParams(root->ast, sc);
+
+	if (sc->options.emitPurityAttributes) {
+		OutputPurityAttributeMacros(fileHandle);
+	}
+
+	fprintf(fileHandle, "\n//Function declarations\n");
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		if (ptr->shouldInline || !ptr->isReachable) {
+			continue;
+		}
+
+		ASTNode* funcNode = &root->ast->nodes.data[ptr->idx];
+		if (sc->options.emitPurityAttributes) {
+			OutputPurityAttributeToCCode(ptr, funcNode, sc, fileHandle);
+		}
+		OutputFunctionHeaderToCCode(funcNode, sc, fileHandle);
+		fprintf(fileHandle, ";\n");
+	}
+}
+
+static void OutputInlineFunctionDefinitions(ASTNode* root, SemanticContext* sc, FILE* fileHandle) {
+	fprintf(fileHandle, "\n//Inline function definitions\n");
+	Vector<int> emitted;
+	for (int i = 0; i < sc->definedFunctions.count; i++) {
+		emitted.PushBack(0);
+	}
+
+	for (int i = 0; i < sc->definedFunctions.count; i++) {
+		if (sc->definedFunctions.data[i].shouldInline && sc->definedFunctions.data[i].isReachable) {
+			OutputInlineFunctionDefinition(i, root->ast, sc, &emitted, fileHandle);
+		}
+	}
+}
+
+// Whether a function definition gets a regular, out-of-line body in the output
+static bool IsOutOfLineFunctionDefinition(ASTNode* funcNode, SemanticContext* sc) {
+	FuncDef* def = GetResolvedFuncDef(funcNode, sc);
+	return def == nullptr || (!def->shouldInline && def->isReachable);
+}
+
+// 'arr.length' on a fixed-length array is just a constant, only slices store their length
+static bool GetFixedArrayLengthAccess(ASTNode* binOp, SemanticContext* sc, int* outLength) {
+	if (!StrEqual(binOp->BinaryOp_value.op, ".")) {
+		return false;
+	}
+
+	ASTNode* left = &binOp->ast->nodes.data[binOp->BinaryOp_value.left];
+	TypeIndex leftType;
+	if (TypeCheckValue(left, sc, &leftType) != TCR_Success || sc->knownTypes.data[leftType].type != TypeInfo::UE_ArrayTypeInfo) {
+		return false;
+	}
+
+	const ArrayTypeInfo& arrInfo = sc->knownTypes.data[leftType].AsArrayTypeInfo();
+	if (arrInfo.isSoA || arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+		return false;
+	}
+
+	*outLength = arrInfo.arrayLen;
+	return true;
+}
+
+static void OutputIRValueToCCode(const BNCIRFunction* func, int value, ASTNode* funcNode, SemanticContext* sc, FILE* fileHandle) {
+	const BNCIRInst& inst = func->insts.data[value];
+	switch (inst.op) {
+	case IROP_IntConst: {
+		if (inst.type == GetSimpleTypeIndex(STATIC_TO_SUBSTRING("bool"), sc)) {
+			fprintf(fileHandle, "%s", inst.intValue ? "true" : "false");
+		}
+		else if (inst.intValue == INT_MIN) {
+			fprintf(fileHandle, "(-2147483647 - 1)");
+		}
+		else {
+			fprintf(fileHandle, (inst.intValue < 0) ? "(%d)" : "%d", inst.intValue);
+		}
+	} break;
+
+	case IROP_FloatConst: {
+		// Enough digits to get the same float back, written as a floating literal like ANT_FloatLiteral
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.9g", inst.floatValue);
+		bool isIntegral = (strpbrk(buffer, ".e") == nullptr);
+		fprintf(fileHandle, signbit(inst.floatValue) ? "(%s%s)" : "%s%s", buffer, isIntegral ? ".0" : "");
+	} break;
+
+	case IROP_Param: {
+		ASTNode* param = &funcNode->ast->nodes.data[funcNode->FunctionDefinition_value.params.data[inst.intValue]];
+		OutputASTToCCode(&funcNode->ast->nodes.data[param->VariableDecl_value.varName], sc, fileHandle);
+	} break;
+
+	default: {
+		fprintf(fileHandle, "bnc_v%d", value);
+	} break;
+	}
+}
+
+static const char* GetIROpCString(BNCIROp op) {
+	switch (op) {
+	case IROP_Neg:          { return "-";  } break;
+	case IROP_Not:          { return "!";  } break;
+	case IROP_Add:          { return "+";  } break;
+	case IROP_Sub:          { return "-";  } break;
+	case IROP_Mul:          { return "*";  } break;
+	case IROP_Div:          { return "/";  } break;
+	case IROP_Equal:        { return "=="; } break;
+	case IROP_Less:         { return "<";  } break;
+	case IROP_LessEqual:    { return "<="; } break;
+	case IROP_Greater:      { return ">";  } break;
+	case IROP_GreaterEqual: { return ">="; } break;
+	default: { ASSERT(false); return ""; }
+	}
+}
 
-				fprintf(fileHandle, "struct %.*s {\n", BNS_LEN_START(ptr->name));
-				BNS_VEC_FOREACH_NAME(ptr->fieldDecls, declPtr) {
-					ASTNode* node = &ast->nodes.data[declPtr->idx];
-					fprintf(fileHandle, "\t");
-					OutputASTToCCode(node, sc, fileHandle, false);
-					fprintf(fileHandle, ";\n");
-				}
-				fprintf(fileHandle, "};\n");
+// Every live value that isn't a constant or a parameter gets its own bnc_v local, in IR order.
+// Calls only kept for their side effects are written as plain statements
+static void OutputIRFunctionBodyToCCode(const BNCIRFunction* func, ASTNode* funcNode, SemanticContext* sc, FILE* fileHandle) {
+	Vector<bool> isUsed;
+	for (int i = 0; i < func->insts.count; i++) {
+		isUsed.PushBack(false);
+	}
 
-				StructDef temp = *ptr;
-				*ptr = structsToDefine.data[structsToDefine.count - 1];
-				structsToDefine.data[structsToDefine.count - 1] = temp;
-				structsToDefine.PopBack();
-				ptr--;
-				madeProgress = true;
+	isUsed.data[func->result] = true;
+	BNS_VEC_FOREACH(func->insts) {
+		if (!ptr->isDead) {
+			for (int j = 0; j < 2; j++) {
+				if (ptr->args[j] >= 0) {
+					isUsed.data[ptr->args[j]] = true;
+				}
+			}
+			BNS_VEC_FOREACH_NAME(ptr->callArgs, argPtr) {
+				isUsed.data[*argPtr] = true;
 			}
-		}
-
-		if (!madeProgress) {
-			printf("Error, could not make progress in struct definition graph.\n");
-			ASSERT(false);
-			return false;
 		}
 	}
 
-	return true;
-}
-
-void OutputFunctionHeaderToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle) {
-	OutputASTToCCode(&node->ast->nodes.data[node->FunctionDefinition_value.returnType], sc, fileHandle);
-	fprintf(fileHandle, " ");
-	OutputASTToCCode(&node->ast->nodes.data[node->FunctionDefinition_value.name], sc, fileHandle);
-	fprintf(fileHandle, "(");
-	bool first = true;
-	BNS_VEC_FOREACH(node->FunctionDefinition_value.params) {
-		if (!first) {
-			fprintf(fileHandle, ", ");
+	fprintf(fileHandle, "{\n");
+	for (int i = 0; i < func->insts.count; i++) {
+		const BNCIRInst& inst = func->insts.data[i];
+		if (inst.isDead || inst.op == IROP_IntConst || inst.op == IROP_FloatConst || inst.op == IROP_Param) {
+			continue;
 		}
 
-		ASTNode* param = &node->ast->nodes.data[*ptr];
-		OutputASTToCCode(param, sc, fileHandle);
+		if (isUsed.data[i]) {
+			OutputTypeIndexToCCode(inst.type, sc, fileHandle);
+			fprintf(fileHandle, " bnc_v%d = ", i);
+		}
 
-		first = false;
+		if (inst.op == IROP_Call) {
+			const FuncDef* callee = &sc->definedFunctions.data[inst.intValue];
+			fprintf(fileHandle, "%.*s(", BNS_LEN_START(callee->name));
+			BNS_VEC_FOREACH(inst.callArgs) {
+				fprintf(fileHandle, (ptr == inst.callArgs.data) ? "" : ", ");
+				OutputIRValueToCCode(func, *ptr, funcNode, sc, fileHandle);
+			}
+			fprintf(fileHandle, ")");
+		}
+		else if (inst.op == IROP_Neg || inst.op == IROP_Not) {
+			fprintf(fileHandle, "%s", GetIROpCString(inst.op));
+			OutputIRValueToCCode(func, inst.args[0], funcNode, sc, fileHandle);
+		}
+		else {
+			OutputIRValueToCCode(func, inst.args[0], funcNode, sc, fileHandle);
+			fprintf(fileHandle, " %s ", GetIROpCString(inst.op));
+			OutputIRValueToCCode(func, inst.args[1], funcNode, sc, fileHandle);
+		}
+		fprintf(fileHandle, ";\n");
 	}
-	fprintf(fileHandle, ")");
+
+	fprintf(fileHandle, "return ");
+	OutputIRValueToCCode(func, func->result, funcNode, sc, fileHandle);
+	fprintf(fileHandle, ";\n}\n");
 }
 
 void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool writeVarDeclInit /*= true*/) {
@@ -85,14 +1318,25 @@ void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool
 	case ANT_BoolLiteral:    { fprintf(fileHandle, "%s", node->BoolLiteral_value.val ? "true" : "false"); } break;
 
 	case ANT_TypeSimple: {
-		const SubString& typeName = node->ast->nodes.data[node->TypeSimple_value.name].Identifier_value.name;
-		TypeIndex typeIdx = GetSimpleTypeIndex(typeName, sc);
+		TypeIndex typeIdx = GetTypeIndex(node, sc);
+
+		ASTNode* nameNode = &node->ast->nodes.data[node->TypeSimple_value.name];
+		if (nameNode->type == ANT_TypeGeneric) {
+			if (typeIdx >= 0) {
+				OutputTypeIndexToCCode(typeIdx, sc, fileHandle);
+			}
+			else {
+				// Semantics already reported why it couldn't be instantiated
+				OutputASTToCCode(&node->ast->nodes.data[nameNode->TypeGeneric_value.childType], sc, fileHandle);
+			}
+			break;
+		}
 
-		if (sc->knownTypes.data[typeIdx].type == TypeInfo::UE_StructTypeInfo) {
+		if (typeIdx >= 0 && sc->knownTypes.data[typeIdx].type == TypeInfo::UE_StructTypeInfo) {
 			fprintf(fileHandle, "struct ");
 		}
 
-		OutputASTToCCode(&node->ast->nodes.data[node->TypeSimple_value.name], sc, fileHandle);
+		OutputASTToCCode(nameNode, sc, fileHandle);
 	} break;
 
 	case ANT_TypePointer: {
@@ -100,6 +1344,21 @@ void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool
 		fprintf(fileHandle, "*");
 	} break;
 
+	case ANT_TypeArray: {
+		if (node->TypeArray_value.isSoA) {
+			TypeIndex typeIdx = GetTypeIndex(node, sc);
+			OutputSoAContainerName(sc->knownTypes.data[typeIdx].AsArrayTypeInfo(), sc, fileHandle);
+		}
+		else if (node->TypeArray_value.length == ARRAY_DYNAMIC_LEN) {
+			OutputSliceTypeName(GetTypeIndex(node, sc), sc, fileHandle);
+		}
+		else {
+			// Outside of a declarator, arrays decay to pointers
+			OutputASTToCCode(&node->ast->nodes.data[node->TypeArray_value.childType], sc, fileHandle);
+			fprintf(fileHandle, "*");
+		}
+	} break;
+
 	case ANT_VariableDecl: {
 		ASTNode* typeNode = &node->ast->nodes.data[node->VariableDecl_value.type];
 		ASTNode* varNode  = &node->ast->nodes.data[node->VariableDecl_value.varName];
@@ -108,14 +1367,36 @@ void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool
 			initNode = &node->ast->nodes.data[node->VariableDecl_value.initValue];
 		}
 
-		OutputASTToCCode(typeNode, sc, fileHandle);
-		fprintf(fileHandle, " ");
-		OutputASTToCCode(varNode, sc, fileHandle);
+		OutputDeclaratorToCCode(typeNode, varNode, sc, fileHandle);
 
-		if (writeVarDeclInit && initNode != nullptr) {
+		if (writeVarDeclInit && initNode != nullptr && GetOutPointerCallee(initNode, sc) != nullptr) {
+			fprintf(fileHandle, ";\n");
+			OutputCallStartToCCode(initNode, sc, fileHandle);
+			fprintf(fileHandle, ", &");
+			OutputASTToCCode(varNode, sc, fileHandle);
+			fprintf(fileHandle, ")");
+		}
+		else if (writeVarDeclInit && initNode != nullptr) {
 			fprintf(fileHandle, " = ");
-			OutputASTToCCode(initNode, sc, fileHandle);
+			OutputValueToCCode(initNode, sc, fileHandle);
+		}
+	} break;
+
+	case ANT_VariableAssign: {
+		ASTNode* varNode = &node->ast->nodes.data[node->VariableAssign_value.var];
+		ASTNode* valNode = &node->ast->nodes.data[node->VariableAssign_value.val];
+
+		if (GetOutPointerCallee(valNode, sc) != nullptr) {
+			OutputCallStartToCCode(valNode, sc, fileHandle);
+			fprintf(fileHandle, ", &");
+			OutputASTToCCode(varNode, sc, fileHandle);
+			fprintf(fileHandle, ")");
+			break;
 		}
+
+		OutputASTToCCode(varNode, sc, fileHandle);
+		fprintf(fileHandle, " = ");
+		OutputValueToCCode(valNode, sc, fileHandle);
 	} break;
 
 	case ANT_StructDefinition: {
@@ -140,63 +1421,162 @@ void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool
 	case ANT_FunctionDefinition: {
 		OutputFunctionHeaderToCCode(node, sc, fileHandle);
 
-		ASTNode* body = &node->ast->nodes.data[node->FunctionDefinition_value.bodyScope];
-		OutputASTToCCode(body, sc, fileHandle);
+		FuncDef* def = GetResolvedFuncDef(node, sc);
+		BNCIRFunction irFunc;
+		if (sc->options.lowerThroughSSA && def != nullptr && BuildIRForFunction(def, sc, &irFunc)) {
+			OptimizeIRFunction(&irFunc, sc);
+			OutputIRFunctionBodyToCCode(&irFunc, node, sc, fileHandle);
+		}
+		else {
+			ASTNode* body = &node->ast->nodes.data[node->FunctionDefinition_value.bodyScope];
+			OutputASTToCCode(body, sc, fileHandle);
+		}
 	} break;
 
 	case ANT_ArrayAccess: { 
 		ASTNode* arrNode = &node->ast->nodes.data[node->ArrayAccess_value.arr];
 		ASTNode* idxNode = &node->ast->nodes.data[node->ArrayAccess_value.index];
 
+		TypeIndex arrType;
+		NodeInfo* info = GetNodeInfo(node, sc);
+		bool needsCheck = sc->options.boundsChecks && !(info != nullptr && (info->flags & NIF_IndexInBounds));
+		if (TypeCheckValue(arrNode, sc, &arrType) == TCR_Success && IsSliceType(arrType, sc)) {
+			if (needsCheck) {
+				fprintf(fileHandle, "(*");
+				OutputSliceTypeName(arrType, sc, fileHandle);
+				fprintf(fileHandle, "_at(");
+				OutputASTToCCode(arrNode, sc, fileHandle);
+				fprintf(fileHandle, ", ");
+				OutputASTToCCode(idxNode, sc, fileHandle);
+				fprintf(fileHandle, "))");
+			}
+			else {
+				OutputASTToCCode(arrNode, sc, fileHandle);
+				fprintf(fileHandle, ".data[");
+				OutputASTToCCode(idxNode, sc, fileHandle);
+				fprintf(fileHandle, "]");
+			}
+			break;
+		}
+
 		OutputASTToCCode(arrNode, sc, fileHandle);
 		fprintf(fileHandle, "[");
-		OutputASTToCCode(arrNode, sc, fileHandle);
+		if (needsCheck && sc->knownTypes.data[arrType].type == TypeInfo::UE_ArrayTypeInfo) {
+			fprintf(fileHandle, "bnc_check_index(");
+			OutputASTToCCode(idxNode, sc, fileHandle);
+			fprintf(fileHandle, ", %d)", sc->knownTypes.data[arrType].AsArrayTypeInfo().arrayLen);
+		}
+		else {
+			OutputASTToCCode(idxNode, sc, fileHandle);
+		}
 		fprintf(fileHandle, "]");
 	} break;
 
 	case ANT_BinaryOp: {
-		ASTNode* lNode = &node->ast->nodes.data[node->BinaryOp_value.left];
-		ASTNode* rNode = &node->ast->nodes.data[node->BinaryOp_value.right];
+		// Chains of binary ops can be as long as the input, so they're walked with an explicit stack.
+		// An op is pushed twice: once to visit it, and once to print it between its operands
+		Vector<BinaryOpWorkItem> stack;
+		BinaryOpWorkItem rootItem = { node->GetIndex(), false };
+		stack.PushBack(rootItem);
+		while (stack.count > 0) {
+			BinaryOpWorkItem item = stack.Back();
+			stack.PopBack();
+
+			ASTNode* curr = &node->ast->nodes.data[item.node];
+			int fixedLength;
+			if (item.emitOp) {
+				fprintf(fileHandle, "%s", curr->BinaryOp_value.op);
+			}
+			else if (curr->type == ANT_BinaryOp && GetFixedArrayLengthAccess(curr, sc, &fixedLength)) {
+				fprintf(fileHandle, "%d", fixedLength);
+			}
+			else if (curr->type == ANT_BinaryOp && StrEqual(curr->BinaryOp_value.op, ".")
+				&& IsPointerParamUse(&node->ast->nodes.data[curr->BinaryOp_value.left], sc)) {
+				ASTNode* param = &node->ast->nodes.data[curr->BinaryOp_value.left];
+				fprintf(fileHandle, "%.*s->", BNS_LEN_START(param->Identifier_value.name));
+				BinaryOpWorkItem rightItem = { curr->BinaryOp_value.right, false };
+				stack.PushBack(rightItem);
+			}
+			else if (curr->type == ANT_BinaryOp) {
+				BinaryOpWorkItem rightItem = { curr->BinaryOp_value.right, false };
+				BinaryOpWorkItem opItem = { item.node, true };
+				BinaryOpWorkItem leftItem = { curr->BinaryOp_value.left, false };
+				stack.PushBack(rightItem);
+				stack.PushBack(opItem);
+				stack.PushBack(leftItem);
+			}
+			else {
+				OutputASTToCCode(curr, sc, fileHandle);
+			}
+		}
+	} break;
 
-		OutputASTToCCode(lNode, sc, fileHandle);
-		fprintf(fileHandle, "%s", node->BinaryOp_value.op);
-		OutputASTToCCode(rNode, sc, fileHandle);
+	case ANT_Parentheses: {
+		fprintf(fileHandle, "(");
+		OutputASTToCCode(&node->ast->nodes.data[node->Parentheses_value.val], sc, fileHandle);
+		fprintf(fileHandle, ")");
 	} break;
 
 	case ANT_UnaryOp: {
+		ASTNode* valnode = &node->ast->nodes.data[node->UnaryOp_value.val];
 		if (StrEqual(node->UnaryOp_value.op, "^")) {
 			fprintf(fileHandle, node->UnaryOp_value.isPre ? "*" : "&");
+			OutputASTToCCode(valnode, sc, fileHandle);
+		}
+		else if (node->UnaryOp_value.isPre) {
+			fprintf(fileHandle, "%s", node->UnaryOp_value.op);
+			OutputASTToCCode(valnode, sc, fileHandle);
 		}
 		else {
+			OutputASTToCCode(valnode, sc, fileHandle);
 			fprintf(fileHandle, "%s", node->UnaryOp_value.op);
-			OutputASTToCCode(&node->ast->nodes.data[node->UnaryOp_value.val], sc, fileHandle);
 		}
-
-		ASTNode* valnode = &node->ast->nodes.data[node->UnaryOp_value.val];
-		OutputASTToCCode(valnode, sc, fileHandle);
 	} break;
 
 	case ANT_FunctionCall: {
-		ASTNode* func = &node->ast->nodes.data[node->FunctionCall_value.func];
-		OutputASTToCCode(func, sc, fileHandle);
+		if (IsLayoutIntrinsicCall(node)) {
+			// Use our own layout, so the generated code agrees with compile-time evaluation
+			fprintf(fileHandle, "%d", EvaluateLayoutIntrinsic(node, sc));
+			break;
+		}
 
-		fprintf(fileHandle, "(");
-		bool isFirst = true;
-		BNS_VEC_FOREACH(node->FunctionCall_value.args) {
-			ASTNode* arg = &node->ast->nodes.data[*ptr];
-			if (!isFirst) {
-				fprintf(fileHandle, ", ");
+		ASTNode* func = &node->ast->nodes.data[node->FunctionCall_value.func];
+		if (IsVectorConstructorCall(node, sc)) {
+			const Vector<ASTIndex>& args = node->FunctionCall_value.args;
+			if (args.count == 1) {
+				// Adding a scalar to a zero vector broadcasts it to every lane
+				fprintf(fileHandle, "((");
+				OutputASTToCCode(func, sc, fileHandle);
+				fprintf(fileHandle, "){0} + (");
+				OutputASTToCCode(&node->ast->nodes.data[args.data[0]], sc, fileHandle);
+				fprintf(fileHandle, "))");
 			}
-
-			OutputASTToCCode(arg, sc, fileHandle);
-
-			isFirst = false;
+			else {
+				fprintf(fileHandle, "((");
+				OutputASTToCCode(func, sc, fileHandle);
+				fprintf(fileHandle, "){");
+				for (int i = 0; i < args.count; i++) {
+					if (i > 0) {
+						fprintf(fileHandle, ", ");
+					}
+					OutputASTToCCode(&node->ast->nodes.data[args.data[i]], sc, fileHandle);
+				}
+				fprintf(fileHandle, "})");
+			}
+			break;
 		}
+
+		OutputCallStartToCCode(node, sc, fileHandle);
 		fprintf(fileHandle, ")");
 	} break;
 
 	case ANT_Identifier: {
-		fprintf(fileHandle, "%.*s", BNS_LEN_START(node->Identifier_value.name));
+		if (IsPointerParamUse(node, sc)) {
+			fprintf(fileHandle, "(*%.*s)", BNS_LEN_START(node->Identifier_value.name));
+		}
+		else {
+			fprintf(fileHandle, "%.*s", BNS_LEN_START(node->Identifier_value.name));
+		}
 	} break;
 
 	case ANT_Statement: {
@@ -206,9 +1586,32 @@ void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool
 	} break;
 
 	case ANT_ReturnStatement: {
-		fprintf(fileHandle, "return ");
 		ASTNode* retVal = &node->ast->nodes.data[node->ReturnStatement_value.retVal];
-		OutputASTToCCode(retVal, sc, fileHandle);
+		NodeInfo* info = GetNodeInfo(node, sc);
+		FuncDef* outPointerCallee = GetOutPointerCallee(retVal, sc);
+		if (info != nullptr && (info->flags & NIF_ReturnsThroughPointer)) {
+			// The callee can write straight into our own out-pointer
+			if (outPointerCallee != nullptr) {
+				OutputCallStartToCCode(retVal, sc, fileHandle);
+				fprintf(fileHandle, ", bnc_ret);\nreturn");
+			}
+			else {
+				fprintf(fileHandle, "*bnc_ret = ");
+				OutputValueToCCode(retVal, sc, fileHandle);
+				fprintf(fileHandle, ";\nreturn");
+			}
+		}
+		else if (outPointerCallee != nullptr) {
+			fprintf(fileHandle, "{ ");
+			OutputTypeIndexToCCode(outPointerCallee->retType, sc, fileHandle);
+			fprintf(fileHandle, " bnc_ret;\n");
+			OutputCallStartToCCode(retVal, sc, fileHandle);
+			fprintf(fileHandle, ", &bnc_ret);\nreturn bnc_ret; }");
+		}
+		else {
+			fprintf(fileHandle, "return ");
+			OutputValueToCCode(retVal, sc, fileHandle);
+		}
 	} break;
 
 	case ANT_Scope: {
@@ -221,19 +1624,34 @@ void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool
 	} break;
 
 	case ANT_Root: {
-		fprintf(fileHandle, "\n//Struct definitions\n");
-		OutputStructDeclarations(sc, node->ast, fileHandle);
+		OutputCDeclarations(node, sc, fileHandle);
 
-		fprintf(fileHandle, "\n//Function declarations\n");
-		BNS_VEC_FOREACH(sc->definedFunctions) {
-			ASTNode* funcNode = &node->ast->nodes.data[ptr->idx];
-			OutputFunctionHeaderToCCode(funcNode, sc, fileHandle);
-			fprintf(fileHandle, ";\n");
+		bool inlining = sc->options.inlineSmallFunctions;
+		if (inlining) {
+			// Inlined bodies may reference globals, so those need to be declared before them
+			fprintf(fileHandle, "\n//Global variables\n");
+			BNS_VEC_FOREACH(node->Root_value.topLevelStatements) {
+				ASTNode* stmt = &node->ast->nodes.data[*ptr];
+				if (stmt->type != ANT_FunctionDefinition) {
+					OutputASTToCCode(stmt, sc, fileHandle);
+				}
+			}
+
+			OutputInlineFunctionDefinitions(node, sc, fileHandle);
 		}
 
 		fprintf(fileHandle, "\n//Function definitions\n");
 		BNS_VEC_FOREACH(node->Root_value.topLevelStatements) {
 			ASTNode* stmt = &node->ast->nodes.data[*ptr];
+			if (stmt->type == ANT_FunctionDefinition) {
+				if (!IsOutOfLineFunctionDefinition(stmt, sc)) {
+					continue;
+				}
+			}
+			else if (inlining) {
+				continue;
+			}
+
 			OutputASTToCCode(stmt, sc, fileHandle);
 		}
 	} break;
@@ -256,39 +1674,406 @@ bool CompileASTExpressionToByteCode(ASTNode* node, SemanticContext* sc, Vector<i
 		outCode->PushBack(*(int*)&node->FloatLiteral_value.val);
 	} break;
 
-	case ANT_BinaryOp: {
-		ASTNode* left  = &node->ast->nodes.data[node->BinaryOp_value.left];
-		ASTNode* right = &node->ast->nodes.data[node->BinaryOp_value.right];
-		CompileASTExpressionToByteCode(left,  sc, outCode);
-		CompileASTExpressionToByteCode(right, sc, outCode);
+	case ANT_FunctionCall: {
+		if (IsLayoutIntrinsicCall(node)) {
+			int val = EvaluateLayoutIntrinsic(node, sc);
+			if (val < 0) {
+				fprintf(sc->diagnosticsFile, "Error: layout of the type passed to '%.*s' is not known.\n",
+					BNS_LEN_START(node->ast->nodes.data[node->FunctionCall_value.func].Identifier_value.name));
+				return false;
+			}
 
-		if (StrEqual(node->BinaryOp_value.op, "+")) {
-			outCode->PushBack(BNCBI_Add);
+			outCode->PushBack(BNCBI_IntLit);
+			outCode->PushBack(val);
 		}
-		else if (StrEqual(node->BinaryOp_value.op, "-")) {
-			outCode->PushBack(BNCBI_Sub);
-		}
-		else if (StrEqual(node->BinaryOp_value.op, "*")) {
-			outCode->PushBack(BNCBI_Mul);
+		else {
+			const SubString& name = node->ast->nodes.data[node->FunctionCall_value.func].Identifier_value.name;
+			fprintf(sc->diagnosticsFile, "Error: '%.*s' cannot be called at compile time, only size_of, align_of and offset_of can.\n", BNS_LEN_START(name));
+			return false;
 		}
-		else if (StrEqual(node->BinaryOp_value.op, "/")) {
-			outCode->PushBack(BNCBI_Div);
+	} break;
+
+	case ANT_Parentheses: {
+		ASTNode* val = &node->ast->nodes.data[node->Parentheses_value.val];
+		return CompileASTExpressionToByteCode(val, sc, outCode);
+	} break;
+
+	case ANT_Identifier: {
+		for (int i = 0; i < sc->bytecodeInputNames.count; i++) {
+			if (node->Identifier_value.name == sc->bytecodeInputNames.data[i]) {
+				outCode->PushBack(BNCBI_LoadInput);
+				outCode->PushBack(i);
+				return true;
+			}
 		}
-		else {
-			ASSERT(false);
+
+		fprintf(sc->diagnosticsFile, "Error: '%.*s' cannot be evaluated at compile time.\n", BNS_LEN_START(node->Identifier_value.name));
+		return false;
+	} break;
+
+	case ANT_BinaryOp: {
+		// Walked with an explicit stack like in OutputASTToCCode, each op is emitted after both operands
+		Vector<BinaryOpWorkItem> stack;
+		BinaryOpWorkItem rootItem = { node->GetIndex(), false };
+		stack.PushBack(rootItem);
+		while (stack.count > 0) {
+			BinaryOpWorkItem item = stack.Back();
+			stack.PopBack();
+
+			ASTNode* curr = &node->ast->nodes.data[item.node];
+			if (item.emitOp) {
+				if (StrEqual(curr->BinaryOp_value.op, "+")) {
+					outCode->PushBack(BNCBI_Add);
+				}
+				else if (StrEqual(curr->BinaryOp_value.op, "-")) {
+					outCode->PushBack(BNCBI_Sub);
+				}
+				else if (StrEqual(curr->BinaryOp_value.op, "*")) {
+					outCode->PushBack(BNCBI_Mul);
+				}
+				else if (StrEqual(curr->BinaryOp_value.op, "/")) {
+					outCode->PushBack(BNCBI_Div);
+				}
+			}
+			else if (curr->type == ANT_BinaryOp) {
+				const char* op = curr->BinaryOp_value.op;
+				if (!StrEqual(op, "+") && !StrEqual(op, "-") && !StrEqual(op, "*") && !StrEqual(op, "/")) {
+					fprintf(sc->diagnosticsFile, "Error: operator '%s' cannot be evaluated at compile time.\n", op);
+					return false;
+				}
+
+				BinaryOpWorkItem opItem = { item.node, true };
+				BinaryOpWorkItem rightItem = { curr->BinaryOp_value.right, false };
+				BinaryOpWorkItem leftItem = { curr->BinaryOp_value.left, false };
+				stack.PushBack(opItem);
+				stack.PushBack(rightItem);
+				stack.PushBack(leftItem);
+			}
+			else if (!CompileASTExpressionToByteCode(curr, sc, outCode)) {
+				return false;
+			}
 		}
 	} break;
 
-	default: { ASSERT(false); return false; }
+	case ANT_UnaryOp: {
+		fprintf(sc->diagnosticsFile, "Error: operator '%s' cannot be evaluated at compile time.\n", node->UnaryOp_value.op);
+		return false;
+	} break;
+
+	default: {
+		fprintf(sc->diagnosticsFile, "Error: expression cannot be evaluated at compile time.\n");
+		return false;
+	} break;
+	}
+
+	return true;
+}
+
+// Shared values are emitted again for each use, since the VM has nowhere to keep them.
+// Fails without emitting anything if a live value has no bytecode, e.g. a comparison
+static bool CompileIRToByteCode(const BNCIRFunction* func, Vector<int>* outCode) {
+	BNS_VEC_FOREACH(func->insts) {
+		if (!ptr->isDead && (ptr->op == IROP_Neg || ptr->op >= IROP_Equal)) {
+			return false;
+		}
+	}
+
+	struct IREmitItem {
+		int value;
+		bool emitOp;
+	};
+
+	Vector<IREmitItem> stack;
+	IREmitItem rootItem = { func->result, false };
+	stack.PushBack(rootItem);
+	while (stack.count > 0) {
+		IREmitItem item = stack.Back();
+		stack.PopBack();
+
+		const BNCIRInst& inst = func->insts.data[item.value];
+		switch (inst.op) {
+		case IROP_IntConst: {
+			outCode->PushBack(BNCBI_IntLit);
+			outCode->PushBack(inst.intValue);
+		} break;
+
+		case IROP_FloatConst: {
+			outCode->PushBack(BNCBI_FloatLit);
+			outCode->PushBack(*(int*)&inst.floatValue);
+		} break;
+
+		case IROP_Add:
+		case IROP_Sub:
+		case IROP_Mul:
+		case IROP_Div: {
+			if (item.emitOp) {
+				const BNCBytecodeInstruction ops[] = { BNCBI_Add, BNCBI_Sub, BNCBI_Mul, BNCBI_Div };
+				outCode->PushBack(ops[inst.op - IROP_Add]);
+			}
+			else {
+				IREmitItem opItem = { item.value, true };
+				IREmitItem rightItem = { inst.args[1], false };
+				IREmitItem leftItem = { inst.args[0], false };
+				stack.PushBack(opItem);
+				stack.PushBack(rightItem);
+				stack.PushBack(leftItem);
+			}
+		} break;
+
+		default: {
+			ASSERT(false);
+			return false;
+		} break;
+		}
 	}
 
 	return true;
 }
 
+// Goes through the SSA IR when it's enabled and covers the expression, so it's folded before it runs
+static bool CompileExpressionToByteCode(ASTNode* node, SemanticContext* sc, Vector<int>* outCode) {
+	if (sc->options.lowerThroughSSA) {
+		BNCIRFunction irFunc;
+		if (BuildIRForExpression(node, sc, &irFunc)) {
+			OptimizeIRFunction(&irFunc, sc);
+			if (CompileIRToByteCode(&irFunc, outCode)) {
+				return true;
+			}
+		}
+	}
+
+	return CompileASTExpressionToByteCode(node, sc, outCode);
+}
+
+static BNCBytecodeValue RunCompileTimeBytecode(ASTNode* node, BNCBytecodeVMContext* context, SemanticContext* sc) {
+	Vector<int>* code = &context->code;
+	if (sc->options.optimizeBytecode) {
+		OptimizeBytecode(code);
+	}
+
+	BNCBytecodeVMState* state = &context->state;
+	if (sc->options.profileBytecode) {
+		state->profile = &sc->bytecodeProfile;
+
+		long long startTime = GetProfilerTimestampNanoseconds();
+		BNCBytecodeValue val = ExecuteBytecode(code->data, code->count, state);
+		long long endTime = GetProfilerTimestampNanoseconds();
+
+		BNCExpressionProfile exprProfile;
+		exprProfile.nodeIndex = (int)(node - node->ast->nodes.data);
+		exprProfile.codeLength = code->count;
+		exprProfile.nanoseconds = endTime - startTime;
+		sc->bytecodeProfile.expressions.PushBack(exprProfile);
+
+		return val;
+	}
+
+	if (sc->options.jitCompileTimeCode) {
+		return ExecuteBytecodeWithJit(code->data, code->count, state, &sc->jitCache);
+	}
+
+	BNCBytecodeVerifyResult verifyResult;
+	if (VerifyBytecode(code->data, code->count, &verifyResult)) {
+		return ExecuteVerifiedBytecode(code->data, code->count, verifyResult, state);
+	}
+	else {
+		// The checked interpreter will report where the stream goes wrong
+		return ExecuteBytecode(code->data, code->count, state);
+	}
+}
+
+// What an expression that couldn't be compiled evaluates to, the error has already been reported
+static BNCBytecodeValue GetCompileTimeErrorValue() {
+	BNCBytecodeValue val;
+	BNCByteCodeVoid voidVal;
+	val = voidVal;
+	return val;
+}
+
 BNCBytecodeValue CompileTimeInterpretASTExpression(ASTNode* node, SemanticContext* sc) {
-	Vector<int> code;
-	CompileASTExpressionToByteCode(node, sc, &code);
-	BNCBytecodeVMState state;
-	return ExecuteBytecode(code.data, code.count, &state);
+	BNCBytecodeVMContext* context = sc->vmPool.Acquire();
+	BNCBytecodeValue val = GetCompileTimeErrorValue();
+	if (CompileExpressionToByteCode(node, sc, &context->code)) {
+		val = RunCompileTimeBytecode(node, context, sc);
+	}
+	sc->vmPool.Release(context);
+
+	return val;
+}
+
+void CompileTimeInterpretASTExpressions(ASTNode** nodes, int nodeCount, SemanticContext* sc, Vector<BNCBytecodeValue>* outValues) {
+	BNCBytecodeVMContext* context = sc->vmPool.Acquire();
+	for (int i = 0; i < nodeCount; i++) {
+		context->Reset();
+		if (CompileExpressionToByteCode(nodes[i], sc, &context->code)) {
+			outValues->PushBack(RunCompileTimeBytecode(nodes[i], context, sc));
+		}
+		else {
+			outValues->PushBack(GetCompileTimeErrorValue());
+		}
+	}
+	sc->vmPool.Release(context);
+}
+
+
+static bool IsGlobalVariableStatement(ASTNode* stmt) {
+	if (stmt->type != ANT_Statement) {
+		return false;
+	}
+
+	ASTNode* root = &stmt->ast->nodes.data[stmt->Statement_value.root];
+	return root->type == ANT_VariableDecl;
+}
+
+static void OutputAsIdentifier(const char* str, FILE* fileHandle) {
+	for (const char* c = str; *c != '\0'; c++) {
+		bool isIdentChar = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9');
+		fputc(isIdentChar ? *c : '_', fileHandle);
+	}
+}
+
+struct ShardFunction {
+	int size;
+	int index;
+};
+
+// Largest first, with ties kept in source order so the assignment doesn't depend on qsort
+static int CompareShardFunctions(const void* a, const void* b) {
+	const ShardFunction* funcA = (const ShardFunction*)a;
+	const ShardFunction* funcB = (const ShardFunction*)b;
+	if (funcA->size != funcB->size) {
+		return (funcA->size > funcB->size) ? -1 : 1;
+	}
+
+	return funcA->index - funcB->index;
 }
 
+bool OutputShardedCCode(ASTNode* root, SemanticContext* sc, const char* pathPrefix, int shardCount) {
+	ASSERT(root->type == ANT_Root);
+	ASSERT(shardCount > 0);
+
+	Vector<char> headerPath;
+	for (const char* c = pathPrefix; *c != '\0'; c++) {
+		headerPath.PushBack(*c);
+	}
+	headerPath.PushBack('.');
+	headerPath.PushBack('h');
+	headerPath.PushBack('\0');
+
+	// Shards include the header by its file name, so they must be written next to it
+	const char* headerFileName = pathPrefix;
+	for (const char* c = pathPrefix; *c != '\0'; c++) {
+		if (*c == '/' || *c == '\\') {
+			headerFileName = c + 1;
+		}
+	}
+
+	FILE* header = fopen(headerPath.data, "wb");
+	if (header == nullptr) {
+		fprintf(sc->diagnosticsFile, "Error: could not open '%s' for writing.\n", headerPath.data);
+		return false;
+	}
+
+	fprintf(header, "#ifndef BNC_GENERATED_");
+	OutputAsIdentifier(headerFileName, header);
+	fprintf(header, "_H\n#define BNC_GENERATED_");
+	OutputAsIdentifier(headerFileName, header);
+	fprintf(header, "_H\n\n");
+
+	OutputCDeclarations(root, sc, header);
+
+	fprintf(header, "\n//Global variables\n");
+	BNS_VEC_FOREACH(root->Root_value.topLevelStatements) {
+		ASTNode* stmt = &root->ast->nodes.data[*ptr];
+		if (IsGlobalVariableStatement(stmt)) {
+			fprintf(header, "extern ");
+			OutputASTToCCode(&root->ast->nodes.data[stmt->Statement_value.root], sc, header, false);
+			fprintf(header, ";\n");
+		}
+	}
+
+	if (sc->options.inlineSmallFunctions) {
+		OutputInlineFunctionDefinitions(root, sc, header);
+	}
+
+	fprintf(header, "\n#endif\n");
+	fclose(header);
+
+	// Greedily assign the largest functions first, each to the currently lightest shard
+	Vector<ASTIndex> funcNodes;
+	Vector<int> funcSizes;
+	BNS_VEC_FOREACH(root->Root_value.topLevelStatements) {
+		ASTNode* stmt = &root->ast->nodes.data[*ptr];
+		if (stmt->type == ANT_FunctionDefinition && IsOutOfLineFunctionDefinition(stmt, sc)) {
+			funcNodes.PushBack(*ptr);
+			funcSizes.PushBack(CountASTNodes(stmt));
+		}
+	}
+
+	Vector<int> funcShards;
+	Vector<int> shardSizes;
+	for (int i = 0; i < funcNodes.count; i++) {
+		funcShards.PushBack(-1);
+	}
+	for (int i = 0; i < shardCount; i++) {
+		shardSizes.PushBack(0);
+	}
+
+	Vector<ShardFunction> bySize;
+	for (int i = 0; i < funcNodes.count; i++) {
+		ShardFunction func = { funcSizes.data[i], i };
+		bySize.PushBack(func);
+	}
+	if (bySize.count > 0) {
+		qsort(bySize.data, bySize.count, sizeof(ShardFunction), CompareShardFunctions);
+	}
+
+	BNS_VEC_FOREACH(bySize) {
+		int largest = ptr->index;
+
+		int lightest = 0;
+		for (int i = 1; i < shardCount; i++) {
+			if (shardSizes.data[i] < shardSizes.data[lightest]) {
+				lightest = i;
+			}
+		}
+
+		funcShards.data[largest] = lightest;
+		shardSizes.data[lightest] += funcSizes.data[largest];
+	}
+
+	for (int shard = 0; shard < shardCount; shard++) {
+		char shardPath[1024];
+		snprintf(shardPath, sizeof(shardPath), "%s_%d.c", pathPrefix, shard);
+
+		FILE* shardFile = fopen(shardPath, "wb");
+		if (shardFile == nullptr) {
+			fprintf(sc->diagnosticsFile, "Error: could not open '%s' for writing.\n", shardPath);
+			return false;
+		}
+
+		fprintf(shardFile, "#include \"%s.h\"\n", headerFileName);
+
+		// Global variables are defined once, in the first shard
+		if (shard == 0) {
+			fprintf(shardFile, "\n//Global variables\n");
+			BNS_VEC_FOREACH(root->Root_value.topLevelStatements) {
+				ASTNode* stmt = &root->ast->nodes.data[*ptr];
+				if (IsGlobalVariableStatement(stmt)) {
+					OutputASTToCCode(stmt, sc, shardFile);
+				}
+			}
+		}
+
+		fprintf(shardFile, "\n//Function definitions\n");
+		for (int i = 0; i < funcNodes.count; i++) {
+			if (funcShards.data[i] == shard) {
+				OutputASTToCCode(&root->ast->nodes.data[funcNodes.data[i]], sc, shardFile);
+			}
+		}
+
+		fclose(shardFile);
+	}
+
+	return true;
+}
@@ -4,13 +4,23 @@
 #pragma once
 
 #include "bytecode.h"
+#include "jit.h"
 #include "AST.h"
 #include "semantics.h"
+#include "ir.h"
 
 bool CompileASTExpressionToByteCode(ASTNode* node, SemanticContext* sc, Vector<int>* outCode);
 
 BNCBytecodeValue CompileTimeInterpretASTExpression(ASTNode* node, SemanticContext* sc);
 
+// Evaluates several constant expressions in one pass through a single pooled VM context,
+// appending one value per node (void for those that couldn't be compiled)
+void CompileTimeInterpretASTExpressions(ASTNode** nodes, int nodeCount, SemanticContext* sc, Vector<BNCBytecodeValue>* outValues);
+
 void OutputASTToCCode(ASTNode* node, SemanticContext* sc, FILE* fileHandle, bool writeVarDeclInit = true);
 
+// Writes <pathPrefix>.h with types, prototypes and extern globals, and function definitions
+// spread over <pathPrefix>_0.c ... <pathPrefix>_<shardCount-1>.c, balanced by AST size
+bool OutputShardedCCode(ASTNode* root, SemanticContext* sc, const char* pathPrefix, int shardCount);
+
 #endif
@@ -1,29 +1,176 @@
 #include "bytecode.h"
 
+#include <chrono>
+
+const char* const bytecodeInstructionNames[BNCBI_Count] = {
+	"Add",
+	"Mul",
+	"Sub",
+	"Div",
+	"FloatLit",
+	"IntLit",
+	"AddIntLit",
+	"MulIntLit",
+	"SubIntLit",
+	"DivIntLit",
+	"AddFloatLit",
+	"MulFloatLit",
+	"SubFloatLit",
+	"DivFloatLit",
+	"LoadInput"
+};
+
+int BNCStringTable::Intern(const String& str) {
+	for (int i = 0; i < strings.count; i++) {
+		if (strings.data[i] == str) {
+			return i;
+		}
+	}
+
+	strings.PushBack(str);
+	return strings.count - 1;
+}
+
+BNCBytecodeVMPool::~BNCBytecodeVMPool() {
+	ASSERT(inUseCount == 0);
+	BNS_VEC_FOREACH(contexts) {
+		delete *ptr;
+	}
+}
+
+BNCBytecodeVMContext* BNCBytecodeVMPool::Acquire() {
+	if (inUseCount == contexts.count) {
+		contexts.PushBack(new BNCBytecodeVMContext());
+	}
+
+	BNCBytecodeVMContext* context = contexts.data[inUseCount];
+	inUseCount++;
+	context->Reset();
+	return context;
+}
+
+void BNCBytecodeVMPool::Release(BNCBytecodeVMContext* context) {
+	ASSERT(inUseCount > 0);
+	ASSERT(contexts.data[inUseCount - 1] == context);
+	inUseCount--;
+}
+
+BNCCompactValue ValueToCompact(const BNCBytecodeValue& val, BNCStringTable* stringTable) {
+	if (val.type == BNCBytecodeValue::UE_BNCByteCodeInt) {
+		return CompactInt(val.AsBNCByteCodeInt());
+	}
+	else if (val.type == BNCBytecodeValue::UE_BNCByteCodeFloat) {
+		return CompactFloat(val.AsBNCByteCodeFloat());
+	}
+	else if (val.type == BNCBytecodeValue::UE_String) {
+		return MakeCompactValue(BNCCVT_String, (unsigned int)stringTable->Intern(val.AsString()));
+	}
+	else {
+		return MakeCompactValue(BNCCVT_Void, 0);
+	}
+}
+
+BNCBytecodeValue CompactToValue(BNCCompactValue val, const BNCStringTable* stringTable) {
+	BNCBytecodeValue out;
+	switch (GetCompactTag(val)) {
+	case BNCCVT_Int: {
+		out = BNCByteCodeInt(CompactAsInt(val));
+	} break;
+
+	case BNCCVT_Float: {
+		out = BNCByteCodeFloat(CompactAsFloat(val));
+	} break;
+
+	case BNCCVT_String: {
+		out = stringTable->Get((int)GetCompactPayload(val));
+	} break;
+
+	default: {
+		BNCByteCodeVoid voidVal;
+		out = voidVal;
+	} break;
+	}
+
+	return out;
+}
+
+int GetBytecodeInstructionLength(int inst) {
+	switch (inst) {
+	case BNCBI_Add:
+	case BNCBI_Mul:
+	case BNCBI_Sub:
+	case BNCBI_Div: {
+		return 1;
+	} break;
+
+	default: {
+		return 2;
+	} break;
+	}
+}
 
 BNCBytecodeValue ExecuteBytecode(int* code, int codeLen, BNCBytecodeVMState* state) {
+	int prevInst = -1;
 	for (int i = 0; i < codeLen; i++) {
 		int inst = code[i];
+		if (state->profile != nullptr) {
+			state->profile->RecordInstruction(prevInst, inst);
+			prevInst = inst;
+		}
+
 		switch (inst) {
-		case BNCBI_Add: { state->Push(BNCValue_Add(state->Pop(), state->Pop())); } break;
-		case BNCBI_Sub: { state->Push(BNCValue_Sub(state->Pop(), state->Pop())); } break;
-		case BNCBI_Mul: { state->Push(BNCValue_Mul(state->Pop(), state->Pop())); } break;
-		case BNCBI_Div: { state->Push(BNCValue_Div(state->Pop(), state->Pop())); } break;
+		// Operands are popped into locals first, since argument evaluation order is unspecified
+#define BNC_BINARY_INST(name) \
+		case BNS_GLUE_TOKS(BNCBI_, name): { \
+			BNCCompactValue b = state->Pop(); \
+			BNCCompactValue a = state->Pop(); \
+			state->Push(BNS_GLUE_TOKS(BNCValue_, name)(a, b)); \
+		} break;
+
+		BNC_BINARY_INST(Add)
+		BNC_BINARY_INST(Sub)
+		BNC_BINARY_INST(Mul)
+		BNC_BINARY_INST(Div)
+#undef BNC_BINARY_INST
+
+#define BNC_LITERAL_INST(name, type) \
+		case BNS_GLUE_TOKS(BNS_GLUE_TOKS(BNCBI_, name), BNS_GLUE_TOKS(type, Lit)): { \
+			i++; \
+			BNCCompactValue a = state->Pop(); \
+			BNCCompactValue b = BNS_GLUE_TOKS(Compact, type)(*(BNS_GLUE_TOKS(BNC_LIT_CTYPE_, type)*)&code[i]); \
+			state->Push(BNS_GLUE_TOKS(BNCValue_, name)(a, b)); \
+		} break;
+#define BNC_LIT_CTYPE_Int int
+#define BNC_LIT_CTYPE_Float float
+
+		BNC_LITERAL_INST(Add, Int)
+		BNC_LITERAL_INST(Sub, Int)
+		BNC_LITERAL_INST(Mul, Int)
+		BNC_LITERAL_INST(Div, Int)
+		BNC_LITERAL_INST(Add, Float)
+		BNC_LITERAL_INST(Sub, Float)
+		BNC_LITERAL_INST(Mul, Float)
+		BNC_LITERAL_INST(Div, Float)
+#undef BNC_LIT_CTYPE_Int
+#undef BNC_LIT_CTYPE_Float
+#undef BNC_LITERAL_INST
+
+		case BNCBI_LoadInput: {
+			i++;
+			ASSERT(code[i] >= 0 && code[i] < state->inputCount);
+			state->Push(state->inputs[code[i]]);
+		} break;
 
 		case BNCBI_IntLit: {
 			i++;
 			int iVal = *(int*)&code[i];
-			BNCBytecodeValue val;
-			val = BNCByteCodeInt(iVal);
-			state->Push(val);
+			state->Push(CompactInt(iVal));
 		} break;
 
 		case BNCBI_FloatLit: {
 			i++;
 			float fVal = *(float*)&code[i];
-			BNCBytecodeValue val;
-			val = BNCByteCodeFloat(fVal);
-			state->Push(val);
+			state->Push(CompactFloat(fVal));
 		} break;
 		}
 	}
@@ -35,7 +182,7 @@ BNCBytecodeValue ExecuteBytecode(int* code, int codeLen, BNCBytecodeVMState* sta
 		return val;
 	}
 	else if (state->stack.count == 1) {
-		return state->Pop();
+		return CompactToValue(state->Pop(), &state->stringTable);
 	}
 	else {
 		ASSERT(false);
@@ -48,3 +195,441 @@ BNCBytecodeValue ExecuteBytecode(int* code, int codeLen, BNCBytecodeVMState* sta
 }
 
 
+
+bool VerifyBytecode(int* code, int codeLen, BNCBytecodeVerifyResult* outResult, const BNCCompactValueTag* inputTypes /*= nullptr*/, int inputCount /*= 0*/) {
+	outResult->isValid = false;
+	outResult->maxStackDepth = 0;
+	outResult->resultType = BNCCVT_Void;
+	outResult->error = nullptr;
+
+	Vector<BNCCompactValueTag> typeStack;
+	for (int i = 0; i < codeLen; i += GetBytecodeInstructionLength(code[i])) {
+		int inst = code[i];
+		if (inst < 0 || inst >= BNCBI_Count) {
+			outResult->error = "unknown opcode";
+			return false;
+		}
+
+		if (i + GetBytecodeInstructionLength(inst) > codeLen) {
+			outResult->error = "instruction is missing its operand";
+			return false;
+		}
+
+		switch (inst) {
+		case BNCBI_IntLit: {
+			typeStack.PushBack(BNCCVT_Int);
+		} break;
+
+		case BNCBI_FloatLit: {
+			typeStack.PushBack(BNCCVT_Float);
+		} break;
+
+		case BNCBI_Add:
+		case BNCBI_Mul:
+		case BNCBI_Sub:
+		case BNCBI_Div: {
+			if (typeStack.count < 2) {
+				outResult->error = "operator is missing an operand";
+				return false;
+			}
+
+			BNCCompactValueTag right = typeStack.Back();
+			typeStack.PopBack();
+			if (typeStack.Back() != right) {
+				outResult->error = "operator mixes ints and floats";
+				return false;
+			}
+		} break;
+
+		case BNCBI_LoadInput: {
+			int inputIndex = code[i + 1];
+			if (inputIndex < 0 || inputIndex >= inputCount) {
+				outResult->error = "input index is out of range";
+				return false;
+			}
+
+			typeStack.PushBack(inputTypes[inputIndex]);
+		} break;
+
+		default: {
+			BNCCompactValueTag literalType = (inst <= BNCBI_DivIntLit) ? BNCCVT_Int : BNCCVT_Float;
+			if (typeStack.count < 1) {
+				outResult->error = "operator is missing an operand";
+				return false;
+			}
+			else if (typeStack.Back() != literalType) {
+				outResult->error = "operator mixes ints and floats";
+				return false;
+			}
+		} break;
+		}
+
+		if (typeStack.count > outResult->maxStackDepth) {
+			outResult->maxStackDepth = typeStack.count;
+		}
+	}
+
+	if (typeStack.count > 1) {
+		outResult->error = "more than one value is left over";
+		return false;
+	}
+
+	outResult->resultType = (typeStack.count == 1) ? typeStack.Back() : BNCCVT_Void;
+	outResult->isValid = true;
+	return true;
+}
+
+// Unchecked versions of the math ops, the verifier has already matched up operand types
+#define BNC_FAST_MATH_OP(op, name)                                                                           \
+static inline BNCCompactValue BNS_GLUE_TOKS(BNCFastValue_, name) (BNCCompactValue a, BNCCompactValue b) {    \
+	unsigned int pa = GetCompactPayload(a);                                                                  \
+	unsigned int pb = GetCompactPayload(b);                                                                  \
+	if (GetCompactTag(a) == BNCCVT_Int) {                                                                    \
+		return CompactInt(BNS_GLUE_TOKS(BNCInt_, name)((int)pa, (int)pb));                                   \
+	}                                                                                                        \
+	else {                                                                                                   \
+		return CompactFloat(*(float*)&pa op *(float*)&pb);                                                   \
+	}                                                                                                        \
+}
+
+BNC_FAST_MATH_OP(+, Add)
+BNC_FAST_MATH_OP(-, Sub)
+BNC_FAST_MATH_OP(*, Mul)
+BNC_FAST_MATH_OP(/ , Div)
+
+#undef BNC_FAST_MATH_OP
+
+BNCBytecodeValue ExecuteVerifiedBytecode(int* code, int codeLen, const BNCBytecodeVerifyResult& verifyResult, BNCBytecodeVMState* state) {
+	ASSERT(verifyResult.isValid);
+
+	state->stack.EnsureCapacity(verifyResult.maxStackDepth);
+	BNCCompactValue* stack = state->stack.data;
+	int stackTop = 0;
+
+	for (int i = 0; i < codeLen; i++) {
+		int inst = code[i];
+		switch (inst) {
+#define BNC_BINARY_INST(name) \
+		case BNS_GLUE_TOKS(BNCBI_, name): { \
+			stackTop--; \
+			stack[stackTop - 1] = BNS_GLUE_TOKS(BNCFastValue_, name)(stack[stackTop - 1], stack[stackTop]); \
+		} break;
+
+		BNC_BINARY_INST(Add)
+		BNC_BINARY_INST(Sub)
+		BNC_BINARY_INST(Mul)
+		BNC_BINARY_INST(Div)
+#undef BNC_BINARY_INST
+
+#define BNC_LITERAL_INST(name, type) \
+		case BNS_GLUE_TOKS(BNS_GLUE_TOKS(BNCBI_, name), BNS_GLUE_TOKS(type, Lit)): { \
+			i++; \
+			stack[stackTop - 1] = BNS_GLUE_TOKS(BNCFastValue_, name)(stack[stackTop - 1], MakeCompactValue(BNS_GLUE_TOKS(BNCCVT_, type), (unsigned int)code[i])); \
+		} break;
+
+		BNC_LITERAL_INST(Add, Int)
+		BNC_LITERAL_INST(Sub, Int)
+		BNC_LITERAL_INST(Mul, Int)
+		BNC_LITERAL_INST(Div, Int)
+		BNC_LITERAL_INST(Add, Float)
+		BNC_LITERAL_INST(Sub, Float)
+		BNC_LITERAL_INST(Mul, Float)
+		BNC_LITERAL_INST(Div, Float)
+#undef BNC_LITERAL_INST
+
+		case BNCBI_IntLit: {
+			i++;
+			stack[stackTop] = MakeCompactValue(BNCCVT_Int, (unsigned int)code[i]);
+			stackTop++;
+		} break;
+
+		case BNCBI_FloatLit: {
+			i++;
+			stack[stackTop] = MakeCompactValue(BNCCVT_Float, (unsigned int)code[i]);
+			stackTop++;
+		} break;
+
+		case BNCBI_LoadInput: {
+			i++;
+			stack[stackTop] = state->inputs[code[i]];
+			stackTop++;
+		} break;
+		}
+	}
+
+	if (stackTop == 1) {
+		return CompactToValue(stack[0], &state->stringTable);
+	}
+	else {
+		BNCBytecodeValue val;
+		BNCByteCodeVoid voidVal;
+		val = voidVal;
+		return val;
+	}
+}
+
+union BNCBatchBlock {
+	int ints[BNC_BATCH_BLOCK_SIZE];
+	float floats[BNC_BATCH_BLOCK_SIZE];
+};
+
+void ExecuteBytecodeBatch(int* code, int codeLen, const BNCBytecodeVerifyResult& verifyResult,
+						  const BNCCompactValueTag* inputTypes, const void* const* inputColumns, int rowCount, void* outColumn) {
+	ASSERT(verifyResult.isValid);
+	ASSERT(verifyResult.resultType == BNCCVT_Int || verifyResult.resultType == BNCCVT_Float);
+
+	// Block types only change per instruction, not per row, so each loop below is branch-free
+	Vector<BNCBatchBlock> stackStorage;
+	stackStorage.EnsureCapacity(verifyResult.maxStackDepth);
+	BNCBatchBlock* stack = stackStorage.data;
+
+	Vector<BNCCompactValueTag> stackTypeStorage;
+	stackTypeStorage.EnsureCapacity(verifyResult.maxStackDepth);
+	BNCCompactValueTag* stackTypes = stackTypeStorage.data;
+
+	for (int rowStart = 0; rowStart < rowCount; rowStart += BNC_BATCH_BLOCK_SIZE) {
+		int blockRows = rowCount - rowStart;
+		if (blockRows > BNC_BATCH_BLOCK_SIZE) {
+			blockRows = BNC_BATCH_BLOCK_SIZE;
+		}
+
+		int stackTop = 0;
+		for (int i = 0; i < codeLen; i++) {
+			int inst = code[i];
+			switch (inst) {
+			case BNCBI_IntLit:
+			case BNCBI_FloatLit: {
+				i++;
+				int bits = code[i];
+				int* dst = stack[stackTop].ints;
+				for (int r = 0; r < blockRows; r++) {
+					dst[r] = bits;
+				}
+				stackTypes[stackTop] = (inst == BNCBI_IntLit) ? BNCCVT_Int : BNCCVT_Float;
+				stackTop++;
+			} break;
+
+			case BNCBI_LoadInput: {
+				i++;
+				int inputIndex = code[i];
+				const char* column = (const char*)inputColumns[inputIndex];
+				MemCpy(stack[stackTop].ints, column + rowStart * sizeof(int), blockRows * sizeof(int));
+				stackTypes[stackTop] = inputTypes[inputIndex];
+				stackTop++;
+			} break;
+
+#define BNC_BATCH_BINARY_INST(name, op) \
+			case BNS_GLUE_TOKS(BNCBI_, name): { \
+				stackTop--; \
+				BNCBatchBlock* a = &stack[stackTop - 1]; \
+				const BNCBatchBlock* b = &stack[stackTop]; \
+				if (stackTypes[stackTop - 1] == BNCCVT_Int) { \
+					for (int r = 0; r < blockRows; r++) { a->ints[r] = BNS_GLUE_TOKS(BNCInt_, name)(a->ints[r], b->ints[r]); } \
+				} \
+				else { \
+					for (int r = 0; r < blockRows; r++) { a->floats[r] = a->floats[r] op b->floats[r]; } \
+				} \
+			} break;
+
+#define BNC_BATCH_LITERAL_INST(name, op) \
+			case BNS_GLUE_TOKS(BNS_GLUE_TOKS(BNCBI_, name), IntLit): { \
+				i++; \
+				int lit = code[i]; \
+				int* a = stack[stackTop - 1].ints; \
+				for (int r = 0; r < blockRows; r++) { a[r] = BNS_GLUE_TOKS(BNCInt_, name)(a[r], lit); } \
+			} break; \
+			case BNS_GLUE_TOKS(BNS_GLUE_TOKS(BNCBI_, name), FloatLit): { \
+				i++; \
+				float lit = *(float*)&code[i]; \
+				float* a = stack[stackTop - 1].floats; \
+				for (int r = 0; r < blockRows; r++) { a[r] = a[r] op lit; } \
+			} break;
+
+			BNC_BATCH_BINARY_INST(Add, +)
+			BNC_BATCH_BINARY_INST(Sub, -)
+			BNC_BATCH_BINARY_INST(Mul, *)
+			BNC_BATCH_BINARY_INST(Div, /)
+			BNC_BATCH_LITERAL_INST(Add, +)
+			BNC_BATCH_LITERAL_INST(Sub, -)
+			BNC_BATCH_LITERAL_INST(Mul, *)
+			BNC_BATCH_LITERAL_INST(Div, /)
+#undef BNC_BATCH_BINARY_INST
+#undef BNC_BATCH_LITERAL_INST
+			}
+		}
+
+		ASSERT(stackTop == 1);
+		MemCpy((char*)outColumn + rowStart * sizeof(int), stack[0].ints, blockRows * sizeof(int));
+	}
+}
+
+static bool IsBinaryInstruction(int inst) {
+	return inst == BNCBI_Add || inst == BNCBI_Sub || inst == BNCBI_Mul || inst == BNCBI_Div;
+}
+
+static bool IsLiteralInstruction(int inst) {
+	return inst == BNCBI_IntLit || inst == BNCBI_FloatLit;
+}
+
+static BNCCompactValue LiteralToCompact(int inst, int operand) {
+	if (inst == BNCBI_IntLit) {
+		return CompactInt(operand);
+	}
+	else {
+		return CompactFloat(*(float*)&operand);
+	}
+}
+
+static int CompactToLiteralOperand(BNCCompactValue val) {
+	return (int)GetCompactPayload(val);
+}
+
+static int GetFusedLiteralInstruction(int op, int literalInst) {
+	bool isInt = (literalInst == BNCBI_IntLit);
+	switch (op) {
+	case BNCBI_Add: { return isInt ? BNCBI_AddIntLit : BNCBI_AddFloatLit; } break;
+	case BNCBI_Sub: { return isInt ? BNCBI_SubIntLit : BNCBI_SubFloatLit; } break;
+	case BNCBI_Mul: { return isInt ? BNCBI_MulIntLit : BNCBI_MulFloatLit; } break;
+	case BNCBI_Div: { return isInt ? BNCBI_DivIntLit : BNCBI_DivFloatLit; } break;
+	default: { ASSERT(false); return op; } break;
+	}
+}
+
+static BNCCompactValue FoldBinaryInstruction(int op, BNCCompactValue a, BNCCompactValue b) {
+	switch (op) {
+	case BNCBI_Add: { return BNCValue_Add(a, b); } break;
+	case BNCBI_Sub: { return BNCValue_Sub(a, b); } break;
+	case BNCBI_Mul: { return BNCValue_Mul(a, b); } break;
+	case BNCBI_Div: { return BNCValue_Div(a, b); } break;
+	default: { ASSERT(false); return a; } break;
+	}
+}
+
+void OptimizeBytecode(Vector<int>* code) {
+	Vector<int> out;
+
+	// Offsets into out where each emitted instruction starts, so the pass can look back
+	// at the instructions that produced the operands of the current one
+	Vector<int> instStarts;
+
+	for (int i = 0; i < code->count; i += GetBytecodeInstructionLength(code->data[i])) {
+		int inst = code->data[i];
+
+		if (IsBinaryInstruction(inst) && instStarts.count > 0) {
+			int rhsStart = instStarts.Back();
+			int rhsInst = out.data[rhsStart];
+
+			if (IsLiteralInstruction(rhsInst)) {
+				int rhsOperand = out.data[rhsStart + 1];
+
+				if (instStarts.count > 1) {
+					int lhsStart = instStarts.data[instStarts.count - 2];
+					int lhsInst = out.data[lhsStart];
+					int lhsOperand = out.data[lhsStart + 1];
+
+					// Integer division that would trap in C is left unfolded, so CompileFormula can
+					// still see a constant zero divisor
+					bool isTrappingDiv = (lhsInst == BNCBI_IntLit && inst == BNCBI_Div)
+									  && (rhsOperand == 0 || (rhsOperand == -1 && lhsOperand == (int)0x80000000));
+
+					if (lhsInst == rhsInst && !isTrappingDiv) {
+						BNCCompactValue folded = FoldBinaryInstruction(inst, LiteralToCompact(lhsInst, lhsOperand), LiteralToCompact(rhsInst, rhsOperand));
+						out.data[lhsStart + 1] = CompactToLiteralOperand(folded);
+						out.PopBack();
+						out.PopBack();
+						instStarts.PopBack();
+						continue;
+					}
+				}
+
+				// The literal is the right operand, so it can ride along with the op
+				out.data[rhsStart] = GetFusedLiteralInstruction(inst, rhsInst);
+				continue;
+			}
+		}
+
+		instStarts.PushBack(out.count);
+		int instLength = GetBytecodeInstructionLength(inst);
+		for (int j = 0; j < instLength && i + j < code->count; j++) {
+			out.PushBack(code->data[i + j]);
+		}
+	}
+
+	code->Clear();
+	for (int i = 0; i < out.count; i++) {
+		code->PushBack(out.data[i]);
+	}
+}
+
+long long GetProfilerTimestampNanoseconds() {
+	return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PrintBytecodeProfile(const BNCBytecodeProfile* profile, FILE* fileHandle) {
+	fprintf(fileHandle, "Bytecode profile:\n");
+
+	long long totalInstructions = 0;
+	for (int i = 0; i < BNCBI_Count; i++) {
+		totalInstructions += profile->opcodeCounts[i];
+	}
+
+	fprintf(fileHandle, "  Opcode counts (%lld total):\n", totalInstructions);
+	for (int i = 0; i < BNCBI_Count; i++) {
+		if (profile->opcodeCounts[i] > 0) {
+			fprintf(fileHandle, "    %-12s %lld\n", bytecodeInstructionNames[i], profile->opcodeCounts[i]);
+		}
+	}
+
+	// Repeatedly pick the most frequent remaining pair, the table is small enough
+	const int maxPairsToShow = 10;
+	bool pairShown[BNCBI_Count][BNCBI_Count];
+	MemSet(pairShown, 0, sizeof(pairShown));
+
+	fprintf(fileHandle, "  Most frequent opcode pairs:\n");
+	for (int shown = 0; shown < maxPairsToShow; shown++) {
+		int bestFirst = -1, bestSecond = -1;
+		long long bestCount = 0;
+		for (int i = 0; i < BNCBI_Count; i++) {
+			for (int j = 0; j < BNCBI_Count; j++) {
+				if (!pairShown[i][j] && profile->opcodePairCounts[i][j] > bestCount) {
+					bestFirst = i;
+					bestSecond = j;
+					bestCount = profile->opcodePairCounts[i][j];
+				}
+			}
+		}
+
+		if (bestFirst < 0) {
+			break;
+		}
+
+		pairShown[bestFirst][bestSecond] = true;
+		fprintf(fileHandle, "    %-12s -> %-12s %lld\n", bytecodeInstructionNames[bestFirst], bytecodeInstructionNames[bestSecond], bestCount);
+	}
+
+	long long totalNanoseconds = 0;
+	BNS_VEC_FOREACH(profile->expressions) {
+		totalNanoseconds += ptr->nanoseconds;
+	}
+
+	fprintf(fileHandle, "  Evaluated %d expressions in %lld ns\n", profile->expressions.count, totalNanoseconds);
+
+	const int maxExpressionsToShow = 10;
+	Vector<bool> expressionShown;
+	for (int i = 0; i < profile->expressions.count; i++) {
+		expressionShown.PushBack(false);
+	}
+
+	for (int shown = 0; shown < maxExpressionsToShow && shown < profile->expressions.count; shown++) {
+		int slowest = -1;
+		for (int i = 0; i < profile->expressions.count; i++) {
+			if (!expressionShown.data[i] && (slowest < 0 || profile->expressions.data[i].nanoseconds > profile->expressions.data[slowest].nanoseconds)) {
+				slowest = i;
+			}
+		}
+
+		expressionShown.data[slowest] = true;
+		const BNCExpressionProfile& expr = profile->expressions.data[slowest];
+		fprintf(fileHandle, "    node %5d: %4d ints of bytecode, %lld ns\n", expr.nodeIndex, expr.codeLength, expr.nanoseconds);
+	}
+}
@@ -39,23 +39,87 @@ struct BNCByteCodeFloat {
 
 DEFINE_DISCRIMINATED_UNION(BNCBytecodeValue, BNC_VAL)
 
-#define BNC_MATH_OP(op, name)                                                                                      \
-BNCBytecodeValue BNS_GLUE_TOKS(BNCValue_, name) (BNCBytecodeValue a, BNCBytecodeValue b) {                         \
-	if (a.type == BNCBytecodeValue::UE_BNCByteCodeInt && b.type == BNCBytecodeValue::UE_BNCByteCodeInt) {          \
-		BNCBytecodeValue val;                                                                                      \
-		val = BNCByteCodeInt(a.AsBNCByteCodeInt() op b.AsBNCByteCodeInt());                                        \
-		return val;                                                                                                \
-	}                                                                                                              \
-	else if (a.type == BNCBytecodeValue::UE_BNCByteCodeFloat && b.type == BNCBytecodeValue::UE_BNCByteCodeFloat) { \
-		BNCBytecodeValue val;                                                                                      \
-		val = BNCByteCodeFloat(a.AsBNCByteCodeFloat() op b.AsBNCByteCodeFloat());                                  \
-		return val;                                                                                                \
-	}                                                                                                              \
-	else {                                                                                                         \
-		ASSERT(false);                                                                                             \
-		BNCBytecodeValue val;                                                                                      \
-		return val;                                                                                                \
-	}                                                                                                              \
+// Compact 8-byte value used on the VM stack, so pushes and pops never copy a String.
+// The tag lives in the high 32 bits and the payload in the low 32 bits: ints directly,
+// floats by their bit pattern, and strings as handles into the VM's BNCStringTable.
+enum BNCCompactValueTag {
+	BNCCVT_Void,
+	BNCCVT_Int,
+	BNCCVT_Float,
+	BNCCVT_String
+};
+
+struct BNCCompactValue {
+	unsigned long long bits;
+};
+
+static_assert(sizeof(BNCCompactValue) == 8, "BNCCompactValue should fit in a register");
+
+inline BNCCompactValue MakeCompactValue(BNCCompactValueTag tag, unsigned int payload) {
+	BNCCompactValue val;
+	val.bits = (((unsigned long long)tag) << 32) | payload;
+	return val;
+}
+
+inline BNCCompactValueTag GetCompactTag(BNCCompactValue val) {
+	return (BNCCompactValueTag)(val.bits >> 32);
+}
+
+inline unsigned int GetCompactPayload(BNCCompactValue val) {
+	return (unsigned int)(val.bits & 0xFFFFFFFF);
+}
+
+inline BNCCompactValue CompactInt(int x) {
+	return MakeCompactValue(BNCCVT_Int, (unsigned int)x);
+}
+
+inline BNCCompactValue CompactFloat(float x) {
+	unsigned int payload = *(unsigned int*)&x;
+	return MakeCompactValue(BNCCVT_Float, payload);
+}
+
+inline int CompactAsInt(BNCCompactValue val) {
+	ASSERT(GetCompactTag(val) == BNCCVT_Int);
+	return (int)GetCompactPayload(val);
+}
+
+inline float CompactAsFloat(BNCCompactValue val) {
+	ASSERT(GetCompactTag(val) == BNCCVT_Float);
+	unsigned int payload = GetCompactPayload(val);
+	return *(float*)&payload;
+}
+
+// Int arithmetic wraps, and division never traps: dividing by zero gives 0, and INT_MIN / -1
+// gives INT_MIN. Every executor goes through these, so a host evaluating formulas over its
+// own data can't be brought down by a row
+inline int BNCInt_Add(int a, int b) { return (int)((unsigned int)a + (unsigned int)b); }
+inline int BNCInt_Sub(int a, int b) { return (int)((unsigned int)a - (unsigned int)b); }
+inline int BNCInt_Mul(int a, int b) { return (int)((unsigned int)a * (unsigned int)b); }
+
+inline int BNCInt_Div(int a, int b) {
+	if (b == 0) {
+		return 0;
+	}
+	else if (b == -1) {
+		return BNCInt_Sub(0, a);
+	}
+	else {
+		return a / b;
+	}
+}
+
+#define BNC_MATH_OP(op, name)                                                                           \
+inline BNCCompactValue BNS_GLUE_TOKS(BNCValue_, name) (BNCCompactValue a, BNCCompactValue b) {          \
+	if (GetCompactTag(a) == BNCCVT_Int && GetCompactTag(b) == BNCCVT_Int) {                             \
+		return CompactInt(BNS_GLUE_TOKS(BNCInt_, name)(CompactAsInt(a), CompactAsInt(b)));              \
+	}                                                                                                   \
+	else if (GetCompactTag(a) == BNCCVT_Float && GetCompactTag(b) == BNCCVT_Float) {                    \
+		return CompactFloat(CompactAsFloat(a) op CompactAsFloat(b));                                    \
+	}                                                                                                   \
+	else {                                                                                              \
+		ASSERT(false);                                                                                  \
+		return MakeCompactValue(BNCCVT_Void, 0);                                                        \
+	}                                                                                                   \
 }
 
 BNC_MATH_OP(+, Add)
@@ -65,30 +129,189 @@ BNC_MATH_OP(/ , Div)
 
 #undef BNC_MATH_OP
 
+// Interned strings referenced by BNCCVT_String values, identical strings share a handle
+struct BNCStringTable {
+	Vector<String> strings;
+
+	int Intern(const String& str);
+
+	const String& Get(int handle) const {
+		ASSERT(handle >= 0 && handle < strings.count);
+		return strings.data[handle];
+	}
+};
+
+struct BNCBytecodeProfile;
+
 struct BNCBytecodeVMState {
-	Vector<BNCBytecodeValue> stack;
+	Vector<BNCCompactValue> stack;
+	BNCStringTable stringTable;
+
+	// Set to collect opcode statistics in ExecuteBytecode
+	BNCBytecodeProfile* profile;
 
-	void Push(BNCBytecodeValue val) {
+	// Values read by BNCBI_LoadInput, owned by the caller
+	const BNCCompactValue* inputs;
+	int inputCount;
+
+	BNCBytecodeVMState() {
+		profile = nullptr;
+		inputs = nullptr;
+		inputCount = 0;
+	}
+
+	void Push(BNCCompactValue val) {
 		stack.PushBack(val);
 	}
 
-	BNCBytecodeValue Pop() {
+	BNCCompactValue Pop() {
 		ASSERT(stack.count > 0);
-		BNCBytecodeValue top = stack.Back();
+		BNCCompactValue top = stack.Back();
 		stack.PopBack();
 		return top;
 	}
 };
 
+// Buffers for one evaluation, reset rather than reallocated between uses
+struct BNCBytecodeVMContext {
+	Vector<int> code;
+	BNCBytecodeVMState state;
+
+	void Reset() {
+		code.Clear();
+		state.stack.Clear();
+		state.profile = nullptr;
+	}
+};
+
+// Evaluations can nest (e.g. size_of a struct whose layout needs an array length),
+// so contexts are handed out LIFO and live at stable addresses
+struct BNCBytecodeVMPool {
+	Vector<BNCBytecodeVMContext*> contexts;
+	int inUseCount;
+
+	BNCBytecodeVMPool() {
+		inUseCount = 0;
+	}
+
+	// The pool owns its contexts, and callers hold pointers to them
+	BNCBytecodeVMPool(const BNCBytecodeVMPool&) = delete;
+	BNCBytecodeVMPool& operator=(const BNCBytecodeVMPool&) = delete;
+
+	~BNCBytecodeVMPool();
+
+	BNCBytecodeVMContext* Acquire();
+	void Release(BNCBytecodeVMContext* context);
+};
+
+BNCCompactValue ValueToCompact(const BNCBytecodeValue& val, BNCStringTable* stringTable);
+
+BNCBytecodeValue CompactToValue(BNCCompactValue val, const BNCStringTable* stringTable);
+
 enum BNCBytecodeInstruction {
 	BNCBI_Add,
 	BNCBI_Mul,
 	BNCBI_Sub,
 	BNCBI_Div,
 	BNCBI_FloatLit,
-	BNCBI_IntLit
+	BNCBI_IntLit,
+
+	// Superinstructions produced by OptimizeBytecode, these apply the op to the
+	// top of the stack and the literal operand that follows the instruction
+	BNCBI_AddIntLit,
+	BNCBI_MulIntLit,
+	BNCBI_SubIntLit,
+	BNCBI_DivIntLit,
+	BNCBI_AddFloatLit,
+	BNCBI_MulFloatLit,
+	BNCBI_SubFloatLit,
+	BNCBI_DivFloatLit,
+
+	// Pushes the host-supplied input whose index follows the instruction
+	BNCBI_LoadInput,
+
+	BNCBI_Count
 };
 
+extern const char* const bytecodeInstructionNames[BNCBI_Count];
+
+struct BNCExpressionProfile {
+	// Index of the expression's root in its AST's node list
+	int nodeIndex;
+	int codeLength;
+	long long nanoseconds;
+};
+
+// Optional statistics gathered by ExecuteBytecode, the pair counts show which
+// instruction sequences would benefit most from a superinstruction
+struct BNCBytecodeProfile {
+	long long opcodeCounts[BNCBI_Count];
+	long long opcodePairCounts[BNCBI_Count][BNCBI_Count];
+	Vector<BNCExpressionProfile> expressions;
+
+	BNCBytecodeProfile() {
+		MemSet(opcodeCounts, 0, sizeof(opcodeCounts));
+		MemSet(opcodePairCounts, 0, sizeof(opcodePairCounts));
+	}
+
+	// Profiled streams haven't been verified, and opcodes the interpreter skips over aren't counted
+	void RecordInstruction(int prevInst, int inst) {
+		if (inst < 0 || inst >= BNCBI_Count) {
+			return;
+		}
+
+		opcodeCounts[inst]++;
+		if (prevInst >= 0 && prevInst < BNCBI_Count) {
+			opcodePairCounts[prevInst][inst]++;
+		}
+	}
+};
+
+long long GetProfilerTimestampNanoseconds();
+
+void PrintBytecodeProfile(const BNCBytecodeProfile* profile, FILE* fileHandle);
+
+// Number of ints an instruction takes up in the stream, including its operand
+int GetBytecodeInstructionLength(int inst);
+
 BNCBytecodeValue ExecuteBytecode(int* code, int codeLen, BNCBytecodeVMState* state);
 
+struct BNCBytecodeVerifyResult {
+	bool isValid;
+	int maxStackDepth;
+
+	// Type left on the stack by the stream, BNCCVT_Void if it leaves nothing
+	BNCCompactValueTag resultType;
+
+	// Why the stream was rejected, nullptr if it wasn't
+	const char* error;
+
+	BNCBytecodeVerifyResult() {
+		isValid = false;
+		maxStackDepth = 0;
+		resultType = BNCCVT_Void;
+		error = nullptr;
+	}
+};
+
+// Checks operands, type consistency and stack balance once, so the stream can be run unchecked.
+// inputTypes gives the type of each value BNCBI_LoadInput can read
+bool VerifyBytecode(int* code, int codeLen, BNCBytecodeVerifyResult* outResult, const BNCCompactValueTag* inputTypes = nullptr, int inputCount = 0);
+
+// Fast path for streams that passed VerifyBytecode: the stack is preallocated to
+// maxStackDepth and no per-instruction bounds or type checks are done
+BNCBytecodeValue ExecuteVerifiedBytecode(int* code, int codeLen, const BNCBytecodeVerifyResult& verifyResult, BNCBytecodeVMState* state);
+
+// Rows are processed in blocks of this size, each instruction running over a whole block at once
+#define BNC_BATCH_BLOCK_SIZE 256
+
+// Runs a verified stream once per row, column-at-a-time. inputColumns[i] points to rowCount
+// ints or floats according to inputTypes[i], outColumn receives rowCount values of verifyResult.resultType.
+// Like the scalar VM, integer division by zero is not checked.
+void ExecuteBytecodeBatch(int* code, int codeLen, const BNCBytecodeVerifyResult& verifyResult,
+						  const BNCCompactValueTag* inputTypes, const void* const* inputColumns, int rowCount, void* outColumn);
+
+// Peephole pass: folds operations on literals, and fuses ops whose right operand is a literal
+void OptimizeBytecode(Vector<int>* code);
+
 #endif
@@ -0,0 +1,98 @@
+#include "formula.h"
+
+#include "AST.h"
+#include "semantics.h"
+#include "backend.h"
+
+bool CompileFormula(const char* source, const char** inputNames, const BNCCompactValueTag* inputTypes, int inputCount, BNCFormula* outFormula,
+					FILE* diagnosticsFile /*= stdout*/) {
+	outFormula->code.Clear();
+	outFormula->inputTypes.Clear();
+
+	for (int i = 0; i < inputCount; i++) {
+		if (inputTypes[i] != BNCCVT_Int && inputTypes[i] != BNCCVT_Float) {
+			fprintf(diagnosticsFile, "Error: formula input '%s' must be an int or a float.\n", inputNames[i]);
+			return false;
+		}
+
+		outFormula->inputTypes.PushBack(inputTypes[i]);
+	}
+
+	// The formula is parsed as a program holding a single expression statement
+	Vector<char> program;
+	for (const char* c = source; *c != '\0'; c++) {
+		program.PushBack(*c);
+	}
+	program.PushBack(';');
+	program.PushBack('\0');
+
+	String programStr = program.data;
+
+	AST ast;
+	ast.ConstructFromString(programStr);
+	if (ast.nodes.count == 0 || ast.nodes.Back().type != ANT_Root) {
+		fprintf(diagnosticsFile, "Error: could not parse formula '%s'.\n", source);
+		return false;
+	}
+
+	ASTNode* root = &ast.nodes.Back();
+	if (root->Root_value.topLevelStatements.count != 1) {
+		fprintf(diagnosticsFile, "Error: formula '%s' must be a single expression.\n", source);
+		return false;
+	}
+
+	FixUpOperators(root);
+
+	ASTNode* stmt = &ast.nodes.data[root->Root_value.topLevelStatements.data[0]];
+	if (stmt->type != ANT_Statement) {
+		fprintf(diagnosticsFile, "Error: formula '%s' must be a single expression.\n", source);
+		return false;
+	}
+
+	SemanticContext sc;
+	sc.ast = &ast;
+	sc.diagnosticsFile = diagnosticsFile;
+	for (int i = 0; i < inputCount; i++) {
+		sc.bytecodeInputNames.PushBack(inputNames[i]);
+	}
+
+	ASTNode* expr = &ast.nodes.data[stmt->Statement_value.root];
+	if (!CompileASTExpressionToByteCode(expr, &sc, &outFormula->code)) {
+		return false;
+	}
+
+	OptimizeBytecode(&outFormula->code);
+
+	// Constant divisors have been fused into the division by now. Dividing by a zero one
+	// is well-defined at runtime, but can only be a mistake
+	for (int i = 0; i < outFormula->code.count; i += GetBytecodeInstructionLength(outFormula->code.data[i])) {
+		if (outFormula->code.data[i] == BNCBI_DivIntLit && outFormula->code.data[i + 1] == 0) {
+			fprintf(diagnosticsFile, "Error: formula '%s' divides by zero.\n", source);
+			return false;
+		}
+	}
+
+	if (!VerifyBytecode(outFormula->code.data, outFormula->code.count, &outFormula->verifyResult, outFormula->inputTypes.data, outFormula->inputTypes.count)) {
+		fprintf(diagnosticsFile, "Error: formula '%s' is invalid: %s.\n", source, outFormula->verifyResult.error);
+		return false;
+	}
+	else if (outFormula->verifyResult.resultType == BNCCVT_Void) {
+		fprintf(diagnosticsFile, "Error: formula '%s' produces no value.\n", source);
+		return false;
+	}
+
+	return true;
+}
+
+BNCBytecodeValue EvaluateFormulaRow(const BNCFormula* formula, const BNCCompactValue* inputs, BNCBytecodeVMState* state) {
+	state->inputs = inputs;
+	state->inputCount = formula->inputTypes.count;
+	state->stack.Clear();
+
+	return ExecuteVerifiedBytecode(formula->code.data, formula->code.count, formula->verifyResult, state);
+}
+
+void EvaluateFormulaBatch(const BNCFormula* formula, const void* const* inputColumns, int rowCount, void* outColumn) {
+	ExecuteBytecodeBatch(formula->code.data, formula->code.count, formula->verifyResult,
+						 formula->inputTypes.data, inputColumns, rowCount, outColumn);
+}
@@ -0,0 +1,31 @@
+#ifndef FORMULA_H
+#define FORMULA_H
+
+#pragma once
+
+#include "bytecode.h"
+
+// Embedding API for hosts that evaluate a BNC expression over many rows of data,
+// e.g. "price * quantity - 1.5" over columns named price and quantity.
+// The expression is parsed and compiled to bytecode once, then run either per row
+// or column-at-a-time with EvaluateFormulaBatch.
+
+struct BNCFormula {
+	Vector<int> code;
+	BNCBytecodeVerifyResult verifyResult;
+	Vector<BNCCompactValueTag> inputTypes;
+};
+
+// Inputs may only be BNCCVT_Int or BNCCVT_Float, and the expression must not mix the two.
+// Compilation errors are written to diagnosticsFile. Int arithmetic wraps, and an int division
+// by zero evaluates to 0 (INT_MIN / -1 to INT_MIN) instead of trapping, see BNCInt_Div
+bool CompileFormula(const char* source, const char** inputNames, const BNCCompactValueTag* inputTypes, int inputCount, BNCFormula* outFormula,
+					FILE* diagnosticsFile = stdout);
+
+BNCBytecodeValue EvaluateFormulaRow(const BNCFormula* formula, const BNCCompactValue* inputs, BNCBytecodeVMState* state);
+
+// inputColumns[i] points to rowCount ints or floats, matching the formula's inputTypes[i].
+// outColumn receives rowCount ints or floats, matching formula->verifyResult.resultType
+void EvaluateFormulaBatch(const BNCFormula* formula, const void* const* inputColumns, int rowCount, void* outColumn);
+
+#endif
@@ -0,0 +1,671 @@
+#include "ir.h"
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+struct IRBuildContext {
+	BNCIRFunction* func;
+	SemanticContext* sc;
+
+	TypeIndex intType;
+	TypeIndex floatType;
+	TypeIndex boolType;
+
+	// The variables in scope, by declaration, along with the value each one holds (-1 until assigned)
+	Vector<ASTIndex> varDecls;
+	Vector<int> varValues;
+	Vector<TypeIndex> varTypes;
+
+	// Open-addressed index into varDecls, sized up front for every parameter and statement
+	Vector<int> varTable;
+};
+
+struct IRBuildWorkItem {
+	ASTIndex node;
+	bool emitOp;
+};
+
+static void InitIRBuildContext(IRBuildContext* ctx, BNCIRFunction* func, SemanticContext* sc) {
+	ctx->func = func;
+	ctx->sc = sc;
+	ctx->intType   = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("int"), sc);
+	ctx->floatType = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("float"), sc);
+	ctx->boolType  = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("bool"), sc);
+}
+
+static bool IsScalarIRType(TypeIndex typeIdx, IRBuildContext* ctx) {
+	return typeIdx >= 0 && (typeIdx == ctx->intType || typeIdx == ctx->floatType || typeIdx == ctx->boolType);
+}
+
+static int AddIRInst(IRBuildContext* ctx, BNCIROp op, TypeIndex type, int arg0 = -1, int arg1 = -1) {
+	BNCIRInst& inst = ctx->func->insts.EmplaceBack();
+	inst.op = op;
+	inst.type = type;
+	inst.args[0] = arg0;
+	inst.args[1] = arg1;
+	inst.intValue = 0;
+	inst.floatValue = 0.0f;
+	inst.isDead = false;
+
+	return ctx->func->insts.count - 1;
+}
+
+static void InitIRVariableTable(IRBuildContext* ctx, int maxVariables) {
+	int tableSize = 16;
+	while (tableSize < maxVariables * 2) {
+		tableSize *= 2;
+	}
+
+	for (int i = 0; i < tableSize; i++) {
+		ctx->varTable.PushBack(-1);
+	}
+}
+
+static int GetIRVariableSlot(ASTIndex declIdx, IRBuildContext* ctx) {
+	int mask = ctx->varTable.count - 1;
+	int slot = (int)(((unsigned)declIdx * 2654435761u) & mask);
+	while (ctx->varTable.data[slot] >= 0 && ctx->varDecls.data[ctx->varTable.data[slot]] != declIdx) {
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+static void AddIRVariable(ASTIndex declIdx, int value, TypeIndex type, IRBuildContext* ctx) {
+	ctx->varTable.data[GetIRVariableSlot(declIdx, ctx)] = ctx->varDecls.count;
+	ctx->varDecls.PushBack(declIdx);
+	ctx->varValues.PushBack(value);
+	ctx->varTypes.PushBack(type);
+}
+
+static int FindIRVariable(ASTIndex declIdx, IRBuildContext* ctx) {
+	if (declIdx < 0 || ctx->varTable.count == 0) {
+		return -1;
+	}
+
+	return ctx->varTable.data[GetIRVariableSlot(declIdx, ctx)];
+}
+
+// The variable declaration an identifier was resolved to by semantics, or -1
+static ASTIndex GetIdentifierDecl(ASTNode* node, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(node, sc);
+	if (info == nullptr || !(info->flags & NIF_HasSymbol) || info->symbolKind != NSK_Variable) {
+		return -1;
+	}
+
+	return info->symbolIndex;
+}
+
+static int GetIRBinaryOp(const char* op) {
+	if (StrEqual(op, "+"))  { return IROP_Add; }
+	if (StrEqual(op, "-"))  { return IROP_Sub; }
+	if (StrEqual(op, "*"))  { return IROP_Mul; }
+	if (StrEqual(op, "/"))  { return IROP_Div; }
+	if (StrEqual(op, "==")) { return IROP_Equal; }
+	if (StrEqual(op, "<"))  { return IROP_Less; }
+	if (StrEqual(op, "<=")) { return IROP_LessEqual; }
+	if (StrEqual(op, ">"))  { return IROP_Greater; }
+	if (StrEqual(op, ">=")) { return IROP_GreaterEqual; }
+
+	return -1;
+}
+
+static int BuildIRValue(ASTNode* node, IRBuildContext* ctx);
+
+static int BuildIRCall(ASTNode* node, IRBuildContext* ctx) {
+	SemanticContext* sc = ctx->sc;
+	if (IsLayoutIntrinsicCall(node)) {
+		int val = EvaluateLayoutIntrinsic(node, sc);
+		if (val < 0) {
+			return -1;
+		}
+
+		int inst = AddIRInst(ctx, IROP_IntConst, ctx->intType);
+		ctx->func->insts.data[inst].intValue = val;
+		return inst;
+	}
+
+	// Compile-time expressions can't call anything
+	if (ctx->func->def == nullptr || IsVectorConstructorCall(node, sc)) {
+		return -1;
+	}
+
+	FuncDef* callee = GetResolvedFuncDef(node, sc);
+	const Vector<ASTIndex>& args = node->FunctionCall_value.args;
+	if (callee == nullptr || callee->argTypes.count != args.count || !IsScalarIRType(callee->retType, ctx)) {
+		return -1;
+	}
+
+	Vector<int> argValues;
+	for (int i = 0; i < args.count; i++) {
+		int argValue = BuildIRValue(&node->ast->nodes.data[args.data[i]], ctx);
+		if (argValue < 0 || !IsScalarIRType(callee->argTypes.data[i], ctx)) {
+			return -1;
+		}
+
+		argValues.PushBack(argValue);
+	}
+
+	int inst = AddIRInst(ctx, IROP_Call, callee->retType);
+	ctx->func->insts.data[inst].intValue = callee - sc->definedFunctions.data;
+	StealVector(&ctx->func->insts.data[inst].callArgs, &argValues);
+	return inst;
+}
+
+// Returns the value node computes, or -1 if it's outside what the IR handles
+static int BuildIRValue(ASTNode* node, IRBuildContext* ctx) {
+	switch (node->type) {
+	case ANT_IntegerLiteral: {
+		int inst = AddIRInst(ctx, IROP_IntConst, ctx->intType);
+		ctx->func->insts.data[inst].intValue = node->IntegerLiteral_value.val;
+		return inst;
+	} break;
+
+	case ANT_FloatLiteral: {
+		int inst = AddIRInst(ctx, IROP_FloatConst, ctx->floatType);
+		ctx->func->insts.data[inst].floatValue = node->FloatLiteral_value.val;
+		return inst;
+	} break;
+
+	case ANT_BoolLiteral: {
+		// The bytecode VM has no bools
+		if (ctx->func->def == nullptr) {
+			return -1;
+		}
+
+		int inst = AddIRInst(ctx, IROP_IntConst, ctx->boolType);
+		ctx->func->insts.data[inst].intValue = node->BoolLiteral_value.val ? 1 : 0;
+		return inst;
+	} break;
+
+	case ANT_Parentheses: {
+		return BuildIRValue(&node->ast->nodes.data[node->Parentheses_value.val], ctx);
+	} break;
+
+	case ANT_Identifier: {
+		// Compile-time expressions have no variables
+		if (ctx->func->def == nullptr) {
+			return -1;
+		}
+
+		// Globals aren't tracked, since any call could change them
+		int var = FindIRVariable(GetIdentifierDecl(node, ctx->sc), ctx);
+		return (var >= 0) ? ctx->varValues.data[var] : -1;
+	} break;
+
+	case ANT_UnaryOp: {
+		// CompileASTExpressionToByteCode rejects unary ops, and -ssa shouldn't accept more than it does
+		if (!node->UnaryOp_value.isPre || ctx->func->def == nullptr) {
+			return -1;
+		}
+
+		BNCIROp op;
+		if (StrEqual(node->UnaryOp_value.op, "-")) {
+			op = IROP_Neg;
+		}
+		else if (StrEqual(node->UnaryOp_value.op, "!")) {
+			op = IROP_Not;
+		}
+		else {
+			return -1;
+		}
+
+		int val = BuildIRValue(&node->ast->nodes.data[node->UnaryOp_value.val], ctx);
+		if (val < 0) {
+			return -1;
+		}
+
+		TypeIndex type = ctx->func->insts.data[val].type;
+		if (op == IROP_Neg && type == ctx->boolType) {
+			type = ctx->intType;
+		}
+
+		return AddIRInst(ctx, op, type, val);
+	} break;
+
+	case ANT_FunctionCall: {
+		return BuildIRCall(node, ctx);
+	} break;
+
+	case ANT_BinaryOp: {
+		// Long operator chains are walked with an explicit stack, like in OutputASTToCCode
+		Vector<IRBuildWorkItem> stack;
+		Vector<int> values;
+		IRBuildWorkItem rootItem = { node->GetIndex(), false };
+		stack.PushBack(rootItem);
+		while (stack.count > 0) {
+			IRBuildWorkItem item = stack.Back();
+			stack.PopBack();
+
+			ASTNode* curr = &node->ast->nodes.data[item.node];
+			if (item.emitOp) {
+				int right = values.Back();
+				values.PopBack();
+				int left = values.Back();
+				values.PopBack();
+
+				int op = GetIRBinaryOp(curr->BinaryOp_value.op);
+				TypeIndex type = ctx->boolType;
+				if (op < IROP_Equal) {
+					// Arithmetic on comparisons works on them as ints, the way C promotes them
+					TypeIndex leftType = ctx->func->insts.data[left].type;
+					type = (leftType == ctx->boolType) ? ctx->func->insts.data[right].type : leftType;
+					if (type == ctx->boolType) {
+						type = ctx->intType;
+					}
+				}
+				values.PushBack(AddIRInst(ctx, (BNCIROp)op, type, left, right));
+			}
+			else if (curr->type == ANT_BinaryOp) {
+				// Field access stays with the AST backends
+				int op = GetIRBinaryOp(curr->BinaryOp_value.op);
+				if (op < 0) {
+					return -1;
+				}
+
+				// The bytecode VM has no bools to compare into
+				if (op >= IROP_Equal && ctx->func->def == nullptr) {
+					return -1;
+				}
+
+				IRBuildWorkItem opItem = { item.node, true };
+				IRBuildWorkItem rightItem = { curr->BinaryOp_value.right, false };
+				IRBuildWorkItem leftItem = { curr->BinaryOp_value.left, false };
+				stack.PushBack(opItem);
+				stack.PushBack(rightItem);
+				stack.PushBack(leftItem);
+			}
+			else {
+				int val = BuildIRValue(curr, ctx);
+				if (val < 0) {
+					return -1;
+				}
+
+				values.PushBack(val);
+			}
+		}
+
+		return values.Back();
+	} break;
+
+	default: {
+		return -1;
+	} break;
+	}
+}
+
+bool BuildIRForFunction(FuncDef* def, SemanticContext* sc, BNCIRFunction* outFunc) {
+	outFunc->def = def;
+
+	IRBuildContext ctx;
+	InitIRBuildContext(&ctx, outFunc, sc);
+	if (!IsScalarIRType(def->retType, &ctx)) {
+		return false;
+	}
+
+	ASTNode* funcNode = &sc->ast->nodes.data[def->idx];
+	const Vector<ASTIndex>& params = funcNode->FunctionDefinition_value.params;
+	if (params.count != def->argTypes.count) {
+		return false;
+	}
+
+	ASTNode* body = &sc->ast->nodes.data[funcNode->FunctionDefinition_value.bodyScope];
+	InitIRVariableTable(&ctx, params.count + body->Scope_value.statements.count);
+
+	for (int i = 0; i < params.count; i++) {
+		if (!IsScalarIRType(def->argTypes.data[i], &ctx)) {
+			return false;
+		}
+
+		int inst = AddIRInst(&ctx, IROP_Param, def->argTypes.data[i]);
+		outFunc->insts.data[inst].intValue = i;
+
+		AddIRVariable(params.data[i], inst, def->argTypes.data[i], &ctx);
+	}
+
+	BNS_VEC_FOREACH(body->Scope_value.statements) {
+		ASTNode* stmt = &sc->ast->nodes.data[*ptr];
+		if (stmt->type != ANT_Statement) {
+			return false;
+		}
+
+		ASTNode* root = &sc->ast->nodes.data[stmt->Statement_value.root];
+		if (root->type == ANT_VariableDecl) {
+			TypeIndex varType = GetTypeIndex(&sc->ast->nodes.data[root->VariableDecl_value.type], sc);
+			if (!IsScalarIRType(varType, &ctx)) {
+				return false;
+			}
+
+			int val = -1;
+			if (root->VariableDecl_value.initValue >= 0) {
+				val = BuildIRValue(&sc->ast->nodes.data[root->VariableDecl_value.initValue], &ctx);
+				if (val < 0) {
+					return false;
+				}
+			}
+
+			AddIRVariable(stmt->Statement_value.root, val, varType, &ctx);
+		}
+		else if (root->type == ANT_VariableAssign) {
+			ASTNode* varNode = &sc->ast->nodes.data[root->VariableAssign_value.var];
+			int var = (varNode->type == ANT_Identifier) ? FindIRVariable(GetIdentifierDecl(varNode, sc), &ctx) : -1;
+			if (var < 0) {
+				return false;
+			}
+
+			int val = BuildIRValue(&sc->ast->nodes.data[root->VariableAssign_value.val], &ctx);
+			if (val < 0) {
+				return false;
+			}
+
+			ctx.varValues.data[var] = AddIRInst(&ctx, IROP_Copy, ctx.varTypes.data[var], val);
+		}
+		else if (root->type == ANT_ReturnStatement) {
+			outFunc->result = BuildIRValue(&sc->ast->nodes.data[root->ReturnStatement_value.retVal], &ctx);
+			return outFunc->result >= 0;
+		}
+		else if (root->type == ANT_FunctionCall) {
+			if (BuildIRCall(root, &ctx) < 0) {
+				return false;
+			}
+		}
+		else {
+			return false;
+		}
+	}
+
+	// Falling off the end without returning is left to the C compiler to complain about
+	return false;
+}
+
+bool BuildIRForExpression(ASTNode* expr, SemanticContext* sc, BNCIRFunction* outFunc) {
+	outFunc->def = nullptr;
+
+	IRBuildContext ctx;
+	InitIRBuildContext(&ctx, outFunc, sc);
+
+	outFunc->result = BuildIRValue(expr, &ctx);
+	return outFunc->result >= 0;
+}
+
+static bool IsIRConstant(const BNCIRInst& inst) {
+	return inst.op == IROP_IntConst || inst.op == IROP_FloatConst;
+}
+
+static void SetIRIntConstant(BNCIRInst* inst, int val, TypeIndex boolType) {
+	inst->op = IROP_IntConst;
+	inst->intValue = (inst->type == boolType) ? (val != 0) : val;
+	inst->args[0] = -1;
+	inst->args[1] = -1;
+}
+
+static void SetIRFloatConstant(BNCIRInst* inst, float val) {
+	inst->op = IROP_FloatConst;
+	inst->floatValue = val;
+	inst->args[0] = -1;
+	inst->args[1] = -1;
+}
+
+// Rewrites inst into a constant if its operands are constants. Ints wrap, and anything that
+// would trap or isn't finite is left for runtime
+static void FoldIRInst(BNCIRInst* inst, const Vector<BNCIRInst>& insts, TypeIndex boolType) {
+	if (inst->op < IROP_Neg || inst->op > IROP_GreaterEqual) {
+		return;
+	}
+
+	const BNCIRInst& a = insts.data[inst->args[0]];
+	if (!IsIRConstant(a)) {
+		return;
+	}
+
+	if (inst->op == IROP_Neg || inst->op == IROP_Not) {
+		if (a.op == IROP_IntConst) {
+			SetIRIntConstant(inst, (inst->op == IROP_Neg) ? (int)(0u - (unsigned)a.intValue) : !a.intValue, boolType);
+		}
+		else if (inst->op == IROP_Neg) {
+			SetIRFloatConstant(inst, -a.floatValue);
+		}
+		else {
+			SetIRFloatConstant(inst, !a.floatValue ? 1.0f : 0.0f);
+		}
+		return;
+	}
+
+	const BNCIRInst& b = insts.data[inst->args[1]];
+	if (!IsIRConstant(b) || a.op != b.op) {
+		return;
+	}
+
+	if (a.op == IROP_IntConst) {
+		unsigned x = (unsigned)a.intValue, y = (unsigned)b.intValue;
+		int result;
+		switch (inst->op) {
+		case IROP_Add:          { result = (int)(x + y); } break;
+		case IROP_Sub:          { result = (int)(x - y); } break;
+		case IROP_Mul:          { result = (int)(x * y); } break;
+		case IROP_Div: {
+			if (b.intValue == 0 || (a.intValue == INT_MIN && b.intValue == -1)) {
+				return;
+			}
+			result = a.intValue / b.intValue;
+		} break;
+		case IROP_Equal:        { result = a.intValue == b.intValue; } break;
+		case IROP_Less:         { result = a.intValue <  b.intValue; } break;
+		case IROP_LessEqual:    { result = a.intValue <= b.intValue; } break;
+		case IROP_Greater:      { result = a.intValue >  b.intValue; } break;
+		case IROP_GreaterEqual: { result = a.intValue >= b.intValue; } break;
+		default: { ASSERT(false); return; }
+		}
+
+		SetIRIntConstant(inst, result, boolType);
+	}
+	else {
+		// Folded in single precision, the same as the bytecode VM would evaluate it
+		float x = a.floatValue, y = b.floatValue;
+		if (inst->op >= IROP_Equal) {
+			bool result;
+			switch (inst->op) {
+			case IROP_Equal:        { result = x == y; } break;
+			case IROP_Less:         { result = x <  y; } break;
+			case IROP_LessEqual:    { result = x <= y; } break;
+			case IROP_Greater:      { result = x >  y; } break;
+			case IROP_GreaterEqual: { result = x >= y; } break;
+			default: { ASSERT(false); return; }
+			}
+
+			SetIRIntConstant(inst, result, boolType);
+			return;
+		}
+
+		float result;
+		switch (inst->op) {
+		case IROP_Add:          { result = x + y; } break;
+		case IROP_Sub:          { result = x - y; } break;
+		case IROP_Mul:          { result = x * y; } break;
+		case IROP_Div:          { result = x / y; } break;
+		default: { ASSERT(false); return; }
+		}
+
+		if (!isfinite(result)) {
+			return;
+		}
+
+		SetIRFloatConstant(inst, result);
+	}
+}
+
+// The operand an integer add, subtract, multiply or divide passes through unchanged, or -1
+static int GetIRIdentityOperand(const BNCIRInst& inst, const Vector<BNCIRInst>& insts, TypeIndex intType) {
+	if (inst.type != intType || inst.op < IROP_Add || inst.op > IROP_Div) {
+		return -1;
+	}
+
+	const BNCIRInst& a = insts.data[inst.args[0]];
+	const BNCIRInst& b = insts.data[inst.args[1]];
+	bool aIsConst = (a.op == IROP_IntConst), bIsConst = (b.op == IROP_IntConst);
+	switch (inst.op) {
+	case IROP_Add: {
+		if (bIsConst && b.intValue == 0) { return inst.args[0]; }
+		if (aIsConst && a.intValue == 0) { return inst.args[1]; }
+	} break;
+
+	case IROP_Mul: {
+		if (bIsConst && b.intValue == 1) { return inst.args[0]; }
+		if (aIsConst && a.intValue == 1) { return inst.args[1]; }
+	} break;
+
+	case IROP_Sub: {
+		if (bIsConst && b.intValue == 0) { return inst.args[0]; }
+	} break;
+
+	case IROP_Div: {
+		if (bIsConst && b.intValue == 1) { return inst.args[0]; }
+	} break;
+
+	default: break;
+	}
+
+	return -1;
+}
+
+static unsigned long long HashIRInst(const BNCIRInst& inst, int memoryEpoch) {
+	// FNV-1a over the fields that make two instructions compute the same value
+	unsigned long long hash = 14695981039346656037ULL;
+	int floatBits;
+	memcpy(&floatBits, &inst.floatValue, sizeof(floatBits));
+
+	int fields[] = { (int)inst.op, inst.type, inst.args[0], inst.args[1], inst.intValue, floatBits, memoryEpoch };
+	for (int i = 0; i < BNS_ARRAY_COUNT(fields); i++) {
+		hash = (hash ^ (unsigned)fields[i]) * 1099511628211ULL;
+	}
+	BNS_VEC_FOREACH(inst.callArgs) {
+		hash = (hash ^ (unsigned)*ptr) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static bool AreIRInstsEqual(const BNCIRInst& a, const BNCIRInst& b) {
+	// Float constants are compared bitwise, so 0.0 and -0.0 stay apart
+	if (a.op != b.op || a.type != b.type || a.args[0] != b.args[0] || a.args[1] != b.args[1]
+	 || a.intValue != b.intValue || memcmp(&a.floatValue, &b.floatValue, sizeof(float)) != 0
+	 || a.callArgs.count != b.callArgs.count) {
+		return false;
+	}
+
+	for (int i = 0; i < a.callArgs.count; i++) {
+		if (a.callArgs.data[i] != b.callArgs.data[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void OptimizeIRFunction(BNCIRFunction* func, SemanticContext* sc) {
+	TypeIndex intType  = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("int"), sc);
+	TypeIndex boolType = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("bool"), sc);
+
+	Vector<BNCIRInst>& insts = func->insts;
+
+	// The value each instruction was found to be equal to, which is itself unless it's been replaced
+	Vector<int> replacements;
+
+	// Open-addressed table of instructions already seen, for common subexpression elimination.
+	// Pure calls also key on how many impure calls came before them, since those may change what they read
+	int tableSize = 16;
+	while (tableSize < insts.count * 2) {
+		tableSize *= 2;
+	}
+
+	Vector<int> table;
+	Vector<int> memoryEpochs;
+	for (int i = 0; i < tableSize; i++) {
+		table.PushBack(-1);
+	}
+
+	int memoryEpoch = 0;
+	for (int i = 0; i < insts.count; i++) {
+		replacements.PushBack(i);
+		memoryEpochs.PushBack(0);
+
+		// Operands come earlier, so they've already been replaced with whatever they equal
+		BNCIRInst* inst = &insts.data[i];
+		for (int j = 0; j < 2; j++) {
+			if (inst->args[j] >= 0) {
+				inst->args[j] = replacements.data[inst->args[j]];
+			}
+		}
+		BNS_VEC_FOREACH(inst->callArgs) {
+			*ptr = replacements.data[*ptr];
+		}
+
+		if (inst->op == IROP_Copy) {
+			replacements.data[i] = inst->args[0];
+			continue;
+		}
+
+		FoldIRInst(inst, insts, boolType);
+
+		int identityOperand = GetIRIdentityOperand(*inst, insts, intType);
+		if (identityOperand >= 0) {
+			replacements.data[i] = identityOperand;
+			continue;
+		}
+
+		if (inst->op == IROP_Call) {
+			FunctionPurity purity = sc->definedFunctions.data[inst->intValue].purity;
+			if (purity == FP_Impure) {
+				memoryEpoch++;
+				continue;
+			}
+			else if (purity == FP_Pure) {
+				memoryEpochs.data[i] = memoryEpoch;
+			}
+		}
+
+		int slot = (int)(HashIRInst(*inst, memoryEpochs.data[i]) & (tableSize - 1));
+		while (table.data[slot] >= 0) {
+			int other = table.data[slot];
+			if (memoryEpochs.data[other] == memoryEpochs.data[i] && AreIRInstsEqual(insts.data[other], *inst)) {
+				replacements.data[i] = other;
+				break;
+			}
+
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table.data[slot] < 0) {
+			table.data[slot] = i;
+		}
+	}
+
+	func->result = replacements.data[func->result];
+
+	// Walked backwards, everything using a value has been visited by the time the value is
+	BNS_VEC_FOREACH(insts) {
+		ptr->isDead = true;
+	}
+	insts.data[func->result].isDead = false;
+
+	for (int i = insts.count - 1; i >= 0; i--) {
+		BNCIRInst* inst = &insts.data[i];
+		if (inst->op == IROP_Call && sc->definedFunctions.data[inst->intValue].purity == FP_Impure) {
+			inst->isDead = false;
+		}
+
+		if (inst->isDead) {
+			continue;
+		}
+
+		for (int j = 0; j < 2; j++) {
+			if (inst->args[j] >= 0) {
+				insts.data[inst->args[j]].isDead = false;
+			}
+		}
+		BNS_VEC_FOREACH(inst->callArgs) {
+			insts.data[*ptr].isDead = false;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef IR_H
+#define IR_H
+
+#pragma once
+
+#include "../CppUtils/vector.h"
+
+#include "AST.h"
+#include "semantics.h"
+
+// A typed SSA form of scalar function bodies and compile-time expressions, built from the checked AST.
+// BNC has no branches, so a body is a single block and never needs phi nodes. Each value is
+// defined by exactly one instruction, and is referred to by that instruction's index.
+
+enum BNCIROp {
+	IROP_IntConst,
+	IROP_FloatConst,
+	// intValue is the index of the function parameter
+	IROP_Param,
+	IROP_Copy,
+	IROP_Neg,
+	IROP_Not,
+	IROP_Add,
+	IROP_Sub,
+	IROP_Mul,
+	IROP_Div,
+	IROP_Equal,
+	IROP_Less,
+	IROP_LessEqual,
+	IROP_Greater,
+	IROP_GreaterEqual,
+	// intValue is the index into SemanticContext::definedFunctions, the arguments are in callArgs
+	IROP_Call
+};
+
+struct BNCIRInst {
+	BNCIROp op;
+	// Comparisons are bool, whatever their operands are
+	TypeIndex type;
+	int args[2];
+	int intValue;
+	float floatValue;
+	Vector<int> callArgs;
+	// Set by OptimizeIRFunction for values nothing live depends on
+	bool isDead;
+};
+
+struct BNCIRFunction {
+	// In definition order, so every operand comes before the instruction using it
+	Vector<BNCIRInst> insts;
+	// The value returned by the function or expression
+	int result;
+	// nullptr when built from an expression
+	FuncDef* def;
+
+	BNCIRFunction() {
+		result = -1;
+		def = nullptr;
+	}
+};
+
+// Succeeds for functions whose parameters, locals and return value are all int, float or bool,
+// and whose bodies only assign, call and do arithmetic. Others are left to the AST backends
+bool BuildIRForFunction(FuncDef* def, SemanticContext* sc, BNCIRFunction* outFunc);
+
+// Succeeds for the same int and float arithmetic on literals and layout intrinsics as
+// CompileASTExpressionToByteCode handles. Host formulas are compiled by that directly
+bool BuildIRForExpression(ASTNode* expr, SemanticContext* sc, BNCIRFunction* outFunc);
+
+// Propagates copies and constants, folds arithmetic and merges common subexpressions in one
+// forward walk, then marks dead values walking back. Without control flow, neither needs iterating
+void OptimizeIRFunction(BNCIRFunction* func, SemanticContext* sc);
+
+#endif
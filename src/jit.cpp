@@ -0,0 +1,307 @@
+#include "jit.h"
+
+#include <string.h>
+
+#if BNC_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+// The generated code uses the native stack as the VM stack: every value occupies
+// one 8-byte slot, with ints and floats both kept in the low 32 bits.
+struct X64Emitter {
+	Vector<unsigned char> bytes;
+
+	void Emit(unsigned char byte) {
+		bytes.PushBack(byte);
+	}
+
+	void Emit(const unsigned char* seq, int len) {
+		for (int i = 0; i < len; i++) {
+			bytes.PushBack(seq[i]);
+		}
+	}
+
+	void Emit32(int val) {
+		for (int i = 0; i < 4; i++) {
+			bytes.PushBack((unsigned char)((val >> (i * 8)) & 0xFF));
+		}
+	}
+};
+
+#define EMIT_SEQ(emitter, ...) do { const unsigned char __seq[] = { __VA_ARGS__ }; (emitter).Emit(__seq, sizeof(__seq)); } while(0)
+
+// Pops the right operand into ecx and the left operand into eax
+static void EmitPopOperands(X64Emitter* emitter) {
+	EMIT_SEQ(*emitter, 0x59);         // pop rcx
+	EMIT_SEQ(*emitter, 0x58);         // pop rax
+}
+
+// Loads the literal right operand of a superinstruction into ecx and pops the left into eax
+static void EmitLiteralOperands(X64Emitter* emitter, int literal) {
+	EMIT_SEQ(*emitter, 0xB9);         // mov ecx, imm32
+	emitter->Emit32(literal);
+	EMIT_SEQ(*emitter, 0x58);         // pop rax
+}
+
+// Applies inst to eax and ecx, then pushes the result
+static void EmitIntOp(X64Emitter* emitter, int inst) {
+	switch (inst) {
+	case BNCBI_Add: { EMIT_SEQ(*emitter, 0x01, 0xC8); } break;       // add eax, ecx
+	case BNCBI_Sub: { EMIT_SEQ(*emitter, 0x29, 0xC8); } break;       // sub eax, ecx
+	case BNCBI_Mul: { EMIT_SEQ(*emitter, 0x0F, 0xAF, 0xC1); } break; // imul eax, ecx
+	case BNCBI_Div: {
+		// Matches BNCInt_Div, since idiv would trap on both special cases
+		EMIT_SEQ(*emitter, 0x85, 0xC9);       // test ecx, ecx
+		EMIT_SEQ(*emitter, 0x74, 0x0E);       // jz zero
+		EMIT_SEQ(*emitter, 0x83, 0xF9, 0xFF); // cmp ecx, -1
+		EMIT_SEQ(*emitter, 0x75, 0x04);       // jne divide
+		EMIT_SEQ(*emitter, 0xF7, 0xD8);       // neg eax
+		EMIT_SEQ(*emitter, 0xEB, 0x07);       // jmp done
+		EMIT_SEQ(*emitter, 0x99, 0xF7, 0xF9); // divide: cdq; idiv ecx
+		EMIT_SEQ(*emitter, 0xEB, 0x02);       // jmp done
+		EMIT_SEQ(*emitter, 0x31, 0xC0);       // zero: xor eax, eax
+	} break;                                  // done:
+	default: { ASSERT(false); } break;
+	}
+	EMIT_SEQ(*emitter, 0x50);         // push rax
+}
+
+static void EmitFloatOp(X64Emitter* emitter, int inst) {
+	EMIT_SEQ(*emitter, 0x66, 0x0F, 0x6E, 0xC0); // movd xmm0, eax
+	EMIT_SEQ(*emitter, 0x66, 0x0F, 0x6E, 0xC9); // movd xmm1, ecx
+	switch (inst) {
+	case BNCBI_Add: { EMIT_SEQ(*emitter, 0xF3, 0x0F, 0x58, 0xC1); } break; // addss xmm0, xmm1
+	case BNCBI_Sub: { EMIT_SEQ(*emitter, 0xF3, 0x0F, 0x5C, 0xC1); } break; // subss xmm0, xmm1
+	case BNCBI_Mul: { EMIT_SEQ(*emitter, 0xF3, 0x0F, 0x59, 0xC1); } break; // mulss xmm0, xmm1
+	case BNCBI_Div: { EMIT_SEQ(*emitter, 0xF3, 0x0F, 0x5E, 0xC1); } break; // divss xmm0, xmm1
+	default: { ASSERT(false); } break;
+	}
+	EMIT_SEQ(*emitter, 0x66, 0x0F, 0x7E, 0xC0); // movd eax, xmm0
+	EMIT_SEQ(*emitter, 0x50);                   // push rax
+}
+
+bool JitCompileBytecode(int* code, int codeLen, BNCJitFunction* outFunc) {
+#if BNC_JIT_SUPPORTED
+	X64Emitter emitter;
+
+	// Tracks the type of each stack slot, since the opcodes themselves are untyped
+	Vector<BNCJitValueType> typeStack;
+
+	for (int i = 0; i < codeLen; i++) {
+		int inst = code[i];
+		switch (inst) {
+		case BNCBI_IntLit:
+		case BNCBI_FloatLit: {
+			if (i + 1 >= codeLen) {
+				return false;
+			}
+
+			i++;
+			EMIT_SEQ(emitter, 0x68);    // push imm32
+			emitter.Emit32(code[i]);
+			typeStack.PushBack(inst == BNCBI_IntLit ? BJVT_Int : BJVT_Float);
+		} break;
+
+		case BNCBI_Add:
+		case BNCBI_Sub:
+		case BNCBI_Mul:
+		case BNCBI_Div: {
+			if (typeStack.count < 2) {
+				return false;
+			}
+
+			BNCJitValueType right = typeStack.Back();
+			typeStack.PopBack();
+			BNCJitValueType left = typeStack.Back();
+			if (left != right) {
+				return false;
+			}
+
+			EmitPopOperands(&emitter);
+			if (left == BJVT_Int) {
+				EmitIntOp(&emitter, inst);
+			}
+			else {
+				EmitFloatOp(&emitter, inst);
+			}
+		} break;
+
+		case BNCBI_AddIntLit:
+		case BNCBI_SubIntLit:
+		case BNCBI_MulIntLit:
+		case BNCBI_DivIntLit:
+		case BNCBI_AddFloatLit:
+		case BNCBI_SubFloatLit:
+		case BNCBI_MulFloatLit:
+		case BNCBI_DivFloatLit: {
+			if (typeStack.count < 1 || i + 1 >= codeLen) {
+				return false;
+			}
+
+			// The superinstructions are laid out in the same order as the plain ops
+			bool isInt = (inst <= BNCBI_DivIntLit);
+			int baseOp = BNCBI_Add + (inst - (isInt ? BNCBI_AddIntLit : BNCBI_AddFloatLit));
+			if (typeStack.Back() != (isInt ? BJVT_Int : BJVT_Float)) {
+				return false;
+			}
+
+			i++;
+			EmitLiteralOperands(&emitter, code[i]);
+			if (isInt) {
+				EmitIntOp(&emitter, baseOp);
+			}
+			else {
+				EmitFloatOp(&emitter, baseOp);
+			}
+		} break;
+
+		default: {
+			return false;
+		} break;
+		}
+	}
+
+	// A void result is trivial for the interpreter, so only single values are compiled
+	if (typeStack.count != 1) {
+		return false;
+	}
+
+	EMIT_SEQ(emitter, 0x58);            // pop rax
+	EMIT_SEQ(emitter, 0xC3);            // ret
+
+	void* buffer = mmap(nullptr, emitter.bytes.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED) {
+		return false;
+	}
+
+	memcpy(buffer, emitter.bytes.data, emitter.bytes.count);
+	if (mprotect(buffer, emitter.bytes.count, PROT_READ | PROT_EXEC) != 0) {
+		munmap(buffer, emitter.bytes.count);
+		return false;
+	}
+
+	outFunc->code = buffer;
+	outFunc->codeSize = emitter.bytes.count;
+	outFunc->resultType = typeStack.Back();
+	return true;
+#else
+	return false;
+#endif
+}
+
+#undef EMIT_SEQ
+
+BNCBytecodeValue ExecuteJitFunction(BNCJitFunction* func) {
+	ASSERT(func->code != nullptr);
+
+	typedef long long (*BNCJitEntryPoint)();
+	long long raw = ((BNCJitEntryPoint)func->code)();
+	int bits = (int)raw;
+
+	BNCBytecodeValue val;
+	if (func->resultType == BJVT_Int) {
+		val = BNCByteCodeInt(bits);
+	}
+	else {
+		val = BNCByteCodeFloat(*(float*)&bits);
+	}
+
+	return val;
+}
+
+void FreeJitFunction(BNCJitFunction* func) {
+#if BNC_JIT_SUPPORTED
+	if (func->code != nullptr) {
+		munmap(func->code, func->codeSize);
+	}
+#endif
+	func->code = nullptr;
+	func->codeSize = 0;
+}
+
+BNCJitCache::~BNCJitCache() {
+	BNS_VEC_FOREACH(entries) {
+		FreeJitFunction(&(*ptr)->func);
+		delete *ptr;
+	}
+}
+
+static unsigned int HashBytecode(int* code, int codeLen) {
+	// FNV-1a over the instruction words
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < codeLen; i++) {
+		hash = (hash ^ (unsigned int)code[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+void BNCJitCache::Rehash(int newSize) {
+	table.Clear();
+	for (int i = 0; i < newSize; i++) {
+		table.PushBack(-1);
+	}
+
+	for (int i = 0; i < entries.count; i++) {
+		int slot = (int)(entries.data[i]->hash & (newSize - 1));
+		while (table.data[slot] >= 0) {
+			slot = (slot + 1) & (newSize - 1);
+		}
+		table.data[slot] = i;
+	}
+}
+
+BNCJitFunction* BNCJitCache::FindOrCompile(int* code, int codeLen) {
+	if (table.count < 16 || entries.count * 2 >= table.count) {
+		Rehash(table.count < 16 ? 16 : table.count * 2);
+	}
+
+	unsigned int hash = HashBytecode(code, codeLen);
+	int slot = (int)(hash & (table.count - 1));
+	while (table.data[slot] >= 0) {
+		BNCJitCacheEntry* entry = entries.data[table.data[slot]];
+		if (entry->hash == hash && entry->code.count == codeLen
+			&& memcmp(entry->code.data, code, sizeof(int) * codeLen) == 0) {
+			return &entry->func;
+		}
+
+		slot = (slot + 1) & (table.count - 1);
+	}
+
+	BNCJitCacheEntry* entry = new BNCJitCacheEntry();
+	entry->hash = hash;
+	for (int i = 0; i < codeLen; i++) {
+		entry->code.PushBack(code[i]);
+	}
+	JitCompileBytecode(code, codeLen, &entry->func);
+
+	table.data[slot] = entries.count;
+	entries.PushBack(entry);
+
+	return &entry->func;
+}
+
+BNCBytecodeValue ExecuteBytecodeWithJit(int* code, int codeLen, BNCBytecodeVMState* state, BNCJitCache* cache) {
+	BNCJitFunction* func = cache->FindOrCompile(code, codeLen);
+	if (func->code == nullptr) {
+		return ExecuteBytecode(code, codeLen, state);
+	}
+
+	BNCBytecodeValue val = ExecuteJitFunction(func);
+
+#if defined(BNS_DEBUG)
+	// Debug builds check every native result against the interpreter
+	BNCBytecodeValue interpVal = ExecuteBytecode(code, codeLen, state);
+	ASSERT(interpVal.type == val.type);
+	if (val.type == BNCBytecodeValue::UE_BNCByteCodeInt) {
+		ASSERT(interpVal.AsBNCByteCodeInt() == val.AsBNCByteCodeInt());
+	}
+	else {
+		float jitFloat = val.AsBNCByteCodeFloat();
+		float interpFloat = interpVal.AsBNCByteCodeFloat();
+		ASSERT(*(int*)&jitFloat == *(int*)&interpFloat);
+	}
+#endif
+
+	return val;
+}
@@ -0,0 +1,72 @@
+#ifndef JIT_H
+#define JIT_H
+
+#pragma once
+
+#include "bytecode.h"
+
+// Native code generation for bytecode streams, currently only on x86-64 Linux.
+// Streams using opcodes or type combinations the JIT doesn't know about are
+// left to the interpreter.
+
+#if defined(__linux__) && defined(__x86_64__)
+#define BNC_JIT_SUPPORTED 1
+#else
+#define BNC_JIT_SUPPORTED 0
+#endif
+
+enum BNCJitValueType {
+	BJVT_Int,
+	BJVT_Float
+};
+
+struct BNCJitFunction {
+	// Executable buffer holding the compiled code, or nullptr if compilation failed
+	void* code;
+	int codeSize;
+	BNCJitValueType resultType;
+
+	BNCJitFunction() {
+		code = nullptr;
+		codeSize = 0;
+		resultType = BJVT_Int;
+	}
+};
+
+bool JitCompileBytecode(int* code, int codeLen, BNCJitFunction* outFunc);
+
+BNCBytecodeValue ExecuteJitFunction(BNCJitFunction* func);
+
+void FreeJitFunction(BNCJitFunction* func);
+
+struct BNCJitCacheEntry {
+	Vector<int> code;
+	unsigned int hash;
+	// Streams the JIT can't compile are cached too, with a null code pointer
+	BNCJitFunction func;
+};
+
+// Compiled code by bytecode stream, so that repeated compile-time expressions
+// (the same array length or constant in many places) are only mapped once
+struct BNCJitCache {
+	Vector<BNCJitCacheEntry*> entries;
+	// Open-addressed on the entries' hashes, holding indices into entries or -1.
+	// Kept at most half full, and its size is always a power of two
+	Vector<int> table;
+
+	BNCJitCache() { }
+
+	BNCJitCache(const BNCJitCache&) = delete;
+	BNCJitCache& operator=(const BNCJitCache&) = delete;
+
+	~BNCJitCache();
+
+	BNCJitFunction* FindOrCompile(int* code, int codeLen);
+
+	void Rehash(int newSize);
+};
+
+// Runs code natively if the JIT can compile it, otherwise runs it through ExecuteBytecode
+BNCBytecodeValue ExecuteBytecodeWithJit(int* code, int codeLen, BNCBytecodeVMState* state, BNCJitCache* cache);
+
+#endif
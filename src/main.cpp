@@ -2,15 +2,41 @@
 
 #include "AST.cpp"
 #include "semantics.cpp"
+#include "ir.cpp"
 #include "backend.cpp"
 #include "bytecode.cpp"
+#include "jit.cpp"
+#include "formula.cpp"
+#include "server.cpp"
 #include "../CppUtils/vector.cpp"
 #include "../CppUtils/assert.cpp"
 #include "../CppUtils/strings.cpp"
 #include "../CppUtils/lexer.cpp"
 
 int main(int argc, char** argv){
-	String code = ReadStringFromFile("test1.bnc");
+	const char* fileName = "test1.bnc";
+
+#if BNC_SERVER_SUPPORTED
+	if (argc >= 3 && StrEqual(argv[1], "-server")) {
+		return RunCompileServer(argv[2]);
+	}
+	else if (argc >= 3 && StrEqual(argv[1], "-client")) {
+		return RunCompileClient(argv[2], argc - 3, argv + 3);
+	}
+#endif
+
+	SemanticContext sc;
+	for (int i = 1; i < argc; i++) {
+		if (!ParseCompilerOption(argv, argc, &i, &sc.options)) {
+			fileName = argv[i];
+		}
+	}
+
+	if (sc.options.hasInvalidOperand) {
+		return 1;
+	}
+
+	String code = ReadStringFromFile(fileName);
 
 	AST ast;
 	ast.ConstructFromString(code);
@@ -18,12 +44,22 @@ int main(int argc, char** argv){
 	FixUpOperators(&ast.nodes.Back());
 	DisplayTree(&ast.nodes.Back());
 
-	SemanticContext sc;
 	DoSemantics(&ast, &sc);
 
-	printf("==============\n");
-	OutputASTToCCode(&ast.nodes.Back(), &sc, stdout);
-	printf("==============\n");
+	if (sc.options.outputShardCount > 0) {
+		if (!OutputShardedCCode(&ast.nodes.Back(), &sc, sc.options.outputPathPrefix, sc.options.outputShardCount)) {
+			return 1;
+		}
+	}
+	else {
+		printf("==============\n");
+		OutputASTToCCode(&ast.nodes.Back(), &sc, stdout);
+		printf("==============\n");
+	}
+
+	if (sc.options.profileBytecode) {
+		PrintBytecodeProfile(&sc.bytecodeProfile, stdout);
+	}
 	
 	return 0;
 }
@@ -2,10 +2,18 @@
 
 #include "backend.h"
 
+#include <limits.h>
+
 TypeCheckResult TypeCheckVarDecl(ASTNode* decl, SemanticContext* sc, int* outTypeIdx, bool addToScope = true);
 TypeCheckResult TypeCheckStructDef(StructDef* def, SemanticContext* sc, AST* ast);
 TypeCheckResult TypeCheckFunctionDef(FuncDef* def, SemanticContext* sc, AST* ast);
 TypeCheckResult DoTypeChecking(ASTNode* node, SemanticContext* sc, FuncDef* currFun = nullptr);
+TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeIdx);
+TypeIndex GetSimpleTypeIndex(const SubString& typeName, SemanticContext* sc);
+static TypeIndex InstantiateGenericStruct(int genericIndex, const Vector<TypeIndex>& args, SemanticContext* sc);
+static void CheckStructDefinition(StructDef* def, SemanticContext* sc);
+static bool IsTypeNode(ASTNode* node);
+static int GetGenericStructIndex(ASTNode* nameNode, SemanticContext* sc);
 
 FuncDef* GetFuncDefByName(const SubString& name, SemanticContext* sc) {
 	BNS_VEC_FOREACH(sc->definedFunctions) {
@@ -21,209 +29,1775 @@ void InitSemanticContextWithBuiltinTypes(SemanticContext* sc) {
 	TypeInfo info;
 	BuiltinTypeInfo simple;
 
-#define ADD_SIMPLE_TYPE(tn) simple.name = tn; info = simple; sc->knownTypes.PushBack(info)
-	ADD_SIMPLE_TYPE("int");
-	ADD_SIMPLE_TYPE("float");
-	ADD_SIMPLE_TYPE("bool");
-	ADD_SIMPLE_TYPE("string");
+#define ADD_SIMPLE_TYPE(tn, sz, al) simple.name = tn; simple.size = sz; simple.alignment = al; \
+	simple.laneCount = 0; simple.laneType = -1; info = simple; sc->knownTypes.PushBack(info)
+	ADD_SIMPLE_TYPE("int",    4, 4);
+	ADD_SIMPLE_TYPE("float",  4, 4);
+	ADD_SIMPLE_TYPE("bool",   1, 1);
+	ADD_SIMPLE_TYPE("string", 8, 8);
 #undef ADD_SIMPLE_TYPE
+
+	TypeIndex intType   = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("int"), sc);
+	TypeIndex floatType = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("float"), sc);
+
+#define ADD_VECTOR_TYPE(tn, lane, count) simple.name = tn; simple.size = 4 * count; simple.alignment = 4 * count; \
+	simple.laneCount = count; simple.laneType = lane; info = simple; sc->knownTypes.PushBack(info)
+	ADD_VECTOR_TYPE("float4", floatType, 4);
+	ADD_VECTOR_TYPE("int4",   intType,   4);
+	ADD_VECTOR_TYPE("float8", floatType, 8);
+#undef ADD_VECTOR_TYPE
+}
+
+int GetVectorLaneCount(TypeIndex typeIdx, SemanticContext* sc) {
+	if (typeIdx < 0 || sc->knownTypes.data[typeIdx].type != TypeInfo::UE_BuiltinTypeInfo) {
+		return 0;
+	}
+
+	return sc->knownTypes.data[typeIdx].AsBuiltinTypeInfo().laneCount;
+}
+
+bool IsVectorConstructorCall(ASTNode* call, SemanticContext* sc) {
+	if (call->type != ANT_FunctionCall) {
+		return false;
+	}
+
+	const SubString& name = call->ast->nodes.data[call->FunctionCall_value.func].Identifier_value.name;
+	return GetVectorLaneCount(GetSimpleTypeIndex(name, sc), sc) > 0;
+}
+
+// Resolves a type the program names, noting whether it's a vector
+static TypeIndex GetNamedTypeIndex(const SubString& typeName, SemanticContext* sc) {
+	TypeIndex typeIdx = GetSimpleTypeIndex(typeName, sc);
+	if (GetVectorLaneCount(typeIdx, sc) > 0) {
+		sc->usesVectorTypes = true;
+	}
+
+	return typeIdx;
+}
+
+TypeIndex GetSimpleTypeIndex(const SubString& typeName, SemanticContext* sc) {
+	BNS_VEC_FOREACH(sc->knownTypes) {
+		if (ptr->type == TypeInfo::UE_BuiltinTypeInfo && typeName == ((BuiltinTypeInfo*)&ptr->BuiltinTypeInfo_data)->name) {
+			return ptr - sc->knownTypes.data;
+		}
+		else if (ptr->type == TypeInfo::UE_StructTypeInfo && typeName == ((StructTypeInfo*)&ptr->StructTypeInfo_data)->name) {
+			// Instances share their generic's name, but are only named with their arguments
+			if (sc->definedStructs.data[((StructTypeInfo*)&ptr->StructTypeInfo_data)->index].genericIndex < 0) {
+				return ptr - sc->knownTypes.data;
+			}
+		}
+	}
+
+	return -1;
+}
+
+TypeIndex GetTypeOfField(StructDef* def, const SubString& name, SemanticContext* sc) {
+	BNS_VEC_FOREACH(def->fieldDecls) {
+		if (ptr->name == name) {
+			return ptr->typeIndex;
+		}
+	}
+
+	return -1;
+}
+
+VariableDecl* GetVariableByName(SubString name, SemanticContext* sc) {
+	BNS_VEC_FOREACH(sc->varsInScope) {
+		if (ptr->name == name) {
+			return ptr;
+		}
+	}
+
+	return nullptr;
+}
+
+TypeIndex GetTypeofVariable(SubString name, SemanticContext* sc) {
+	VariableDecl* decl = GetVariableByName(name, sc);
+	return (decl != nullptr) ? decl->typeIndex : -1;
+}
+
+NodeInfo* GetNodeInfo(ASTNode* node, SemanticContext* sc) {
+	ASTIndex idx = node->GetIndex();
+	if (idx >= 0 && idx < sc->nodeInfo.count) {
+		return &sc->nodeInfo.data[idx];
+	}
+
+	return nullptr;
+}
+
+static void RecordNodeSymbol(ASTNode* node, NodeSymbolKind kind, int symbolIndex, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(node, sc);
+	if (info != nullptr) {
+		info->symbolKind = kind;
+		info->symbolIndex = symbolIndex;
+		info->flags |= NIF_HasSymbol;
+	}
+}
+
+FuncDef* GetResolvedFuncDef(ASTNode* node, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(node, sc);
+	if (info != nullptr && (info->flags & NIF_HasSymbol) && info->symbolKind == NSK_Function) {
+		return &sc->definedFunctions.data[info->symbolIndex];
+	}
+
+	if (node->type == ANT_FunctionCall) {
+		ASTNode* funcVal = &node->ast->nodes.data[node->FunctionCall_value.func];
+		return GetFuncDefByName(funcVal->Identifier_value.name, sc);
+	}
+	else if (node->type == ANT_FunctionDefinition) {
+		ASTIndex idx = node->GetIndex();
+		BNS_VEC_FOREACH(sc->definedFunctions) {
+			if (ptr->idx == idx) {
+				return ptr;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+TypeIndex GetOrCreatePtrReferenceOf(TypeIndex subTypeIdx, SemanticContext* sc) {
+	BNS_VEC_FOREACH(sc->knownTypes) {
+		if (ptr->type == TypeInfo::UE_PointerTypeInfo) {
+			if (((PointerTypeInfo*)ptr->PointerTypeInfo_data)->subType == subTypeIdx) {
+				return (ptr - sc->knownTypes.data);
+			}
+		}
+	}
+
+	PointerTypeInfo newInfo;
+	newInfo.subType = subTypeIdx;
+	TypeInfo info;
+	info = newInfo;
+	sc->knownTypes.PushBack(info);
+	return sc->knownTypes.count - 1;
+}
+
+TypeIndex GetOrCreateArrayTypeOf(TypeIndex subTypeIdx, int len, SemanticContext* sc, bool isSoA = false) {
+	BNS_VEC_FOREACH(sc->knownTypes) {
+		if (ptr->type == TypeInfo::UE_ArrayTypeInfo) {
+			if (((ArrayTypeInfo*)ptr->ArrayTypeInfo_data)->arrayLen == len &&
+				((ArrayTypeInfo*)ptr->ArrayTypeInfo_data)->subType == subTypeIdx &&
+				((ArrayTypeInfo*)ptr->ArrayTypeInfo_data)->isSoA == isSoA) {
+				return (ptr - sc->knownTypes.data);
+			}
+		}
+	}
+
+	ArrayTypeInfo newInfo;
+	newInfo.subType = subTypeIdx;
+	newInfo.arrayLen = len;
+	newInfo.isSoA = isSoA;
+	TypeInfo info;
+	info = newInfo;
+	sc->knownTypes.PushBack(info);
+	return sc->knownTypes.count - 1;
+}
+
+static TypeIndex GetTypeIndexUncached(ASTNode* typeNode, SemanticContext* sc);
+
+static void RecordArrayLength(ASTNode* lenNode, const BNCBytecodeValue& val, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(lenNode, sc);
+	if (info != nullptr) {
+		if (val.type == BNCBytecodeValue::UE_BNCByteCodeInt) {
+			info->constantValue = val.AsBNCByteCodeInt();
+			info->flags |= NIF_HasConstant;
+		}
+		else {
+			info->flags |= NIF_NotConstant;
+		}
+	}
+}
+
+// Uses the value FoldArrayLengths recorded for lenNode if there is one, otherwise evaluates it
+static bool GetArrayLength(ASTNode* lenNode, SemanticContext* sc, int* outLen) {
+	NodeInfo* info = GetNodeInfo(lenNode, sc);
+	if (info == nullptr) {
+		BNCBytecodeValue val = CompileTimeInterpretASTExpression(lenNode, sc);
+		if (val.type != BNCBytecodeValue::UE_BNCByteCodeInt) {
+			return false;
+		}
+
+		*outLen = val.AsBNCByteCodeInt();
+		return true;
+	}
+
+	if (!(info->flags & (NIF_HasConstant | NIF_NotConstant))) {
+		RecordArrayLength(lenNode, CompileTimeInterpretASTExpression(lenNode, sc), sc);
+		// Re-fetched, since evaluating the length can evaluate other nodes
+		info = GetNodeInfo(lenNode, sc);
+	}
+
+	*outLen = info->constantValue;
+	return (info->flags & NIF_HasConstant) != 0;
+}
+
+static void CollectArrayLengths(ASTNode* typeNode, SemanticContext* sc, Vector<ASTNode*>* outLengths) {
+	NodeInfo* info = GetNodeInfo(typeNode, sc);
+	if (info != nullptr && (info->flags & NIF_HasType)) {
+		return;
+	}
+
+	AST* ast = typeNode->ast;
+	if (typeNode->type == ANT_TypeArray) {
+		ASTIndex lenIdx = typeNode->TypeArray_value.length;
+		if (lenIdx != ARRAY_DYNAMIC_LEN) {
+			outLengths->PushBack(&ast->nodes.data[lenIdx]);
+		}
+
+		CollectArrayLengths(&ast->nodes.data[typeNode->TypeArray_value.childType], sc, outLengths);
+	}
+	else if (typeNode->type == ANT_TypePointer) {
+		CollectArrayLengths(&ast->nodes.data[typeNode->TypePointer_value.childType], sc, outLengths);
+	}
 }
 
-TypeIndex GetSimpleTypeIndex(const SubString& typeName, SemanticContext* sc) {
-	BNS_VEC_FOREACH(sc->knownTypes) {
-		if (ptr->type == TypeInfo::UE_BuiltinTypeInfo && typeName == ((BuiltinTypeInfo*)&ptr->BuiltinTypeInfo_data)->name) {
-			return ptr - sc->knownTypes.data;
+// Evaluates every array length in a struct's field types in one pass, before the fields
+// themselves are resolved, so they share a VM context instead of each acquiring their own
+static void FoldArrayLengths(ASTNode* structNode, SemanticContext* sc) {
+	AST* ast = structNode->ast;
+	Vector<ASTNode*> lengths;
+	BNS_VEC_FOREACH(structNode->StructDefinition_value.fieldDecls) {
+		ASTNode* fieldNode = &ast->nodes.data[*ptr];
+		CollectArrayLengths(&ast->nodes.data[fieldNode->VariableDecl_value.type], sc, &lengths);
+	}
+
+	if (lengths.count == 0) {
+		return;
+	}
+
+	Vector<BNCBytecodeValue> values;
+	CompileTimeInterpretASTExpressions(lengths.data, lengths.count, sc, &values);
+	for (int i = 0; i < lengths.count; i++) {
+		RecordArrayLength(lengths.data[i], values.data[i], sc);
+	}
+}
+
+TypeIndex GetTypeIndex(ASTNode* typeNode, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(typeNode, sc);
+	if (info != nullptr && (info->flags & NIF_HasType)) {
+		return info->type;
+	}
+
+	TypeIndex typeIdx = GetTypeIndexUncached(typeNode, sc);
+	if (typeIdx >= 0) {
+		// Re-fetched, since resolving array lengths can evaluate other nodes
+		info = GetNodeInfo(typeNode, sc);
+		if (info != nullptr) {
+			info->type = typeIdx;
+			info->flags |= NIF_HasType;
+		}
+	}
+
+	return typeIdx;
+}
+
+static TypeIndex GetTypeIndexUncached(ASTNode* typeNode, SemanticContext* sc) {
+	if (typeNode->type == ANT_TypeSimple) {
+		ASTNode* typeIdent = &typeNode->ast->nodes.data[typeNode->TypeSimple_value.name];
+		if (typeIdent->type == ANT_TypeGeneric) {
+			return GetTypeIndex(typeIdent, sc);
+		}
+
+		ASSERT(typeIdent->type == ANT_Identifier);
+		return GetNamedTypeIndex(typeIdent->Identifier_value.name, sc);
+	}
+	else if (typeNode->type == ANT_TypePointer) {
+		ASTIndex subIdx = typeNode->TypePointer_value.childType;
+		ASTNode* subNode = &typeNode->ast->nodes.data[subIdx];
+		TypeIndex subTypeIdx = GetTypeIndex(subNode, sc);
+		return GetOrCreatePtrReferenceOf(subTypeIdx, sc);
+	}
+	else if (typeNode->type == ANT_TypeArray) {
+		ASTIndex subIdx = typeNode->TypeArray_value.childType;
+		ASTNode* subNode = &typeNode->ast->nodes.data[subIdx];
+
+		int arrayLen = ARRAY_DYNAMIC_LEN;
+
+		ASTIndex lenIdx = typeNode->TypeArray_value.length;
+		if (lenIdx != ARRAY_DYNAMIC_LEN) {
+			ASTNode* lenNode = &typeNode->ast->nodes.data[lenIdx];
+			if (!GetArrayLength(lenNode, sc, &arrayLen)) {
+				fprintf(sc->diagnosticsFile, "Error: array length must be an int known at compile time.\n");
+				return -1;
+			}
+		}
+
+		TypeIndex subTypeIdx = GetTypeIndex(subNode, sc);
+		if (subTypeIdx < 0) {
+			return -1;
+		}
+
+		bool isSoA = typeNode->TypeArray_value.isSoA;
+		if (isSoA) {
+			if (sc->knownTypes.data[subTypeIdx].type != TypeInfo::UE_StructTypeInfo) {
+				fprintf(sc->diagnosticsFile, "Error: soa arrays must have a struct element type.\n");
+				return -1;
+			}
+			else if (arrayLen == ARRAY_DYNAMIC_LEN) {
+				fprintf(sc->diagnosticsFile, "Error: soa arrays must have a fixed length.\n");
+				return -1;
+			}
+		}
+
+		return GetOrCreateArrayTypeOf(subTypeIdx, arrayLen, sc, isSoA);
+	}
+	else if (typeNode->type == ANT_TypeGeneric) {
+		int genericIndex = GetGenericStructIndex(&typeNode->ast->nodes.data[typeNode->TypeGeneric_value.childType], sc);
+		if (genericIndex < 0) {
+			return -1;
+		}
+
+		Vector<TypeIndex> args;
+		BNS_VEC_FOREACH(typeNode->TypeGeneric_value.args) {
+			ASTNode* argNode = &typeNode->ast->nodes.data[*ptr];
+			TypeIndex argType = IsTypeNode(argNode) ? GetTypeIndex(argNode, sc) : -1;
+			if (argType < 0) {
+				fprintf(sc->diagnosticsFile, "Error: arguments to generic struct '%.*s' must be types.\n",
+					BNS_LEN_START(sc->definedStructs.data[genericIndex].name));
+				return -1;
+			}
+
+			args.PushBack(argType);
+		}
+
+		return InstantiateGenericStruct(genericIndex, args, sc);
+	}
+	else {
+		ASSERT(false);
+		return -1;
+	}
+}
+
+static bool IsTypeNode(ASTNode* node) {
+	return node->type == ANT_TypeSimple || node->type == ANT_TypePointer || node->type == ANT_TypeArray;
+}
+
+static int GetGenericStructIndex(ASTNode* nameNode, SemanticContext* sc) {
+	ASSERT(nameNode->type == ANT_Identifier);
+	for (int i = 0; i < sc->definedStructs.count; i++) {
+		StructDef* def = &sc->definedStructs.data[i];
+		if (def->isGeneric && def->name == nameNode->Identifier_value.name) {
+			return i;
+		}
+	}
+
+	fprintf(sc->diagnosticsFile, "Error: '%.*s' is not a generic struct.\n", BNS_LEN_START(nameNode->Identifier_value.name));
+	return -1;
+}
+
+static unsigned int HashGenericInstance(int genericIndex, const Vector<TypeIndex>& args) {
+	// FNV-1a over the generic and its arguments
+	unsigned int hash = 2166136261u;
+	hash = (hash ^ (unsigned int)genericIndex) * 16777619u;
+	BNS_VEC_FOREACH(args) {
+		hash = (hash ^ (unsigned int)*ptr) * 16777619u;
+	}
+
+	return hash;
+}
+
+// Returns the slot holding this instance, or the empty slot it would go in
+static int FindGenericInstanceSlot(unsigned int hash, int genericIndex, const Vector<TypeIndex>& args, SemanticContext* sc) {
+	int mask = sc->genericInstances.count - 1;
+	for (int slot = hash & mask; ; slot = (slot + 1) & mask) {
+		GenericInstanceEntry* entry = &sc->genericInstances.data[slot];
+		if (entry->structIndex < 0) {
+			return slot;
+		}
+
+		if (entry->hash == hash) {
+			StructDef* inst = &sc->definedStructs.data[entry->structIndex];
+			bool argsMatch = inst->genericIndex == genericIndex && inst->genericArgs.count == args.count;
+			for (int i = 0; argsMatch && i < args.count; i++) {
+				argsMatch = inst->genericArgs.data[i] == args.data[i];
+			}
+
+			if (argsMatch) {
+				return slot;
+			}
+		}
+	}
+}
+
+static void GrowGenericInstances(SemanticContext* sc) {
+	Vector<GenericInstanceEntry> oldEntries;
+	StealVector(&oldEntries, &sc->genericInstances);
+
+	int slotCount = BNS_MAX(16, oldEntries.count * 2);
+	GenericInstanceEntry emptyEntry;
+	emptyEntry.hash = 0;
+	emptyEntry.structIndex = -1;
+	emptyEntry.typeIndex = -1;
+	sc->genericInstances.EnsureCapacity(slotCount);
+	for (int i = 0; i < slotCount; i++) {
+		sc->genericInstances.PushBack(emptyEntry);
+	}
+
+	int mask = slotCount - 1;
+	BNS_VEC_FOREACH(oldEntries) {
+		if (ptr->structIndex >= 0) {
+			int slot = ptr->hash & mask;
+			while (sc->genericInstances.data[slot].structIndex >= 0) {
+				slot = (slot + 1) & mask;
+			}
+
+			sc->genericInstances.data[slot] = *ptr;
+		}
+	}
+}
+
+// Resolves a type written inside a generic struct, with its parameters bound to args.
+// Every instance shares the generic's nodes, so nothing is cached on them
+static TypeIndex ResolveGenericFieldType(ASTNode* typeNode, ASTNode* genericNode, const Vector<TypeIndex>& args, SemanticContext* sc) {
+	AST* ast = typeNode->ast;
+	if (typeNode->type == ANT_TypeSimple) {
+		ASTNode* typeIdent = &ast->nodes.data[typeNode->TypeSimple_value.name];
+		if (typeIdent->type == ANT_TypeGeneric) {
+			return ResolveGenericFieldType(typeIdent, genericNode, args, sc);
+		}
+
+		const Vector<ASTIndex>& params = genericNode->StructDefinition_value.genericParams;
+		for (int i = 0; i < params.count; i++) {
+			ASTNode* paramName = &ast->nodes.data[ast->nodes.data[params.data[i]].VariableDecl_value.varName];
+			if (paramName->Identifier_value.name == typeIdent->Identifier_value.name) {
+				return args.data[i];
+			}
+		}
+
+		return GetNamedTypeIndex(typeIdent->Identifier_value.name, sc);
+	}
+	else if (typeNode->type == ANT_TypePointer) {
+		TypeIndex subTypeIdx = ResolveGenericFieldType(&ast->nodes.data[typeNode->TypePointer_value.childType], genericNode, args, sc);
+		return (subTypeIdx < 0) ? -1 : GetOrCreatePtrReferenceOf(subTypeIdx, sc);
+	}
+	else if (typeNode->type == ANT_TypeArray) {
+		if (typeNode->TypeArray_value.isSoA) {
+			fprintf(sc->diagnosticsFile, "Error: soa arrays aren't supported in generic structs.\n");
+			return -1;
+		}
+
+		int arrayLen = ARRAY_DYNAMIC_LEN;
+		ASTIndex lenIdx = typeNode->TypeArray_value.length;
+		if (lenIdx != ARRAY_DYNAMIC_LEN) {
+			if (!GetArrayLength(&ast->nodes.data[lenIdx], sc, &arrayLen)) {
+				return -1;
+			}
+		}
+
+		TypeIndex subTypeIdx = ResolveGenericFieldType(&ast->nodes.data[typeNode->TypeArray_value.childType], genericNode, args, sc);
+		return (subTypeIdx < 0) ? -1 : GetOrCreateArrayTypeOf(subTypeIdx, arrayLen, sc);
+	}
+	else if (typeNode->type == ANT_TypeGeneric) {
+		int genericIndex = GetGenericStructIndex(&ast->nodes.data[typeNode->TypeGeneric_value.childType], sc);
+		if (genericIndex < 0) {
+			return -1;
+		}
+
+		Vector<TypeIndex> innerArgs;
+		BNS_VEC_FOREACH(typeNode->TypeGeneric_value.args) {
+			ASTNode* argNode = &ast->nodes.data[*ptr];
+			TypeIndex argType = IsTypeNode(argNode) ? ResolveGenericFieldType(argNode, genericNode, args, sc) : -1;
+			if (argType < 0) {
+				return -1;
+			}
+
+			innerArgs.PushBack(argType);
+		}
+
+		return InstantiateGenericStruct(genericIndex, innerArgs, sc);
+	}
+
+	return -1;
+}
+
+// Each distinct argument list is instantiated once, and its fields are resolved right away.
+// definedStructs can grow here, so StructDefs are only referred to by index
+static TypeIndex InstantiateGenericStruct(int genericIndex, const Vector<TypeIndex>& args, SemanticContext* sc) {
+	if (!sc->definedStructs.data[genericIndex].isTypeChecked) {
+		CheckStructDefinition(&sc->definedStructs.data[genericIndex], sc);
+	}
+
+	StructDef* genericDef = &sc->definedStructs.data[genericIndex];
+	if (genericDef->layoutState == LS_Error) {
+		return -1;
+	}
+
+	ASTNode* genericNode = &sc->ast->nodes.data[genericDef->idx];
+	int paramCount = genericNode->StructDefinition_value.genericParams.count;
+	if (args.count != paramCount) {
+		fprintf(sc->diagnosticsFile, "Error: generic struct '%.*s' takes %d argument(s), but was given %d.\n",
+			BNS_LEN_START(genericDef->name), paramCount, args.count);
+		return -1;
+	}
+
+	if ((sc->genericInstanceCount + 1) * 2 > sc->genericInstances.count) {
+		GrowGenericInstances(sc);
+	}
+
+	unsigned int hash = HashGenericInstance(genericIndex, args);
+	int slot = FindGenericInstanceSlot(hash, genericIndex, args, sc);
+	if (sc->genericInstances.data[slot].structIndex >= 0) {
+		return sc->genericInstances.data[slot].typeIndex;
+	}
+
+	int structIndex = sc->definedStructs.count;
+	StructDef* def = &sc->definedStructs.EmplaceBack();
+	genericDef = &sc->definedStructs.data[genericIndex];
+	def->idx = genericDef->idx;
+	def->name = genericDef->name;
+	def->isTypeChecked = true;
+	def->isTypeCheckInProgress = false;
+	def->isReachable = true;
+	def->isGeneric = false;
+	def->genericIndex = genericIndex;
+	BNS_VEC_FOREACH(args) {
+		def->genericArgs.PushBack(*ptr);
+	}
+	def->layoutState = LS_NotComputed;
+	def->size = -1;
+	def->alignment = -1;
+
+	TypeInfo info;
+	StructTypeInfo str;
+	str.name = def->name;
+	str.index = structIndex;
+	info = str;
+	sc->knownTypes.PushBack(info);
+	TypeIndex typeIdx = sc->knownTypes.count - 1;
+
+	// Cached before the fields are resolved, so a field can point back at this instance
+	GenericInstanceEntry* entry = &sc->genericInstances.data[slot];
+	entry->hash = hash;
+	entry->structIndex = structIndex;
+	entry->typeIndex = typeIdx;
+	sc->genericInstanceCount++;
+
+	BNS_VEC_FOREACH(genericNode->StructDefinition_value.fieldDecls) {
+		ASTNode* fieldNode = &sc->ast->nodes.data[*ptr];
+		ASTNode* typeNode = &sc->ast->nodes.data[fieldNode->VariableDecl_value.type];
+		TypeIndex fieldTypeIdx = ResolveGenericFieldType(typeNode, genericNode, args, sc);
+
+		VariableDecl decl;
+		decl.idx = *ptr;
+		decl.name = sc->ast->nodes.data[fieldNode->VariableDecl_value.varName].Identifier_value.name;
+		decl.typeIndex = fieldTypeIdx;
+		decl.offset = 0;
+
+		def = &sc->definedStructs.data[structIndex];
+		def->fieldDecls.PushBack(decl);
+
+		if (fieldTypeIdx < 0) {
+			fprintf(sc->diagnosticsFile, "Error: could not resolve the type of field '%.*s' in generic struct '%.*s'.\n",
+				BNS_LEN_START(decl.name), BNS_LEN_START(def->name));
+			def->layoutState = LS_Error;
+		}
+	}
+
+	return typeIdx;
+}
+
+// Instantiating can add to definedStructs, which would leave any StructDef pointer held further
+// up the stack dangling. So every generic named outside a generic struct is instantiated up
+// front, before anything else is checked, and later lookups hit the node cache instead
+static void InstantiateGenericStructUses(AST* ast, SemanticContext* sc) {
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(ast->nodes.count - 1);
+	while (toVisit.count > 0) {
+		ASTNode* node = &ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		if (node->type == ANT_StructDefinition && node->StructDefinition_value.genericParams.count > 0) {
+			continue;
+		}
+		else if (node->type == ANT_TypeGeneric) {
+			GetTypeIndex(node, sc);
+			continue;
+		}
+
+		GetChildNodes(node, &toVisit);
+	}
+}
+
+// Reads a whole number of at least minValue from an option's operand, which has to be nothing but digits
+static bool ParseIntOperand(const char* option, const char* operand, int minValue, int* outValue, CompilerOptions* options) {
+	long long value = 0;
+	bool isValid = (*operand != '\0');
+	for (const char* c = operand; *c != '\0' && isValid; c++) {
+		isValid = (*c >= '0' && *c <= '9');
+		value = value * 10 + (*c - '0');
+		isValid &= (value <= INT_MAX);
+	}
+
+	if (!isValid || value < minValue) {
+		printf("Error: '%s' takes a whole number of at least %d, not '%s'.\n", option, minValue, operand);
+		options->hasInvalidOperand = true;
+		return false;
+	}
+
+	*outValue = (int)value;
+	return true;
+}
+
+bool ParseCompilerOption(const char* const* args, int argCount, int* index, CompilerOptions* options) {
+	int i = *index;
+	if (StrEqual(args[i], "-inline")) {
+		options->inlineSmallFunctions = true;
+	}
+	else if (StrEqual(args[i], "-inline-max-nodes") && i + 1 < argCount) {
+		i++;
+		ParseIntOperand(args[i - 1], args[i], 1, &options->inlineMaxNodes, options);
+	}
+	else if (StrEqual(args[i], "-reorder-fields")) {
+		options->reorderStructFields = true;
+	}
+	else if (StrEqual(args[i], "-dce")) {
+		options->eliminateDeadCode = true;
+	}
+	else if (StrEqual(args[i], "-lazy")) {
+		options->lazySemantics = true;
+	}
+	else if (StrEqual(args[i], "-bounds-checks")) {
+		options->boundsChecks = true;
+	}
+	else if (StrEqual(args[i], "-struct-ptrs")) {
+		options->passLargeStructsByPointer = true;
+	}
+	else if (StrEqual(args[i], "-struct-by-value-max") && i + 1 < argCount) {
+		i++;
+		ParseIntOperand(args[i - 1], args[i], 0, &options->structByValueMaxSize, options);
+	}
+	else if (StrEqual(args[i], "-restrict")) {
+		options->restrictPointerParams = true;
+	}
+	else if (StrEqual(args[i], "-purity-attrs")) {
+		options->emitPurityAttributes = true;
+	}
+	else if (StrEqual(args[i], "-ssa")) {
+		options->lowerThroughSSA = true;
+	}
+	else if (StrEqual(args[i], "-jit")) {
+		options->jitCompileTimeCode = true;
+	}
+	else if (StrEqual(args[i], "-opt-bytecode")) {
+		options->optimizeBytecode = true;
+	}
+	else if (StrEqual(args[i], "-profile-bytecode")) {
+		options->profileBytecode = true;
+	}
+	else if (StrEqual(args[i], "-shards") && i + 1 < argCount) {
+		i++;
+		ParseIntOperand(args[i - 1], args[i], 1, &options->outputShardCount, options);
+	}
+	else if (StrEqual(args[i], "-out") && i + 1 < argCount) {
+		i++;
+		options->outputPathPrefix = args[i];
+	}
+	else if (StrEqual(args[i], "-export") && i + 1 < argCount) {
+		i++;
+		options->rootFunctionNames.PushBack(args[i]);
+	}
+	else {
+		return false;
+	}
+
+	*index = i;
+	return true;
+}
+
+static void CheckStructDefinition(StructDef* def, SemanticContext* sc) {
+	TypeCheckResult res = TypeCheckStructDef(def, sc, sc->ast);
+	if (res != TCR_Success) {
+		fprintf(sc->diagnosticsFile, "Failed to type-check struct.\n");
+	}
+	else {
+		fprintf(sc->diagnosticsFile, "Type checking worked!\n");
+	}
+}
+
+static void ComputeStructLayoutOrReport(StructDef* def, SemanticContext* sc) {
+	if (!ComputeStructLayout(def, sc)) {
+		fprintf(sc->diagnosticsFile, "Failed to compute layout of struct '%.*s'.\n", BNS_LEN_START(def->name));
+	}
+}
+
+static void CheckGlobalVarDecl(ASTNode* stmt, SemanticContext* sc) {
+	ASSERT(stmt->type == ANT_VariableDecl);
+
+	int typeIdx;
+	TypeCheckResult res = TypeCheckVarDecl(stmt, sc, &typeIdx);
+	if (res == TCR_Error) {
+		fprintf(sc->diagnosticsFile, "Failed to typecheck var decl\n");
+	}
+}
+
+static void CheckFunctionDefinition(FuncDef* def, SemanticContext* sc) {
+	TypeCheckResult res = TypeCheckFunctionDef(def, sc, sc->ast);
+	if (res != TCR_Success) {
+		fprintf(sc->diagnosticsFile, "Failed to type-check func def.\n");
+	}
+	else {
+		fprintf(sc->diagnosticsFile, "Type checking worked!\n");
+	}
+}
+
+static void AnalyseReachableDefinitions(AST* ast, SemanticContext* sc, const Vector<ASTIndex>& globalVarDecls);
+static void ResolveFunctionSignature(FuncDef* def, SemanticContext* sc);
+
+void DoSemantics(AST* ast, SemanticContext* sc) {
+	ASTNode* root = &ast->nodes.Back();
+
+	sc->ast = ast;
+	InitSemanticContextWithBuiltinTypes(sc);
+
+	sc->nodeInfo.Clear();
+	sc->nodeInfo.EnsureCapacity(ast->nodes.count);
+	for (int i = 0; i < ast->nodes.count; i++) {
+		NodeInfo info;
+		info.type = -1;
+		info.symbolKind = NSK_None;
+		info.symbolIndex = -1;
+		info.constantValue = 0;
+		info.flags = 0;
+		sc->nodeInfo.PushBack(info);
+	}
+
+	const Vector<ASTIndex>& topStmts = root->Root_value.topLevelStatements;
+	Vector<ASTIndex> globalVarDecls;
+	bool anyGenericStructs = false;
+	BNS_VEC_FOREACH(topStmts) {
+		ASTNode* topStmt = &ast->nodes.data[*ptr];
+		if (topStmt->type == ANT_FunctionDefinition) {
+			// Filled in place, so its vectors are never copied
+			FuncDef* def = &sc->definedFunctions.EmplaceBack();
+			def->idx = *ptr;
+			ASTIndex funcNameIdx = ast->nodes.data[*ptr].FunctionDefinition_value.name;
+			def->name = ast->nodes.data[funcNameIdx].Identifier_value.name;
+			def->bodySize = 0;
+			def->shouldInline = false;
+			def->isRecursive = false;
+			def->isReachable = true;
+			def->returnsThroughPointer = false;
+			def->purity = FP_Impure;
+
+			RecordNodeSymbol(topStmt, NSK_Function, sc->definedFunctions.count - 1, sc);
+		}
+		else if (topStmt->type == ANT_StructDefinition) {
+			ASTIndex structNameIdx = topStmt->StructDefinition_value.structName;
+			bool isGeneric = topStmt->StructDefinition_value.genericParams.count > 0;
+
+			StructDef* def = &sc->definedStructs.EmplaceBack();
+			def->idx = *ptr;
+			def->name = ast->nodes.data[structNameIdx].Identifier_value.name;
+			def->isTypeChecked = false;
+			def->isTypeCheckInProgress = false;
+			def->isReachable = !isGeneric;
+			def->isGeneric = isGeneric;
+			def->genericIndex = -1;
+			def->layoutState = LS_NotComputed;
+			def->size = -1;
+			def->alignment = -1;
+
+			anyGenericStructs |= isGeneric;
+
+			// Only instances of a generic are types, the generic itself can't be named alone
+			if (!isGeneric) {
+				TypeInfo info;
+				StructTypeInfo str;
+				str.name = def->name;
+				str.index = sc->definedStructs.count - 1;
+				info = str;
+
+				sc->knownTypes.PushBack(info);
+			}
+		}
+		else if (topStmt->type == ANT_Statement) {
+			ASTNode* stmt = &ast->nodes.data[topStmt->Statement_value.root];
+			if (stmt->type == ANT_VariableDecl) {
+				globalVarDecls.PushBack(stmt->GetIndex());
+			}
+		}
+	}
+
+	if (anyGenericStructs) {
+		InstantiateGenericStructUses(ast, sc);
+	}
+
+	bool analyseLazily = sc->options.lazySemantics;
+	if (analyseLazily && sc->options.rootFunctionNames.count == 0) {
+		fprintf(sc->diagnosticsFile, "Warning: -lazy needs an -export root, analysing everything.\n");
+		analyseLazily = false;
+		sc->options.lazySemantics = false;
+	}
+
+	if (analyseLazily) {
+		AnalyseReachableDefinitions(ast, sc, globalVarDecls);
+		BuildCallGraph(ast, sc);
+		InferFunctionPurity(ast, sc);
+		return;
+	}
+
+	BNS_VEC_FOREACH(sc->definedStructs) {
+		// Structs may already have been checked, if a size_of() needed their layout
+		if (!ptr->isTypeChecked) {
+			CheckStructDefinition(ptr, sc);
+		}
+	}
+
+	BNS_VEC_FOREACH(sc->definedStructs) {
+		if (!ptr->isGeneric) {
+			ComputeStructLayoutOrReport(ptr, sc);
+		}
+	}
+
+	BNS_VEC_FOREACH(globalVarDecls) {
+		CheckGlobalVarDecl(&ast->nodes.data[*ptr], sc);
+	}
+
+	// Bodies can call functions defined after them, mutually recursive ones included
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		ResolveFunctionSignature(ptr, sc);
+	}
+
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		CheckFunctionDefinition(ptr, sc);
+	}
+
+	BuildCallGraph(ast, sc);
+	InferFunctionPurity(ast, sc);
+
+	if (sc->options.eliminateDeadCode && sc->options.rootFunctionNames.count == 0) {
+		fprintf(sc->diagnosticsFile, "Warning: -dce needs an -export root, keeping everything.\n");
+		sc->options.eliminateDeadCode = false;
+	}
+
+	if (sc->options.eliminateDeadCode) {
+		MarkReachableDefinitions(ast, sc);
+	}
+}
+
+// Finds the call graph's strongly connected components with Tarjan's algorithm, run iteratively.
+// A function is recursive if its component has any other function in it, or if it calls itself
+static void MarkRecursiveFunctions(SemanticContext* sc) {
+	int funcCount = sc->definedFunctions.count;
+	Vector<int> order;
+	Vector<int> lowLink;
+	Vector<bool> isOnStack;
+	for (int i = 0; i < funcCount; i++) {
+		order.PushBack(-1);
+		lowLink.PushBack(-1);
+		isOnStack.PushBack(false);
+	}
+
+	// Each frame is a function and how many of its callees have been visited so far
+	Vector<int> frameFuncs;
+	Vector<int> frameCallees;
+	Vector<int> componentStack;
+	int nextOrder = 0;
+
+	for (int root = 0; root < funcCount; root++) {
+		if (order.data[root] >= 0) {
+			continue;
+		}
+
+		order.data[root] = lowLink.data[root] = nextOrder++;
+		componentStack.PushBack(root);
+		isOnStack.data[root] = true;
+		frameFuncs.PushBack(root);
+		frameCallees.PushBack(0);
+
+		while (frameFuncs.count > 0) {
+			int func = frameFuncs.Back();
+			const Vector<int>& calledFuncs = sc->definedFunctions.data[func].calledFuncs;
+			if (frameCallees.Back() < calledFuncs.count) {
+				int callee = calledFuncs.data[frameCallees.Back()];
+				frameCallees.Back()++;
+
+				if (order.data[callee] < 0) {
+					order.data[callee] = lowLink.data[callee] = nextOrder++;
+					componentStack.PushBack(callee);
+					isOnStack.data[callee] = true;
+					frameFuncs.PushBack(callee);
+					frameCallees.PushBack(0);
+				}
+				else if (isOnStack.data[callee] && order.data[callee] < lowLink.data[func]) {
+					lowLink.data[func] = order.data[callee];
+				}
+
+				continue;
+			}
+
+			frameFuncs.PopBack();
+			frameCallees.PopBack();
+			if (frameFuncs.count > 0 && lowLink.data[func] < lowLink.data[frameFuncs.Back()]) {
+				lowLink.data[frameFuncs.Back()] = lowLink.data[func];
+			}
+
+			if (lowLink.data[func] == order.data[func]) {
+				bool isCycle = (componentStack.Back() != func);
+				int member;
+				do {
+					member = componentStack.Back();
+					componentStack.PopBack();
+					isOnStack.data[member] = false;
+					FuncDef* def = &sc->definedFunctions.data[member];
+					def->isRecursive = isCycle;
+					BNS_VEC_FOREACH_NAME(def->calledFuncs, calleePtr) {
+						def->isRecursive |= (*calleePtr == member);
+					}
+				} while (member != func);
+			}
+		}
+	}
+}
+
+void BuildCallGraph(AST* ast, SemanticContext* sc) {
+	Vector<ASTIndex> toVisit;
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		ptr->calledFuncs.Clear();
+
+		// Lazily analysed programs leave unreached bodies alone altogether
+		if (sc->options.lazySemantics && !ptr->isReachable) {
+			continue;
+		}
+
+		ASTNode* defNode = &ast->nodes.data[ptr->idx];
+		ASTNode* bodyNode = &ast->nodes.data[defNode->FunctionDefinition_value.bodyScope];
+		ptr->bodySize = CountASTNodes(bodyNode);
+
+		toVisit.PushBack(bodyNode->GetIndex());
+		while (toVisit.count > 0) {
+			ASTNode* node = &ast->nodes.data[toVisit.Back()];
+			toVisit.PopBack();
+
+			if (node->type == ANT_FunctionCall) {
+				FuncDef* callee = GetResolvedFuncDef(node, sc);
+				if (callee != nullptr) {
+					int calleeIdx = callee - sc->definedFunctions.data;
+					bool alreadyCalled = false;
+					BNS_VEC_FOREACH_NAME(ptr->calledFuncs, calledPtr) {
+						if (*calledPtr == calleeIdx) {
+							alreadyCalled = true;
+							break;
+						}
+					}
+
+					if (!alreadyCalled) {
+						ptr->calledFuncs.PushBack(calleeIdx);
+					}
+				}
+			}
+
+			GetChildNodes(node, &toVisit);
+		}
+	}
+
+	MarkRecursiveFunctions(sc);
+}
+
+void GetDeclKinds(AST* ast, Vector<unsigned char>* outKinds) {
+	outKinds->Clear();
+	outKinds->EnsureCapacity(ast->nodes.count);
+	for (int i = 0; i < ast->nodes.count; i++) {
+		outKinds->PushBack(DK_Local);
+	}
+
+	BNS_VEC_FOREACH(ast->nodes.Back().Root_value.topLevelStatements) {
+		ASTNode* stmt = &ast->nodes.data[*ptr];
+		if (stmt->type == ANT_FunctionDefinition) {
+			BNS_VEC_FOREACH_NAME(stmt->FunctionDefinition_value.params, paramPtr) {
+				outKinds->data[*paramPtr] = DK_Param;
+			}
+		}
+		else if (stmt->type == ANT_Statement && ast->nodes.data[stmt->Statement_value.root].type == ANT_VariableDecl) {
+			outKinds->data[stmt->Statement_value.root] = DK_Global;
+		}
+	}
+}
+
+static FunctionPurity MinPurity(FunctionPurity a, FunctionPurity b) {
+	return (a < b) ? a : b;
+}
+
+// Where the variable an identifier names lives, or -1 if it doesn't name one
+static int GetUseDeclKind(ASTNode* ident, const Vector<unsigned char>& declKinds, SemanticContext* sc, ASTIndex* outDecl = nullptr) {
+	NodeInfo* info = GetNodeInfo(ident, sc);
+	if (ident->type != ANT_Identifier || info == nullptr || !(info->flags & NIF_HasSymbol) || info->symbolKind != NSK_Variable) {
+		return -1;
+	}
+
+	if (outDecl != nullptr) {
+		*outDecl = info->symbolIndex;
+	}
+
+	return declKinds.data[info->symbolIndex];
+}
+
+static bool IsFixedArrayValue(ASTNode* val, SemanticContext* sc) {
+	TypeIndex valType;
+	if (TypeCheckValue(val, sc, &valType) != TCR_Success) {
+		return false;
+	}
+
+	const TypeInfo& info = sc->knownTypes.data[valType];
+	return info.type == TypeInfo::UE_ArrayTypeInfo && !info.AsArrayTypeInfo().isSoA
+		&& info.AsArrayTypeInfo().arrayLen != ARRAY_DYNAMIC_LEN;
+}
+
+// Whether assigning to an lvalue only changes the function's own locals (parameters included,
+// since they're copies). Array parameters and anything behind a pointer or slice belong to someone else
+static bool IsLocalLvalue(ASTNode* node, const Vector<unsigned char>& declKinds, SemanticContext* sc) {
+	while (true) {
+		if (node->type == ANT_Parentheses) {
+			node = &node->ast->nodes.data[node->Parentheses_value.val];
+		}
+		else if (node->type == ANT_BinaryOp && StrEqual(node->BinaryOp_value.op, ".")) {
+			node = &node->ast->nodes.data[node->BinaryOp_value.left];
+		}
+		else if (node->type == ANT_ArrayAccess) {
+			node = &node->ast->nodes.data[node->ArrayAccess_value.arr];
+			if (!IsFixedArrayValue(node, sc)) {
+				return false;
+			}
+		}
+		else {
+			break;
+		}
+	}
+
+	int declKind = GetUseDeclKind(node, declKinds, sc);
+	return declKind == DK_Local || (declKind == DK_Param && !IsFixedArrayValue(node, sc));
+}
+
+// How pure a body is on its own, leaving out what the functions it calls do
+static FunctionPurity GetDirectBodyPurity(ASTNode* body, const Vector<unsigned char>& declKinds, SemanticContext* sc) {
+	FunctionPurity purity = FP_Const;
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(body->GetIndex());
+	while (toVisit.count > 0 && purity != FP_Impure) {
+		ASTNode* node = &body->ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		switch (node->type) {
+		case ANT_VariableAssign: {
+			if (!IsLocalLvalue(&node->ast->nodes.data[node->VariableAssign_value.var], declKinds, sc)) {
+				purity = FP_Impure;
+			}
+		} break;
+
+		case ANT_Identifier: {
+			// Array parameters decay to pointers to the caller's array
+			int declKind = GetUseDeclKind(node, declKinds, sc);
+			if (declKind == DK_Global || (declKind == DK_Param && IsFixedArrayValue(node, sc))) {
+				purity = MinPurity(purity, FP_Pure);
+			}
+		} break;
+
+		case ANT_UnaryOp: {
+			if (StrEqual(node->UnaryOp_value.op, "^") && node->UnaryOp_value.isPre) {
+				purity = MinPurity(purity, FP_Pure);
+			}
+		} break;
+
+		case ANT_ArrayAccess: {
+			// A failed bounds check aborts, which callers mustn't optimise away
+			NodeInfo* info = GetNodeInfo(node, sc);
+			if (sc->options.boundsChecks && !(info->flags & NIF_IndexInBounds)) {
+				purity = FP_Impure;
+			}
+			else if (!IsFixedArrayValue(&node->ast->nodes.data[node->ArrayAccess_value.arr], sc)) {
+				purity = MinPurity(purity, FP_Pure);
+			}
+		} break;
+
+		case ANT_FunctionCall: {
+			if (GetResolvedFuncDef(node, sc) == nullptr && !IsLayoutIntrinsicCall(node) && !IsVectorConstructorCall(node, sc)) {
+				purity = FP_Impure;
+			}
+		} break;
+
+		default: break;
+		}
+
+		GetChildNodes(node, &toVisit);
+	}
+
+	return purity;
+}
+
+// Starts each function at its body's own purity, then lowers it to that of anything it calls until
+// nothing changes. Functions only ever get less pure, so mutually recursive ones settle too
+void InferFunctionPurity(AST* ast, SemanticContext* sc) {
+	Vector<unsigned char> declKinds;
+	GetDeclKinds(ast, &declKinds);
+
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		ptr->purity = FP_Impure;
+		if (sc->options.lazySemantics && !ptr->isReachable) {
+			continue;
+		}
+
+		ASTNode* defNode = &ast->nodes.data[ptr->idx];
+		ptr->purity = GetDirectBodyPurity(&ast->nodes.data[defNode->FunctionDefinition_value.bodyScope], declKinds, sc);
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		BNS_VEC_FOREACH(sc->definedFunctions) {
+			BNS_VEC_FOREACH_NAME(ptr->calledFuncs, calleePtr) {
+				FunctionPurity lowered = MinPurity(ptr->purity, sc->definedFunctions.data[*calleePtr].purity);
+				if (lowered != ptr->purity) {
+					ptr->purity = lowered;
+					changed = true;
+				}
+			}
+		}
+	}
+}
+
+void MarkTypeReachable(TypeIndex typeIdx, SemanticContext* sc) {
+	if (typeIdx < 0) {
+		return;
+	}
+
+	TypeInfo* info = &sc->knownTypes.data[typeIdx];
+	if (info->type == TypeInfo::UE_StructTypeInfo) {
+		StructDef* def = &sc->definedStructs.data[info->AsStructTypeInfo().index];
+		if (!def->isReachable) {
+			def->isReachable = true;
+
+			// Fields are only known once the struct is checked
+			if (sc->options.lazySemantics) {
+				if (!def->isTypeChecked) {
+					CheckStructDefinition(def, sc);
+				}
+
+				ComputeStructLayoutOrReport(def, sc);
+			}
+
+			BNS_VEC_FOREACH(def->fieldDecls) {
+				MarkTypeReachable(ptr->typeIndex, sc);
+			}
+		}
+	}
+	else if (info->type == TypeInfo::UE_PointerTypeInfo) {
+		// Pointed-to structs are kept too, since they can be dereferenced without being named
+		MarkTypeReachable(info->AsPointerTypeInfo().subType, sc);
+	}
+	else if (info->type == TypeInfo::UE_ArrayTypeInfo) {
+		MarkTypeReachable(info->AsArrayTypeInfo().subType, sc);
+	}
+}
+
+// A function's callers can be checked before its body is, so they need its signature up front
+static void ResolveFunctionSignature(FuncDef* def, SemanticContext* sc) {
+	ASTNode* defNode = &sc->ast->nodes.data[def->idx];
+	def->retType = GetTypeIndex(&sc->ast->nodes.data[defNode->FunctionDefinition_value.returnType], sc);
+
+	def->argTypes.Clear();
+	BNS_VEC_FOREACH(defNode->FunctionDefinition_value.params) {
+		ASTNode* param = &sc->ast->nodes.data[*ptr];
+		def->argTypes.PushBack(GetTypeIndex(&sc->ast->nodes.data[param->VariableDecl_value.type], sc));
+	}
+
+	MarkTypeReachable(def->retType, sc);
+	BNS_VEC_FOREACH(def->argTypes) {
+		MarkTypeReachable(*ptr, sc);
+	}
+}
+
+void MarkFunctionReachable(FuncDef* def, Vector<int>* funcsToVisit, SemanticContext* sc) {
+	if (!def->isReachable) {
+		def->isReachable = true;
+		funcsToVisit->PushBack(def - sc->definedFunctions.data);
+
+		if (sc->options.lazySemantics) {
+			ResolveFunctionSignature(def, sc);
+		}
+	}
+}
+
+// Marks every struct named by a type, and every function called, within the subtree
+void MarkReachableInSubtree(ASTNode* node, Vector<int>* funcsToVisit, SemanticContext* sc) {
+	Vector<ASTIndex> toVisit;
+	toVisit.PushBack(node->GetIndex());
+	while (toVisit.count > 0) {
+		ASTNode* curr = &node->ast->nodes.data[toVisit.Back()];
+		toVisit.PopBack();
+
+		if (curr->type == ANT_TypeSimple) {
+			MarkTypeReachable(GetTypeIndex(curr, sc), sc);
+		}
+		else if (curr->type == ANT_FunctionCall) {
+			FuncDef* callee = GetResolvedFuncDef(curr, sc);
+			if (callee != nullptr) {
+				MarkFunctionReachable(callee, funcsToVisit, sc);
+			}
+		}
+
+		GetChildNodes(curr, &toVisit);
+	}
+}
+
+static void MarkRootsReachable(Vector<int>* funcsToVisit, SemanticContext* sc) {
+	BNS_VEC_FOREACH(sc->definedFunctions) {
+		ptr->isReachable = false;
+	}
+
+	BNS_VEC_FOREACH(sc->definedStructs) {
+		ptr->isReachable = false;
+	}
+
+	BNS_VEC_FOREACH(sc->options.rootFunctionNames) {
+		bool found = false;
+		BNS_VEC_FOREACH_NAME(sc->definedFunctions, defPtr) {
+			if (defPtr->name == *ptr) {
+				MarkFunctionReachable(defPtr, funcsToVisit, sc);
+				found = true;
+			}
+		}
+
+		if (!found) {
+			fprintf(sc->diagnosticsFile, "Warning: root function '%s' is not defined.\n", *ptr);
+		}
+	}
+}
+
+void MarkReachableDefinitions(AST* ast, SemanticContext* sc) {
+	Vector<int> funcsToVisit;
+	MarkRootsReachable(&funcsToVisit, sc);
+
+	// Globals are always emitted, so anything they reference is a root as well
+	ASTNode* root = &ast->nodes.Back();
+	BNS_VEC_FOREACH(root->Root_value.topLevelStatements) {
+		ASTNode* topStmt = &ast->nodes.data[*ptr];
+		if (topStmt->type == ANT_Statement) {
+			MarkReachableInSubtree(topStmt, &funcsToVisit, sc);
+		}
+	}
+
+	while (funcsToVisit.count > 0) {
+		FuncDef* def = &sc->definedFunctions.data[funcsToVisit.Back()];
+		funcsToVisit.PopBack();
+
+		MarkTypeReachable(def->retType, sc);
+		BNS_VEC_FOREACH(def->argTypes) {
+			MarkTypeReachable(*ptr, sc);
+		}
+
+		MarkReachableInSubtree(&ast->nodes.data[def->idx], &funcsToVisit, sc);
+	}
+}
+
+// Type-checks only what the roots and globals reach, in the order it's reached. Structs are
+// checked by MarkTypeReachable and signatures by MarkFunctionReachable, the bodies are checked here
+static void AnalyseReachableDefinitions(AST* ast, SemanticContext* sc, const Vector<ASTIndex>& globalVarDecls) {
+	Vector<int> funcsToVisit;
+	MarkRootsReachable(&funcsToVisit, sc);
+
+	BNS_VEC_FOREACH(globalVarDecls) {
+		ASTNode* stmt = &ast->nodes.data[*ptr];
+		MarkReachableInSubtree(stmt, &funcsToVisit, sc);
+		CheckGlobalVarDecl(stmt, sc);
+	}
+
+	while (funcsToVisit.count > 0) {
+		FuncDef* def = &sc->definedFunctions.data[funcsToVisit.Back()];
+		funcsToVisit.PopBack();
+
+		MarkReachableInSubtree(&ast->nodes.data[def->idx], &funcsToVisit, sc);
+		CheckFunctionDefinition(def, sc);
+	}
+}
+
+// The container holds one array per field, laid out like a struct with those arrays as its fields
+int GetSoALayout(const ArrayTypeInfo& arrInfo, SemanticContext* sc, int* outAlignment) {
+	TypeInfo* elemInfo = &sc->knownTypes.data[arrInfo.subType];
+	StructDef* def = &sc->definedStructs.data[elemInfo->AsStructTypeInfo().index];
+	if (!ComputeStructLayout(def, sc)) {
+		return -1;
+	}
+
+	int offset = 0;
+	int soaAlignment = 1;
+	BNS_VEC_FOREACH(def->fieldDecls) {
+		int size = GetTypeSize(ptr->typeIndex, sc);
+		int alignment = GetTypeAlignment(ptr->typeIndex, sc);
+		offset = (offset + alignment - 1) / alignment * alignment;
+		offset += size * arrInfo.arrayLen;
+		soaAlignment = BNS_MAX(soaAlignment, alignment);
+	}
+
+	if (outAlignment != nullptr) {
+		*outAlignment = soaAlignment;
+	}
+
+	return (offset + soaAlignment - 1) / soaAlignment * soaAlignment;
+}
+
+int GetTypeSize(TypeIndex typeIdx, SemanticContext* sc) {
+	if (typeIdx < 0) {
+		return -1;
+	}
+
+	TypeInfo* info = &sc->knownTypes.data[typeIdx];
+	switch (info->type) {
+	case TypeInfo::UE_BuiltinTypeInfo: {
+		return info->AsBuiltinTypeInfo().size;
+	} break;
+
+	case TypeInfo::UE_StructTypeInfo: {
+		StructDef* def = &sc->definedStructs.data[info->AsStructTypeInfo().index];
+		return ComputeStructLayout(def, sc) ? def->size : -1;
+	} break;
+
+	case TypeInfo::UE_PointerTypeInfo: {
+		return 8;
+	} break;
+
+	case TypeInfo::UE_ArrayTypeInfo: {
+		const ArrayTypeInfo& arrInfo = info->AsArrayTypeInfo();
+		if (arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+			// A slice: data pointer and int length, padded to the pointer's alignment
+			return 16;
+		}
+
+		if (arrInfo.isSoA) {
+			return GetSoALayout(arrInfo, sc, nullptr);
+		}
+
+		int elemSize = GetTypeSize(arrInfo.subType, sc);
+		return (elemSize < 0) ? -1 : elemSize * arrInfo.arrayLen;
+	} break;
+	}
+
+	return -1;
+}
+
+int GetTypeAlignment(TypeIndex typeIdx, SemanticContext* sc) {
+	if (typeIdx < 0) {
+		return -1;
+	}
+
+	TypeInfo* info = &sc->knownTypes.data[typeIdx];
+	switch (info->type) {
+	case TypeInfo::UE_BuiltinTypeInfo: {
+		return info->AsBuiltinTypeInfo().alignment;
+	} break;
+
+	case TypeInfo::UE_StructTypeInfo: {
+		StructDef* def = &sc->definedStructs.data[info->AsStructTypeInfo().index];
+		return ComputeStructLayout(def, sc) ? def->alignment : -1;
+	} break;
+
+	case TypeInfo::UE_PointerTypeInfo: {
+		return 8;
+	} break;
+
+	case TypeInfo::UE_ArrayTypeInfo: {
+		const ArrayTypeInfo& arrInfo = info->AsArrayTypeInfo();
+		if (arrInfo.arrayLen == ARRAY_DYNAMIC_LEN) {
+			return 8;
 		}
-		else if (ptr->type == TypeInfo::UE_StructTypeInfo && typeName == ((StructTypeInfo*)&ptr->StructTypeInfo_data)->name) {
-			return ptr - sc->knownTypes.data;
+		else if (arrInfo.isSoA) {
+			int alignment;
+			return (GetSoALayout(arrInfo, sc, &alignment) < 0) ? -1 : alignment;
 		}
+
+		return GetTypeAlignment(arrInfo.subType, sc);
+	} break;
 	}
 
 	return -1;
 }
 
-TypeIndex GetTypeOfField(StructDef* def, const SubString& name, SemanticContext* sc) {
+bool ComputeStructLayout(StructDef* def, SemanticContext* sc) {
+	if (def->isTypeCheckInProgress) {
+		// Only some of the fields are known yet, e.g. for 'b: int[size_of(S)];' inside S itself
+		fprintf(sc->diagnosticsFile, "Error: the layout of struct '%.*s' is needed to check its own fields.\n", BNS_LEN_START(def->name));
+		def->layoutState = LS_Error;
+		return false;
+	}
+	else if (def->layoutState == LS_Computed) {
+		return true;
+	}
+	else if (def->layoutState == LS_InProgress) {
+		fprintf(sc->diagnosticsFile, "Error: struct '%.*s' contains itself by value.\n", BNS_LEN_START(def->name));
+		def->layoutState = LS_Error;
+		return false;
+	}
+	else if (def->layoutState == LS_Error) {
+		return false;
+	}
+
+	def->layoutState = LS_InProgress;
+
+	// A size_of() in an earlier struct can ask for this layout before DoSemantics gets to it
+	if (!def->isTypeChecked && TypeCheckStructDef(def, sc, sc->ast) != TCR_Success) {
+		def->layoutState = LS_Error;
+		return false;
+	}
+
+	int fieldCount = def->fieldDecls.count;
+	Vector<int> fieldAlignments;
 	BNS_VEC_FOREACH(def->fieldDecls) {
-		if (ptr->name == name) {
-			return ptr->typeIndex;
+		int alignment = GetTypeAlignment(ptr->typeIndex, sc);
+		if (alignment <= 0) {
+			def->layoutState = LS_Error;
+			return false;
 		}
+
+		fieldAlignments.PushBack(alignment);
 	}
 
-	return -1;
-}
+	if (sc->options.reorderStructFields) {
+		// Stable insertion sort by decreasing alignment, since that leaves no interior padding
+		for (int i = 1; i < fieldCount; i++) {
+			VariableDecl decl = def->fieldDecls.data[i];
+			int alignment = fieldAlignments.data[i];
+			int j = i - 1;
+			while (j >= 0 && fieldAlignments.data[j] < alignment) {
+				def->fieldDecls.data[j + 1] = def->fieldDecls.data[j];
+				fieldAlignments.data[j + 1] = fieldAlignments.data[j];
+				j--;
+			}
 
-TypeIndex GetTypeofVariable(SubString name, SemanticContext* sc) {
-	BNS_VEC_FOREACH(sc->varsInScope) {
-		if (ptr->name == name) {
-			return ptr->typeIndex;
+			def->fieldDecls.data[j + 1] = decl;
+			fieldAlignments.data[j + 1] = alignment;
 		}
 	}
 
-	return -1;
+	int offset = 0;
+	int structAlignment = 1;
+	for (int i = 0; i < fieldCount; i++) {
+		int alignment = fieldAlignments.data[i];
+		int size = GetTypeSize(def->fieldDecls.data[i].typeIndex, sc);
+		if (size < 0) {
+			def->layoutState = LS_Error;
+			return false;
+		}
+
+		offset = (offset + alignment - 1) / alignment * alignment;
+		def->fieldDecls.data[i].offset = offset;
+		offset += size;
+
+		structAlignment = BNS_MAX(structAlignment, alignment);
+	}
+
+	def->size = (offset + structAlignment - 1) / structAlignment * structAlignment;
+	def->alignment = structAlignment;
+	def->layoutState = LS_Computed;
+
+	return true;
 }
 
-TypeIndex GetOrCreatePtrReferenceOf(TypeIndex subTypeIdx, SemanticContext* sc) {
-	BNS_VEC_FOREACH(sc->knownTypes) {
-		if (ptr->type == TypeInfo::UE_PointerTypeInfo) {
-			if (((PointerTypeInfo*)ptr->PointerTypeInfo_data)->subType == subTypeIdx) {
-				return (ptr - sc->knownTypes.data);
-			}
-		}
+bool IsLayoutIntrinsicCall(ASTNode* call) {
+	if (call->type != ANT_FunctionCall) {
+		return false;
 	}
 
-	PointerTypeInfo newInfo;
-	newInfo.subType = subTypeIdx;
-	TypeInfo info;
-	info = newInfo;
-	sc->knownTypes.PushBack(info);
-	return sc->knownTypes.count - 1;
+	const SubString& name = call->ast->nodes.data[call->FunctionCall_value.func].Identifier_value.name;
+	return name == "size_of" || name == "align_of" || name == "offset_of";
 }
 
-TypeIndex GetOrCreateArrayTypeOf(TypeIndex subTypeIdx, int len, SemanticContext* sc) {
-	BNS_VEC_FOREACH(sc->knownTypes) {
-		if (ptr->type == TypeInfo::UE_ArrayTypeInfo) {
-			if (((ArrayTypeInfo*)ptr->ArrayTypeInfo_data)->arrayLen == len &&
-				((ArrayTypeInfo*)ptr->ArrayTypeInfo_data)->subType == subTypeIdx) {
-				return (ptr - sc->knownTypes.data);
-			}
+static int EvaluateLayoutIntrinsicUncached(ASTNode* call, SemanticContext* sc);
+
+int EvaluateLayoutIntrinsic(ASTNode* call, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(call, sc);
+	if (info != nullptr && (info->flags & NIF_HasConstant)) {
+		return info->constantValue;
+	}
+
+	int val = EvaluateLayoutIntrinsicUncached(call, sc);
+	if (val >= 0) {
+		info = GetNodeInfo(call, sc);
+		if (info != nullptr) {
+			info->constantValue = val;
+			info->flags |= NIF_HasConstant;
 		}
 	}
 
-	ArrayTypeInfo newInfo;
-	newInfo.subType = subTypeIdx;
-	newInfo.arrayLen = len;
-	TypeInfo info;
-	info = newInfo;
-	sc->knownTypes.PushBack(info);
-	return sc->knownTypes.count - 1;
+	return val;
 }
 
-TypeIndex GetTypeIndex(ASTNode* typeNode, SemanticContext* sc) {
-	if (typeNode->type == ANT_TypeSimple) {
-		ASTNode* typeIdent = &typeNode->ast->nodes.data[typeNode->TypeSimple_value.name];
-		ASSERT(typeIdent->type == ANT_Identifier);
-		return GetSimpleTypeIndex(typeIdent->Identifier_value.name, sc);
+static int EvaluateLayoutIntrinsicUncached(ASTNode* call, SemanticContext* sc) {
+	ASSERT(IsLayoutIntrinsicCall(call));
+
+	const SubString& name = call->ast->nodes.data[call->FunctionCall_value.func].Identifier_value.name;
+	const Vector<ASTIndex>& args = call->FunctionCall_value.args;
+
+	int expectedArgs = (name == "offset_of") ? 2 : 1;
+	if (args.count != expectedArgs) {
+		return -1;
 	}
-	else if (typeNode->type == ANT_TypePointer) {
-		ASTIndex subIdx = typeNode->TypePointer_value.childType;
-		ASTNode* subNode = &typeNode->ast->nodes.data[subIdx];
-		TypeIndex subTypeIdx = GetTypeIndex(subNode, sc);
-		return GetOrCreatePtrReferenceOf(subTypeIdx, sc);
+
+	ASTNode* typeArg = &call->ast->nodes.data[args.data[0]];
+	if (typeArg->type != ANT_Identifier) {
+		return -1;
 	}
-	else if (typeNode->type == ANT_TypeArray) {
-		ASTIndex subIdx = typeNode->TypeArray_value.childType;
-		ASTNode* subNode = &typeNode->ast->nodes.data[subIdx];
 
-		int arrayLen = ARRAY_DYNAMIC_LEN;
+	TypeIndex typeIdx = GetSimpleTypeIndex(typeArg->Identifier_value.name, sc);
+	if (typeIdx < 0) {
+		return -1;
+	}
 
-		ASTIndex lenIdx = typeNode->TypeArray_value.length;
-		if (lenIdx != ARRAY_DYNAMIC_LEN) {
-			ASTNode* lenNode = &typeNode->ast->nodes.data[lenIdx];
+	if (name == "size_of") {
+		return GetTypeSize(typeIdx, sc);
+	}
+	else if (name == "align_of") {
+		return GetTypeAlignment(typeIdx, sc);
+	}
+	else {
+		ASTNode* fieldArg = &call->ast->nodes.data[args.data[1]];
+		if (fieldArg->type != ANT_Identifier || sc->knownTypes.data[typeIdx].type != TypeInfo::UE_StructTypeInfo) {
+			return -1;
+		}
 
-			BNCBytecodeValue val = CompileTimeInterpretASTExpression(lenNode, sc);
-			if (val.type != BNCBytecodeValue::UE_BNCByteCodeInt) {
-				ASSERT(false);
-				return -1;
-			}
-			else {
-				arrayLen = val.AsBNCByteCodeInt();
+		StructDef* def = &sc->definedStructs.data[sc->knownTypes.data[typeIdx].AsStructTypeInfo().index];
+		if (!ComputeStructLayout(def, sc)) {
+			return -1;
+		}
+
+		BNS_VEC_FOREACH(def->fieldDecls) {
+			if (ptr->name == fieldArg->Identifier_value.name) {
+				return ptr->offset;
 			}
 		}
 
-		TypeIndex subTypeIdx = GetTypeIndex(subNode, sc);
-		return GetOrCreateArrayTypeOf(subTypeIdx, arrayLen, sc);
-	}
-	else {
-		// TODO: Pointer, Array, Generic
-		ASSERT(false);
 		return -1;
 	}
 }
 
-void DoSemantics(AST* ast, SemanticContext* sc) {
-	ASTNode* root = &ast->nodes.Back();
+// Turns 'arr[i].x' into 'arr.x[i]' when arr is a soa array, returns whether it did so
+bool RewriteSoAFieldAccess(ASTNode* dotNode, SemanticContext* sc) {
+	AST* ast = dotNode->ast;
+	ASTNode* accessNode = &ast->nodes.data[dotNode->BinaryOp_value.left];
+	ASSERT(accessNode->type == ANT_ArrayAccess);
 
-	InitSemanticContextWithBuiltinTypes(sc);
+	ASTNode* arrNode = &ast->nodes.data[accessNode->ArrayAccess_value.arr];
+	TypeIndex arrType;
+	if (TypeCheckValue(arrNode, sc, &arrType) != TCR_Success) {
+		return false;
+	}
 
-	const Vector<ASTIndex>& topStmts = root->Root_value.topLevelStatements;
-	Vector<ASTIndex> globalVarDecls;
-	BNS_VEC_FOREACH(topStmts) {
-		ASTNode* topStmt = &ast->nodes.data[*ptr];
-		if (topStmt->type == ANT_FunctionDefinition) {
-			FuncDef def;
-			def.idx = *ptr;
-			ASTIndex funcNameIdx = ast->nodes.data[*ptr].FunctionDefinition_value.name;
-			def.name = ast->nodes.data[funcNameIdx].Identifier_value.name;
-			sc->definedFunctions.PushBack(def);
-		}
-		else if (topStmt->type == ANT_StructDefinition) {
-			StructDef def;
-			def.idx = *ptr;
-			sc->definedStructs.PushBack(def);
+	TypeInfo* arrInfo = &sc->knownTypes.data[arrType];
+	if (arrInfo->type != TypeInfo::UE_ArrayTypeInfo || !arrInfo->AsArrayTypeInfo().isSoA) {
+		return false;
+	}
+
+	AST_BinaryOp dotVal = dotNode->BinaryOp_value;
+	AST_ArrayAccess accessVal = accessNode->ArrayAccess_value;
+
+	accessNode->type = ANT_BinaryOp;
+	accessNode->BinaryOp_value.op = dotVal.op;
+	accessNode->BinaryOp_value.left = accessVal.arr;
+	accessNode->BinaryOp_value.right = dotVal.right;
+
+	dotNode->type = ANT_ArrayAccess;
+	dotNode->ArrayAccess_value.arr = accessNode->GetIndex();
+	dotNode->ArrayAccess_value.index = accessVal.index;
+
+	// Both nodes now mean something else, so nothing resolved for them still applies
+	NodeInfo* dotInfo = GetNodeInfo(dotNode, sc);
+	NodeInfo* accessInfo = GetNodeInfo(accessNode, sc);
+	if (dotInfo != nullptr) {
+		dotInfo->flags = 0;
+	}
+	if (accessInfo != nullptr) {
+		accessInfo->flags = 0;
+	}
+
+	return true;
+}
+
+static TypeCheckResult TypeCheckValueUncached(ASTNode* val, SemanticContext* sc, int* outTypeIdx);
+
+static bool HasCachedType(ASTNode* val, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(val, sc);
+	return info != nullptr && (info->flags & NIF_HasType);
+}
 
-			TypeInfo info;
-			StructTypeInfo str;
-			ASTIndex structNameIdx = ast->nodes.data[*ptr].StructDefinition_value.structName;
-			str.name = ast->nodes.data[structNameIdx].Identifier_value.name;
-			str.index = sc->definedStructs.count - 1;
-			info = str;
+// Chains of binary ops can be as long as the input, so the ops under 'val' are checked operands-first
+// with an explicit stack. Checking 'val' itself then finds its operands cached instead of recursing.
+// The right side of a '.' is a field name, so it's left alone like in TypeCheckValueUncached
+static TypeCheckResult TypeCheckBinaryOpOperands(ASTNode* val, SemanticContext* sc) {
+	ASTNode* valLeft  = &val->ast->nodes.data[val->BinaryOp_value.left];
+	ASTNode* valRight = &val->ast->nodes.data[val->BinaryOp_value.right];
+	if ((valLeft->type != ANT_BinaryOp || HasCachedType(valLeft, sc)) && (valRight->type != ANT_BinaryOp || HasCachedType(valRight, sc))) {
+		// Nothing deeper to check, the usual case once the operands have been visited
+		return TCR_Success;
+	}
 
-			sc->knownTypes.PushBack(info);
+	Vector<ASTIndex> chain;
+	Vector<ASTIndex> stack;
+	stack.PushBack(val->GetIndex());
+	while (stack.count > 0) {
+		ASTNode* binOp = &val->ast->nodes.data[stack.Back()];
+		stack.PopBack();
+		if (binOp != val) {
+			chain.PushBack(binOp->GetIndex());
 		}
-		else if (topStmt->type == ANT_Statement) {
-			ASTNode* stmt = &ast->nodes.data[topStmt->Statement_value.root];
-			if (stmt->type == ANT_VariableDecl) {
-				globalVarDecls.PushBack(stmt->GetIndex());
-			}
+
+		ASTNode* left  = &val->ast->nodes.data[binOp->BinaryOp_value.left];
+		ASTNode* right = &val->ast->nodes.data[binOp->BinaryOp_value.right];
+		if (left->type == ANT_BinaryOp && !HasCachedType(left, sc)) {
+			stack.PushBack(left->GetIndex());
+		}
+		if (right->type == ANT_BinaryOp && !HasCachedType(right, sc) && !StrEqual(binOp->BinaryOp_value.op, ".")) {
+			stack.PushBack(right->GetIndex());
 		}
 	}
 
-	BNS_VEC_FOREACH(sc->definedStructs) {
-		TypeCheckResult res = TypeCheckStructDef(ptr, sc, ast);
-		if (res != TCR_Success) {
-			printf("Failed to type-check struct.\n");
+	// Going backwards visits left operands before right ones, the same order as recursing would
+	for (int i = chain.count - 1; i >= 0; i--) {
+		int typeIdx;
+		if (TypeCheckValue(&val->ast->nodes.data[chain.data[i]], sc, &typeIdx) != TCR_Success) {
+			return TCR_Error;
 		}
-		else {
-			printf("Type checking worked!\n");
+	}
+
+	return TCR_Success;
+}
+
+TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeIdx) {
+	NodeInfo* info = GetNodeInfo(val, sc);
+	if (info != nullptr && (info->flags & NIF_HasType)) {
+		*outTypeIdx = info->type;
+		return TCR_Success;
+	}
+
+	// An operand failing means 'val' fails too
+	if (val->type == ANT_BinaryOp && TypeCheckBinaryOpOperands(val, sc) != TCR_Success) {
+		return TCR_Error;
+	}
+
+	TypeCheckResult res = TypeCheckValueUncached(val, sc, outTypeIdx);
+	if (res == TCR_Success) {
+		info = GetNodeInfo(val, sc);
+		if (info != nullptr) {
+			info->type = *outTypeIdx;
+			info->flags |= NIF_HasType;
 		}
 	}
 
-	BNS_VEC_FOREACH(globalVarDecls) {
-		ASTNode* stmt = &ast->nodes.data[*ptr];
-		ASSERT(stmt->type == ANT_VariableDecl);
+	return res;
+}
 
-		int typeIdx;
-		TypeCheckResult res = TypeCheckVarDecl(stmt, sc, &typeIdx);
-		if (res == TCR_Error) {
-			printf("Failed to typecheck var decl\n");
+static void SetNodeFlag(ASTNode* node, int flag, SemanticContext* sc) {
+	NodeInfo* info = GetNodeInfo(node, sc);
+	if (info != nullptr) {
+		info->flags |= flag;
+	}
+}
+
+// Whether a value of valType can be used where expectedType is, which is either the same type,
+// or a fixed-length array where a slice of the same element type is expected
+static bool CheckValueConversion(ASTNode* val, TypeIndex valType, TypeIndex expectedType, SemanticContext* sc) {
+	if (valType == expectedType) {
+		return true;
+	}
+	else if (valType < 0 || expectedType < 0) {
+		return false;
+	}
+
+	const TypeInfo& valInfo = sc->knownTypes.data[valType];
+	const TypeInfo& expectedInfo = sc->knownTypes.data[expectedType];
+	if (valInfo.type == TypeInfo::UE_ArrayTypeInfo && expectedInfo.type == TypeInfo::UE_ArrayTypeInfo) {
+		const ArrayTypeInfo& valArr = valInfo.AsArrayTypeInfo();
+		const ArrayTypeInfo& expectedArr = expectedInfo.AsArrayTypeInfo();
+		if (!valArr.isSoA && valArr.arrayLen != ARRAY_DYNAMIC_LEN
+			&& expectedArr.arrayLen == ARRAY_DYNAMIC_LEN && valArr.subType == expectedArr.subType) {
+			SetNodeFlag(val, NIF_ConvertsToSlice, sc);
+			return true;
 		}
 	}
 
-	BNS_VEC_FOREACH(sc->definedFunctions) {
-		TypeCheckResult res = TypeCheckFunctionDef(ptr, sc, ast);
-		if (res != TCR_Success) {
-			printf("Failed to type-check func def.\n");
+	return false;
+}
+
+// Only handles literals and arithmetic on them, which covers the indices worth proving in range
+static bool GetConstantIntValue(ASTNode* val, SemanticContext* sc, int* outValue) {
+	switch (val->type) {
+	case ANT_IntegerLiteral: {
+		*outValue = val->IntegerLiteral_value.val;
+		return true;
+	} break;
+
+	case ANT_Parentheses: {
+		return GetConstantIntValue(&val->ast->nodes.data[val->Parentheses_value.val], sc, outValue);
+	} break;
+
+	case ANT_FunctionCall: {
+		if (IsLayoutIntrinsicCall(val)) {
+			*outValue = EvaluateLayoutIntrinsic(val, sc);
+			return *outValue >= 0;
 		}
-		else {
-			printf("Type checking worked!\n");
+	} break;
+
+	case ANT_UnaryOp: {
+		int subValue;
+		if (StrEqual(val->UnaryOp_value.op, "-") && GetConstantIntValue(&val->ast->nodes.data[val->UnaryOp_value.val], sc, &subValue)) {
+			// Wraps like FoldIRInst does, rather than overflowing on INT_MIN
+			*outValue = (int)(0u - (unsigned)subValue);
+			return true;
+		}
+	} break;
+
+	case ANT_BinaryOp: {
+		const char* op = val->BinaryOp_value.op;
+		int left, right;
+		if (!GetConstantIntValue(&val->ast->nodes.data[val->BinaryOp_value.left], sc, &left)
+			|| !GetConstantIntValue(&val->ast->nodes.data[val->BinaryOp_value.right], sc, &right)) {
+			return false;
 		}
+
+		unsigned x = (unsigned)left, y = (unsigned)right;
+		if (StrEqual(op, "+")) { *outValue = (int)(x + y); return true; }
+		if (StrEqual(op, "-")) { *outValue = (int)(x - y); return true; }
+		if (StrEqual(op, "*")) { *outValue = (int)(x * y); return true; }
+		if (StrEqual(op, "/") && right != 0 && !(left == INT_MIN && right == -1)) { *outValue = left / right; return true; }
+	} break;
 	}
+
+	return false;
 }
 
-TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeIdx) {
+static TypeCheckResult TypeCheckValueUncached(ASTNode* val, SemanticContext* sc, int* outTypeIdx) {
 	switch (val->type) {
 	case ANT_BinaryOp: {
 		
 		ASTNode* left  = &val->ast->nodes.data[val->BinaryOp_value.left];
 		ASTNode* right = &val->ast->nodes.data[val->BinaryOp_value.right];
 		if (StrEqual(val->BinaryOp_value.op, ".")) {
+			if (left->type == ANT_ArrayAccess && RewriteSoAFieldAccess(val, sc)) {
+				return TypeCheckValue(val, sc, outTypeIdx);
+			}
+
 			int lType;
 			TypeCheckResult lRes = TypeCheckValue(left, sc, &lType);
 			if (lRes == TCR_Success) {
 				if (right->type == ANT_Identifier) {
 					const SubString& fieldName = right->Identifier_value.name;
 					TypeInfo* info = &sc->knownTypes.data[lType];
-					if (info->type == TypeInfo::UE_StructTypeInfo) {
+					if (info->type == TypeInfo::UE_ArrayTypeInfo && info->AsArrayTypeInfo().isSoA) {
+						// After RewriteSoAFieldAccess, 'arr.x' is the array holding every element's x
+						ArrayTypeInfo arrInfo = info->AsArrayTypeInfo();
+						StructDef* def = &sc->definedStructs.data[sc->knownTypes.data[arrInfo.subType].AsStructTypeInfo().index];
+						TypeIndex fieldType = GetTypeOfField(def, fieldName, sc);
+						if (fieldType >= 0) {
+							*outTypeIdx = GetOrCreateArrayTypeOf(fieldType, arrInfo.arrayLen, sc);
+							return TCR_Success;
+						}
+						else {
+							return TCR_Error;
+						}
+					}
+					else if (info->type == TypeInfo::UE_ArrayTypeInfo && fieldName == "length") {
+						*outTypeIdx = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("int"), sc);
+						return TCR_Success;
+					}
+					else if (info->type == TypeInfo::UE_StructTypeInfo) {
 						StructDef* def = &sc->definedStructs.data[((StructTypeInfo*)info->StructTypeInfo_data)->index];
 						TypeIndex fieldType = GetTypeOfField(def, fieldName, sc);
 						if (fieldType >= 0) {
@@ -251,7 +1825,30 @@ TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeId
 			TypeCheckResult lRes = TypeCheckValue(left, sc, &lType);
 			TypeCheckResult rRes = TypeCheckValue(right, sc, &rType);
 
-			if (lRes == TCR_Success && rRes == TCR_Success && lType == rType) {
+			if (lRes != TCR_Success || rRes != TCR_Success) {
+				return TCR_Error;
+			}
+
+			int lLanes = GetVectorLaneCount(lType, sc);
+			int rLanes = GetVectorLaneCount(rType, sc);
+			if (lLanes > 0 || rLanes > 0) {
+				// Vectors only support element-wise arithmetic, with scalars broadcast to every lane
+				const char* op = val->BinaryOp_value.op;
+				if (!StrEqual(op, "+") && !StrEqual(op, "-") && !StrEqual(op, "*") && !StrEqual(op, "/")) {
+					return TCR_Error;
+				}
+
+				TypeIndex vecType = (lLanes > 0) ? lType : rType;
+				TypeIndex otherType = (lLanes > 0) ? rType : lType;
+				if (otherType == vecType || otherType == sc->knownTypes.data[vecType].AsBuiltinTypeInfo().laneType) {
+					*outTypeIdx = vecType;
+					return TCR_Success;
+				}
+				else {
+					return TCR_Error;
+				}
+			}
+			else if (lType == rType) {
 				*outTypeIdx = lType;
 				return TCR_Success;
 			}
@@ -272,10 +1869,43 @@ TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeId
 		TypeCheckResult idxRes = TypeCheckValue(idxNode, sc, &idxTypeIdx);
 
 		if (arrRes == TCR_Success && idxRes == TCR_Success) {
-			if (sc->knownTypes.data[arrTypeIdx].type == TypeInfo::UE_ArrayTypeInfo) {
+			if (sc->knownTypes.data[arrTypeIdx].type == TypeInfo::UE_ArrayTypeInfo && sc->knownTypes.data[arrTypeIdx].AsArrayTypeInfo().isSoA) {
+				fprintf(sc->diagnosticsFile, "Error: elements of soa arrays can only be accessed one field at a time.\n");
+				return TCR_Error;
+			}
+			else if (GetVectorLaneCount(arrTypeIdx, sc) > 0) {
+				// Indexing a vector reads a single lane
+				if (idxTypeIdx == GetSimpleTypeIndex(STATIC_TO_SUBSTRING("int"), sc)) {
+					int laneCount = GetVectorLaneCount(arrTypeIdx, sc);
+					int constIndex;
+					if (GetConstantIntValue(idxNode, sc, &constIndex) && (constIndex < 0 || constIndex >= laneCount)) {
+						fprintf(sc->diagnosticsFile, "Error: lane %d is out of range for a vector of %d lanes.\n", constIndex, laneCount);
+						return TCR_Error;
+					}
+
+					*outTypeIdx = sc->knownTypes.data[arrTypeIdx].AsBuiltinTypeInfo().laneType;
+					return TCR_Success;
+				}
+				else {
+					return TCR_Error;
+				}
+			}
+			else if (sc->knownTypes.data[arrTypeIdx].type == TypeInfo::UE_ArrayTypeInfo) {
 				SubString intSubstr = STATIC_TO_SUBSTRING("int");
 				TypeIndex intTypeIdx = GetSimpleTypeIndex(intSubstr, sc);
 				if (idxTypeIdx == intTypeIdx) {
+					// Constant indices into fixed-length arrays are checked here rather than at runtime
+					int arrayLen = sc->knownTypes.data[arrTypeIdx].AsArrayTypeInfo().arrayLen;
+					int constIndex;
+					if (arrayLen != ARRAY_DYNAMIC_LEN && GetConstantIntValue(idxNode, sc, &constIndex)) {
+						if (constIndex < 0 || constIndex >= arrayLen) {
+							fprintf(sc->diagnosticsFile, "Error: index %d is out of range for an array of length %d.\n", constIndex, arrayLen);
+							return TCR_Error;
+						}
+
+						SetNodeFlag(val, NIF_IndexInBounds, sc);
+					}
+
 					*outTypeIdx = sc->knownTypes.data[arrTypeIdx].AsArrayTypeInfo().subType;
 					return TCR_Success;
 				}
@@ -296,12 +1926,44 @@ TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeId
 	case ANT_FunctionCall: {
 		ASTNode* funcVal = &val->ast->nodes.data[val->FunctionCall_value.func];
 		ASSERT(funcVal->type == ANT_Identifier);
+
+		if (IsLayoutIntrinsicCall(val)) {
+			if (EvaluateLayoutIntrinsic(val, sc) < 0) {
+				return TCR_Error;
+			}
+
+			*outTypeIdx = GetSimpleTypeIndex(STATIC_TO_SUBSTRING("int"), sc);
+			return TCR_Success;
+		}
+		else if (IsVectorConstructorCall(val, sc)) {
+			// e.g. float4(x, y, z, w), or float4(x) to set every lane to x
+			TypeIndex vecType = GetNamedTypeIndex(funcVal->Identifier_value.name, sc);
+			const BuiltinTypeInfo& vecInfo = sc->knownTypes.data[vecType].AsBuiltinTypeInfo();
+			int argCount = val->FunctionCall_value.args.count;
+			if (argCount != 1 && argCount != vecInfo.laneCount) {
+				return TCR_Error;
+			}
+
+			BNS_VEC_FOREACH(val->FunctionCall_value.args) {
+				int argTypeIdx;
+				TypeCheckResult res = TypeCheckValue(&val->ast->nodes.data[*ptr], sc, &argTypeIdx);
+				if (res != TCR_Success || argTypeIdx != vecInfo.laneType) {
+					return TCR_Error;
+				}
+			}
+
+			*outTypeIdx = vecType;
+			return TCR_Success;
+		}
+
 		FuncDef* def = GetFuncDefByName(funcVal->Identifier_value.name, sc);
 
 		if (def == nullptr) {
 			return TCR_Error;
 		}
 
+		RecordNodeSymbol(val, NSK_Function, def - sc->definedFunctions.data, sc);
+
 		if (val->FunctionCall_value.args.count != def->argTypes.count) {
 			// Arity mismatch
 			return TCR_Error;
@@ -316,7 +1978,7 @@ TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeId
 				return TCR_Error;
 			}
 
-			if (argTypeIdx != def->argTypes.data[i]) {
+			if (!CheckValueConversion(argNode, argTypeIdx, def->argTypes.data[i], sc)) {
 				return TCR_Error;
 			}
 		}
@@ -332,12 +1994,13 @@ TypeCheckResult TypeCheckValue(ASTNode* val, SemanticContext* sc, int* outTypeId
 	} break;
 
 	case ANT_Identifier: {
-		TypeIndex idx = GetTypeofVariable(val->Identifier_value.name, sc);
-		if (idx == -1) {
+		VariableDecl* decl = GetVariableByName(val->Identifier_value.name, sc);
+		if (decl == nullptr) {
 			return TCR_Error;
 		}
 
-		*outTypeIdx = idx;
+		RecordNodeSymbol(val, NSK_Variable, decl->idx, sc);
+		*outTypeIdx = decl->typeIndex;
 		return TCR_Success;
 	} break;
 
@@ -415,6 +2078,7 @@ TypeCheckResult TypeCheckVarDecl(ASTNode* decl, SemanticContext* sc, int* outTyp
 			vardecl.idx = decl - decl->ast->nodes.data;
 			vardecl.name = decl->ast->nodes.data[decl->VariableDecl_value.varName].Identifier_value.name;
 			vardecl.typeIndex = varTypeIdx;
+			vardecl.offset = 0;
 			sc->varsInScope.PushBack(vardecl);
 		}
 		return TCR_Success;
@@ -426,7 +2090,7 @@ TypeCheckResult TypeCheckVarDecl(ASTNode* decl, SemanticContext* sc, int* outTyp
 	if (vRes == TCR_Error) {
 		return TCR_Error;
 	}
-	else if (varTypeIdx == valTypeIdx) {
+	else if (CheckValueConversion(val, valTypeIdx, varTypeIdx, sc)) {
 		*outTypeIdx = varTypeIdx;
 
 		if (addToScope) {
@@ -434,6 +2098,7 @@ TypeCheckResult TypeCheckVarDecl(ASTNode* decl, SemanticContext* sc, int* outTyp
 			vardecl.idx = decl - decl->ast->nodes.data;
 			vardecl.name = decl->ast->nodes.data[decl->VariableDecl_value.varName].Identifier_value.name;
 			vardecl.typeIndex = varTypeIdx;
+			vardecl.offset = 0;
 			sc->varsInScope.PushBack(vardecl);
 		}
 
@@ -444,19 +2109,55 @@ TypeCheckResult TypeCheckVarDecl(ASTNode* decl, SemanticContext* sc, int* outTyp
 	}
 }
 
+// A generic's fields are only resolved per instance, so this just checks the parameters are
+// all types, and that no field has an initial value whose type would depend on them
+static TypeCheckResult TypeCheckGenericStructDef(StructDef* def, SemanticContext* sc, AST* ast) {
+	ASTNode* defNode = &ast->nodes.data[def->idx];
+	BNS_VEC_FOREACH(defNode->StructDefinition_value.genericParams) {
+		ASTNode* paramNode = &ast->nodes.data[*ptr];
+		ASTNode* typeNode = &ast->nodes.data[paramNode->VariableDecl_value.type];
+		ASTNode* typeName = (typeNode->type == ANT_TypeSimple) ? &ast->nodes.data[typeNode->TypeSimple_value.name] : nullptr;
+		if (typeName == nullptr || typeName->type != ANT_Identifier || !(typeName->Identifier_value.name == "Type")
+			|| paramNode->VariableDecl_value.initValue >= 0) {
+			fprintf(sc->diagnosticsFile, "Error: parameters of generic struct '%.*s' must be declared as 'name : Type'.\n",
+				BNS_LEN_START(def->name));
+			def->layoutState = LS_Error;
+			return TCR_Error;
+		}
+	}
+
+	BNS_VEC_FOREACH(defNode->StructDefinition_value.fieldDecls) {
+		if (ast->nodes.data[*ptr].VariableDecl_value.initValue >= 0) {
+			fprintf(sc->diagnosticsFile, "Error: fields of generic struct '%.*s' can't have initial values.\n",
+				BNS_LEN_START(def->name));
+			def->layoutState = LS_Error;
+			return TCR_Error;
+		}
+	}
+
+	return TCR_Success;
+}
+
 TypeCheckResult TypeCheckStructDef(StructDef* def, SemanticContext* sc, AST* ast) {
 	//PUSH_SC_SCOPE(sc);
 
 	ASTNode* defNode = &ast->nodes.data[def->idx];
 	ASTNode* nameNode = &ast->nodes.data[defNode->StructDefinition_value.structName];
 	def->name = nameNode->Identifier_value.name;
+	def->isTypeChecked = true;
+
+	if (def->isGeneric) {
+		return TypeCheckGenericStructDef(def, sc, ast);
+	}
 
 	TypeCheckResult res = TCR_NoProgress;
 	bool anyFieldsInProgress = false;
-	
+
+	def->isTypeCheckInProgress = true;
+	FoldArrayLengths(defNode, sc);
 	BNS_VEC_FOREACH(defNode->StructDefinition_value.fieldDecls) {
 		ASTNode* fieldNode = &ast->nodes.data[*ptr];
-		int fieldTypeIdx;
+		int fieldTypeIdx = -1;
 		TypeCheckResult fres = TypeCheckVarDecl(fieldNode, sc, &fieldTypeIdx, false);
 
 		VariableDecl decl;
@@ -464,12 +2165,15 @@ TypeCheckResult TypeCheckStructDef(StructDef* def, SemanticContext* sc, AST* ast
 		ASTIndex fieldNameIdx = fieldNode->VariableDecl_value.varName;
 		decl.name = ast->nodes.data[fieldNameIdx].Identifier_value.name;
 		decl.typeIndex = fieldTypeIdx;
+		decl.offset = 0;
 		def->fieldDecls.PushBack(decl);
 
 		if (fres == TCR_Error) {
+			def->isTypeCheckInProgress = false;
 			return TCR_Error;
 		}
 	}
+	def->isTypeCheckInProgress = false;
 
 	return TCR_Success;
 }
@@ -486,6 +2190,9 @@ TypeCheckResult TypeCheckFunctionDef(FuncDef* def, SemanticContext* sc, AST* ast
 		return TCR_Error;
 	}
 
+	// The signature may already have been resolved for a caller
+	def->argTypes.Clear();
+
 	BNS_VEC_FOREACH(defNode->FunctionDefinition_value.params) {
 		int paramTypeIdx;
 		TypeCheckResult paramRes = TypeCheckVarDecl(&ast->nodes.data[*ptr], sc, &paramTypeIdx);
@@ -522,7 +2229,7 @@ TypeCheckResult DoTypeChecking(ASTNode* node, SemanticContext* sc, FuncDef* curr
 		TypeCheckResult varRes = TypeCheckValue(var, sc, &varType);
 		TypeCheckResult valRes = TypeCheckValue(val, sc, &valType);
 
-		if (varRes == TCR_Success && valRes == TCR_Success && varType == valType) {
+		if (varRes == TCR_Success && valRes == TCR_Success && CheckValueConversion(val, valType, varType, sc)) {
 			return TCR_Success;
 		}
 		else {
@@ -558,7 +2265,7 @@ TypeCheckResult DoTypeChecking(ASTNode* node, SemanticContext* sc, FuncDef* curr
 		int retType;
 		TypeCheckResult res = TypeCheckValue(val, sc, &retType);
 
-		if (res == TCR_Success && retType == currFun->retType){
+		if (res == TCR_Success && CheckValueConversion(val, retType, currFun->retType, sc)){
 			return TCR_Success;
 		}
 		else {
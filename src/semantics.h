@@ -7,6 +7,8 @@
 #include "../CppUtils/disc_union.h"
 
 #include "AST.h"
+#include "bytecode.h"
+#include "jit.h"
 
 enum TypeCheckResult {
 	TCR_NoProgress,
@@ -24,6 +26,11 @@ enum TypeInfoKind {
 
 struct BuiltinTypeInfo {
 	const char* name;
+	int size;
+	int alignment;
+	// Fixed-width SIMD vectors (e.g. float4) have laneCount > 0, and laneType is the element type
+	int laneCount;
+	int laneType;
 };
 
 struct StructTypeInfo {
@@ -38,6 +45,8 @@ struct PointerTypeInfo {
 struct ArrayTypeInfo {
 	int subType;
 	int arrayLen;
+	// Struct-of-arrays: subType is a struct, and each of its fields is stored as its own array
+	bool isSoA;
 };
 
 #define DISC_LIST(mac)   \
@@ -55,6 +64,17 @@ struct VariableDecl {
 	TypeIndex typeIndex;
 	SubString name;
 	ASTIndex idx;
+	// Byte offset within the enclosing struct, only valid for struct fields
+	int offset;
+};
+
+enum FunctionPurity {
+	// May write memory its caller can see
+	FP_Impure,
+	// Only reads memory, so calls with the same arguments and the same memory give the same result
+	FP_Pure,
+	// Depends on nothing but the values of its arguments
+	FP_Const
 };
 
 struct FuncDef {
@@ -62,22 +82,204 @@ struct FuncDef {
 	SubString name;
 	TypeIndex retType;
 	Vector<TypeIndex> argTypes;
+
+	// Indices into SemanticContext::definedFunctions, filled in by BuildCallGraph
+	Vector<int> calledFuncs;
+	// Number of AST nodes in the body, used as a size heuristic by the backend
+	int bodySize;
+	// Filled in by InferFunctionPurity, which also accounts for everything the function calls
+	FunctionPurity purity;
+
+	bool shouldInline;
+	// Set by BuildCallGraph for functions that can end up calling themselves
+	bool isRecursive;
+	bool isReachable;
+	// Set by the backend for functions returning a large struct, which is written to a bnc_ret out-pointer
+	bool returnsThroughPointer;
+};
+
+enum LayoutState {
+	LS_NotComputed,
+	LS_InProgress,
+	LS_Computed,
+	LS_Error
 };
 
 struct StructDef {
 	ASTIndex idx;
 	SubString name;
 	Vector<VariableDecl> fieldDecls;
+
+	bool isTypeChecked;
+	// Set while the fields are being checked, when fieldDecls only holds the ones checked so far
+	bool isTypeCheckInProgress;
+	bool isReachable;
+
+	// Generic structs are only templates, each distinct argument list gets its own instance.
+	// Templates have no layout, so LS_Error on one means its parameters are invalid
+	bool isGeneric;
+	// For instances, the generic struct's index in SemanticContext::definedStructs, otherwise -1
+	int genericIndex;
+	Vector<TypeIndex> genericArgs;
+
+	LayoutState layoutState;
+	int size;
+	int alignment;
+};
+
+// A slot in SemanticContext::genericInstances, keyed on the generic and its argument list
+struct GenericInstanceEntry {
+	unsigned int hash;
+	// Index of the instance in SemanticContext::definedStructs, -1 for an empty slot
+	int structIndex;
+	TypeIndex typeIndex;
 };
 
+// Types are interned for the whole program, so knownTypes isn't part of a scope:
+// a pointer type first seen inside a function may still be referenced by its signature.
 struct ScopeStackFrame {
-	int knownTypesCount;
 	int varsInScopeCount;
 	int definedFunctionsCount;
 	int definedStructsCount;
 };
 
+struct CompilerOptions {
+	// Emit small, non-recursive functions as static inline, ahead of their callers
+	bool inlineSmallFunctions;
+	int inlineMaxNodes;
+
+	// Only emit functions and structs reachable from rootFunctionNames and global variables
+	bool eliminateDeadCode;
+	Vector<const char*> rootFunctionNames;
+
+	// Only type-check the functions and structs reachable from rootFunctionNames and globals,
+	// leaving out the rest of the output like eliminateDeadCode does
+	bool lazySemantics;
+
+	// Sort struct fields by decreasing alignment to minimise padding
+	bool reorderStructFields;
+
+	// Check array and slice indices at runtime, except where semantics proved them in range
+	bool boundsChecks;
+
+	// Pass unmodified struct parameters larger than structByValueMaxSize as const pointers,
+	// and return such structs through an out-pointer
+	bool passLargeStructsByPointer;
+	int structByValueMaxSize;
+
+	// Qualify pointer parameters restrict where every call passes them memory no other argument
+	// reaches. Functions in rootFunctionNames may be called from anywhere, so theirs never are
+	bool restrictPointerParams;
+
+	// Mark prototypes of functions semantics found to be side-effect free with pure/const attributes
+	bool emitPurityAttributes;
+
+	// Lower scalar function bodies and compile-time expressions through the optimised SSA IR in ir.h,
+	// falling back to the AST for anything it doesn't cover
+	bool lowerThroughSSA;
+
+	// Run compile-time expressions as native code where the platform supports it
+	bool jitCompileTimeCode;
+
+	// Run the peephole pass over bytecode before executing it
+	bool optimizeBytecode;
+
+	// Run compile-time expressions through the instrumented interpreter and report afterwards
+	bool profileBytecode;
+
+	// When non-zero, write the C to a header and this many .c files named after outputPathPrefix
+	int outputShardCount;
+	const char* outputPathPrefix;
+
+	// Set by ParseCompilerOption when it rejected an option's operand, after reporting it
+	bool hasInvalidOperand;
+
+	CompilerOptions() {
+		inlineSmallFunctions = false;
+		inlineMaxNodes = 16;
+		eliminateDeadCode = false;
+		lazySemantics = false;
+		reorderStructFields = false;
+		boundsChecks = false;
+		passLargeStructsByPointer = false;
+		structByValueMaxSize = 16;
+		restrictPointerParams = false;
+		emitPurityAttributes = false;
+		lowerThroughSSA = false;
+		jitCompileTimeCode = false;
+		optimizeBytecode = false;
+		profileBytecode = false;
+		outputShardCount = 0;
+		outputPathPrefix = "out";
+		hasInvalidOperand = false;
+	}
+};
+
+// Consumes the option at args[*index] (and its operand, if any), advancing *index past it.
+// Returns false if args[*index] isn't a compiler option. A bad operand is reported and leaves
+// options->hasInvalidOperand set, the option keeping its previous value
+bool ParseCompilerOption(const char* const* args, int argCount, int* index, CompilerOptions* options);
+
+enum NodeInfoFlags {
+	NIF_HasType     = 1 << 0,
+	NIF_HasSymbol   = 1 << 1,
+	NIF_HasConstant = 1 << 2,
+	// A fixed-length array passed or assigned where a slice (T[]) is expected
+	NIF_ConvertsToSlice = 1 << 3,
+	// An array access whose index is known to be in range, so it needs no bounds check
+	NIF_IndexInBounds = 1 << 4,
+	// A struct parameter declaration the backend passes as a const pointer
+	NIF_PassedByPointer = 1 << 5,
+	// A return statement in a function that returns through its bnc_ret out-pointer
+	NIF_ReturnsThroughPointer = 1 << 6,
+	// A pointer parameter declaration the backend emits restrict-qualified
+	NIF_RestrictPointer = 1 << 7,
+	// A compile-time expression that has been evaluated and didn't give a usable value
+	NIF_NotConstant = 1 << 8
+};
+
+enum NodeSymbolKind {
+	NSK_None,
+	// symbolIndex is the ASTIndex of the variable's declaration
+	NSK_Variable,
+	// symbolIndex is an index into SemanticContext::definedFunctions
+	NSK_Function
+};
+
+// What semantics resolved for one AST node, so later passes don't derive it again
+struct NodeInfo {
+	TypeIndex type;
+	NodeSymbolKind symbolKind;
+	int symbolIndex;
+	// Value of a compile-time constant such as size_of(T)
+	int constantValue;
+	int flags;
+};
+
+// Thread safety: all compiler and VM state lives in explicit objects (AST, SemanticContext,
+// BNCBytecodeVMState, BNCFormula), and the global operator and keyword tables are const.
+// Separate threads may parse, check, emit and evaluate different programs concurrently
+// as long as each uses its own AST and SemanticContext. A single context must not be
+// shared between threads. A compiled BNCFormula is read-only during evaluation, so one
+// formula can be evaluated from several threads, each with its own BNCBytecodeVMState.
 struct SemanticContext {
+	CompilerOptions options;
+
+	AST* ast;
+
+	// Where errors and progress messages go, so concurrent compiles can keep theirs apart
+	FILE* diagnosticsFile;
+
+	BNCBytecodeProfile bytecodeProfile;
+
+	BNCBytecodeVMPool vmPool;
+
+	// Only filled in with -jit
+	BNCJitCache jitCache;
+
+	// Identifiers that compile to BNCBI_LoadInput, by index, when compiling host formulas
+	Vector<const char*> bytecodeInputNames;
+
 	Vector<TypeInfo> knownTypes;
 	Vector<VariableDecl> varsInScope;
 	Vector<FuncDef> definedFunctions;
@@ -85,9 +287,25 @@ struct SemanticContext {
 
 	Vector<ScopeStackFrame> scopeFrames;
 
+	// Open-addressed, so each instantiation is found in constant time however often it's named
+	Vector<GenericInstanceEntry> genericInstances;
+	int genericInstanceCount;
+
+	// One entry per AST node, indexed by ASTIndex and filled in as semantics resolves nodes
+	Vector<NodeInfo> nodeInfo;
+
+	// Set once a vector type is named or constructed, so the backend only emits their typedefs then
+	bool usesVectorTypes;
+
+	SemanticContext() {
+		ast = nullptr;
+		diagnosticsFile = stdout;
+		genericInstanceCount = 0;
+		usesVectorTypes = false;
+	}
+
 	void PushScope() {
 		ScopeStackFrame frame;
-		frame.knownTypesCount       = knownTypes.count;
 		frame.varsInScopeCount      = varsInScope.count;
 		frame.definedFunctionsCount = definedFunctions.count;
 		frame.definedStructsCount   = definedStructs.count;
@@ -99,7 +317,6 @@ struct SemanticContext {
 		ScopeStackFrame frame = scopeFrames.Back();
 		scopeFrames.PopBack();
 #define REMOVE_FROM(field) field . RemoveRange(frame. field ## Count , field .count)
-		REMOVE_FROM(knownTypes);
 		REMOVE_FROM(varsInScope);
 		REMOVE_FROM(definedFunctions);
 		REMOVE_FROM(definedStructs);
@@ -107,6 +324,12 @@ struct SemanticContext {
 	}
 };
 
+// Returns nullptr for nodes outside the table, e.g. when no semantics pass has run
+NodeInfo* GetNodeInfo(ASTNode* node, SemanticContext* sc);
+
+// The function a call or definition node resolved to, looked up by name if it hasn't been resolved
+FuncDef* GetResolvedFuncDef(ASTNode* node, SemanticContext* sc);
+
 struct __PushPopSCScope {
 	SemanticContext* sc;
 
@@ -124,5 +347,33 @@ struct __PushPopSCScope {
 
 void DoSemantics(AST* ast, SemanticContext* sc);
 
+void BuildCallGraph(AST* ast, SemanticContext* sc);
+
+void InferFunctionPurity(AST* ast, SemanticContext* sc);
+
+enum DeclKind {
+	DK_Local,
+	DK_Global,
+	DK_Param
+};
+
+// Fills outKinds with a DeclKind for every AST node, telling where each variable declaration lives
+void GetDeclKinds(AST* ast, Vector<unsigned char>* outKinds);
+
+void MarkReachableDefinitions(AST* ast, SemanticContext* sc);
+
+// Sizes and alignments match a 64-bit target, and are -1 if they can't be determined
+int GetTypeSize(TypeIndex typeIdx, SemanticContext* sc);
+int GetTypeAlignment(TypeIndex typeIdx, SemanticContext* sc);
+bool ComputeStructLayout(StructDef* def, SemanticContext* sc);
+
+// size_of(T), align_of(T) and offset_of(T, field), which evaluate to int constants
+bool IsLayoutIntrinsicCall(ASTNode* call);
+int EvaluateLayoutIntrinsic(ASTNode* call, SemanticContext* sc);
+
+// Returns the lane count of a builtin vector type, or 0 for any other type
+int GetVectorLaneCount(TypeIndex typeIdx, SemanticContext* sc);
+bool IsVectorConstructorCall(ASTNode* call, SemanticContext* sc);
+
 
 #endif
@@ -0,0 +1,507 @@
+#include "server.h"
+
+#if BNC_SERVER_SUPPORTED
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Requests are a single line: the file path followed by its compiler options, separated by tabs.
+// The response is a status line, then the compile output, after which the server closes the connection.
+#define BNC_SERVER_QUIT_REQUEST "!quit"
+#define BNC_SERVER_STATUS_OK "ok\n"
+#define BNC_SERVER_STATUS_FAILED "failed\n"
+
+// Requests are served one at a time, so a client that stalls can only hold the others up this long
+#define BNC_SERVER_CLIENT_TIMEOUT_SECONDS 5
+
+static unsigned long long HashFileContents(const Vector<char>& contents) {
+	// FNV-1a
+	unsigned long long hash = 14695981039346656037ULL;
+	for (int i = 0; i < contents.count; i++) {
+		hash ^= (unsigned char)contents.data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static bool ReadFileContents(const char* fileName, Vector<char>* outContents) {
+	FILE* file = fopen(fileName, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+
+	char buffer[4096];
+	size_t readCount;
+	while ((readCount = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		for (size_t i = 0; i < readCount; i++) {
+			outContents->PushBack(buffer[i]);
+		}
+	}
+
+	fclose(file);
+	outContents->PushBack('\0');
+	return true;
+}
+
+static long long GetFileModifiedTime(const struct stat& fileStat) {
+#if defined(__linux__)
+	return (long long)fileStat.st_mtim.tv_sec * 1000000000LL + fileStat.st_mtim.tv_nsec;
+#else
+	return (long long)fileStat.st_mtime;
+#endif
+}
+
+static void SetEntryOutput(BNCServerCacheEntry* entry, const char* text, size_t length) {
+	entry->output.Clear();
+	for (size_t i = 0; i < length; i++) {
+		entry->output.PushBack(text[i]);
+	}
+}
+
+static BNCServerCacheEntry* CreateCacheEntry(const char* requestLine, int requestLen) {
+	BNCServerCacheEntry* entry = new BNCServerCacheEntry();
+	entry->modifiedTime = -1;
+	entry->contentHash = 0;
+	entry->failed = false;
+
+	for (int i = 0; i < requestLen; i++) {
+		entry->request.PushBack(requestLine[i]);
+	}
+	entry->request.PushBack('\0');
+
+	// Split on tabs in place, the options point into the request from now on
+	entry->args.PushBack(entry->request.data);
+	for (int i = 0; i < requestLen; i++) {
+		if (entry->request.data[i] == '\t') {
+			entry->request.data[i] = '\0';
+			entry->args.PushBack(&entry->request.data[i + 1]);
+		}
+	}
+
+	for (int i = 1; i < entry->args.count; i++) {
+		ParseCompilerOption(entry->args.data, entry->args.count, &i, &entry->options);
+	}
+
+	return entry;
+}
+
+static void CompileSource(const CompilerOptions& options, const Vector<char>& contents, FILE* outputFile) {
+	// Shards are files written relative to the compiler's working directory, and cached output couldn't recreate them
+	if (options.outputShardCount > 0) {
+		fprintf(outputFile, "Error: -shards isn't supported by the compile server, run the compiler directly.\n");
+		return;
+	}
+
+	// The AST's identifiers point into source, so both only live as long as the compile
+	String source = contents.data;
+	AST ast;
+	ast.ConstructFromString(source);
+
+	SemanticContext sc;
+	sc.options = options;
+	sc.diagnosticsFile = outputFile;
+
+	FixUpOperators(&ast.nodes.Back());
+	DoSemantics(&ast, &sc);
+
+	fprintf(outputFile, "==============\n");
+	OutputASTToCCode(&ast.nodes.Back(), &sc, outputFile);
+	fprintf(outputFile, "==============\n");
+
+	if (sc.options.profileBytecode) {
+		PrintBytecodeProfile(&sc.bytecodeProfile, outputFile);
+	}
+}
+
+// Compiles in a child process, so an assert or crash on a malformed file only fails that
+// request instead of taking the server and everyone's cached output down with it
+static void CompileCacheEntry(BNCServerCacheEntry* entry, const Vector<char>& contents) {
+	const char* fileName = entry->args.data[0];
+	entry->output.Clear();
+	entry->failed = false;
+
+	int fds[2];
+	if (pipe(fds) != 0) {
+		const char* message = "Error: could not start the compiler.\n";
+		SetEntryOutput(entry, message, strlen(message));
+		entry->failed = true;
+		return;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		const char* message = "Error: could not start the compiler.\n";
+		SetEntryOutput(entry, message, strlen(message));
+		entry->failed = true;
+		return;
+	}
+	else if (pid == 0) {
+		close(fds[0]);
+		FILE* outputFile = fdopen(fds[1], "w");
+		CompileSource(entry->options, contents, outputFile);
+		fclose(outputFile);
+		_exit(0);
+	}
+
+	close(fds[1]);
+
+	char buffer[4096];
+	while (true) {
+		ssize_t readCount = read(fds[0], buffer, sizeof(buffer));
+		if (readCount < 0 && errno == EINTR) {
+			continue;
+		}
+		else if (readCount <= 0) {
+			break;
+		}
+
+		for (ssize_t i = 0; i < readCount; i++) {
+			entry->output.PushBack(buffer[i]);
+		}
+	}
+	close(fds[0]);
+
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+	}
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		char message[PATH_MAX + 64];
+		int messageLen = snprintf(message, sizeof(message), "Error: the compiler crashed on '%s'.\n", fileName);
+		for (int i = 0; i < messageLen && i < (int)sizeof(message) - 1; i++) {
+			entry->output.PushBack(message[i]);
+		}
+		entry->failed = true;
+	}
+}
+
+BNCCompileServer::~BNCCompileServer() {
+	BNS_VEC_FOREACH(cache) {
+		delete *ptr;
+	}
+}
+
+static void SetReadError(BNCServerCacheEntry* entry) {
+	char message[PATH_MAX + 64];
+	int messageLen = snprintf(message, sizeof(message), "Error: could not read file '%s'.\n", entry->args.data[0]);
+	SetEntryOutput(entry, message, messageLen);
+	entry->modifiedTime = -1;
+	entry->failed = true;
+}
+
+const BNCServerCacheEntry* BNCCompileServer::HandleRequest(const char* requestLine, int requestLen) {
+	int entryIndex = -1;
+	for (int i = 0; i < cache.count; i++) {
+		const Vector<char>& request = cache.data[i]->request;
+		if (request.count == requestLen + 1) {
+			bool matches = true;
+			for (int j = 0; j < requestLen; j++) {
+				// The cached copy has its tabs replaced by null terminators
+				char cachedChar = (request.data[j] == '\0') ? '\t' : request.data[j];
+				if (cachedChar != requestLine[j]) {
+					matches = false;
+					break;
+				}
+			}
+
+			if (matches) {
+				entryIndex = i;
+				break;
+			}
+		}
+	}
+
+	if (entryIndex < 0) {
+		cache.PushBack(CreateCacheEntry(requestLine, requestLen));
+		entryIndex = cache.count - 1;
+	}
+
+	BNCServerCacheEntry* entry = cache.data[entryIndex];
+	const char* fileName = entry->args.data[0];
+
+	// Clients check their options before sending them, this only catches requests written by hand
+	if (entry->options.hasInvalidOperand) {
+		const char* message = "Error: the request has an invalid option operand.\n";
+		SetEntryOutput(entry, message, strlen(message));
+		entry->failed = true;
+		return entry;
+	}
+
+	// An unchanged file is answered from its stat alone, without reading it
+	struct stat fileStat;
+	if (stat(fileName, &fileStat) != 0) {
+		SetReadError(entry);
+		return entry;
+	}
+
+	long long modifiedTime = GetFileModifiedTime(fileStat);
+	if (entry->modifiedTime == modifiedTime) {
+		return entry;
+	}
+
+	Vector<char> contents;
+	if (!ReadFileContents(fileName, &contents)) {
+		SetReadError(entry);
+		return entry;
+	}
+
+	// A touched but unchanged file keeps its cached output
+	unsigned long long contentHash = HashFileContents(contents);
+	if (entry->modifiedTime >= 0 && entry->contentHash == contentHash) {
+		entry->modifiedTime = modifiedTime;
+		return entry;
+	}
+
+	entry->modifiedTime = modifiedTime;
+	entry->contentHash = contentHash;
+	CompileCacheEntry(entry, contents);
+	return entry;
+}
+
+static bool WriteAll(int fd, const char* data, int length) {
+	while (length > 0) {
+		ssize_t written = write(fd, data, length);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return false;
+		}
+
+		data += written;
+		length -= (int)written;
+	}
+
+	return true;
+}
+
+static bool FillSocketAddress(const char* socketPath, struct sockaddr_un* outAddr) {
+	MemSet(outAddr, 0, sizeof(*outAddr));
+	outAddr->sun_family = AF_UNIX;
+
+	if (strlen(socketPath) >= sizeof(outAddr->sun_path)) {
+		printf("Error: socket path '%s' is too long.\n", socketPath);
+		return false;
+	}
+
+	strcpy(outAddr->sun_path, socketPath);
+	return true;
+}
+
+int RunCompileServer(const char* socketPath) {
+	struct sockaddr_un addr;
+	if (!FillSocketAddress(socketPath, &addr)) {
+		return 1;
+	}
+
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0) {
+		printf("Error: could not create socket.\n");
+		return 1;
+	}
+
+	unlink(socketPath);
+	if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 16) != 0) {
+		printf("Error: could not listen on '%s'.\n", socketPath);
+		close(listenFd);
+		return 1;
+	}
+
+	// A client that hangs up before reading its output shouldn't kill the server
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Compile server listening on '%s'.\n", socketPath);
+	fflush(stdout);
+
+	BNCCompileServer server;
+	while (true) {
+		int clientFd = accept(listenFd, nullptr, nullptr);
+		if (clientFd < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			break;
+		}
+
+		struct timeval timeout;
+		timeout.tv_sec = BNC_SERVER_CLIENT_TIMEOUT_SECONDS;
+		timeout.tv_usec = 0;
+		setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		// Clients send a single line and then shut down their end, so nothing after the newline is lost
+		Vector<char> request;
+		char buffer[4096];
+		bool lineEnded = false;
+		bool readFailed = false;
+		while (!lineEnded) {
+			ssize_t readCount = read(clientFd, buffer, sizeof(buffer));
+			if (readCount < 0 && errno == EINTR) {
+				continue;
+			}
+			else if (readCount < 0) {
+				// Including the timeout running out, the client gets dropped
+				readFailed = true;
+				break;
+			}
+			else if (readCount == 0) {
+				break;
+			}
+
+			for (ssize_t i = 0; i < readCount && !lineEnded; i++) {
+				if (buffer[i] == '\n') {
+					lineEnded = true;
+				}
+				else {
+					request.PushBack(buffer[i]);
+				}
+			}
+		}
+
+		bool isQuit = !readFailed && (request.count == (int)strlen(BNC_SERVER_QUIT_REQUEST))
+				   && strncmp(request.data, BNC_SERVER_QUIT_REQUEST, request.count) == 0;
+		if (isQuit) {
+			close(clientFd);
+			break;
+		}
+
+		if (request.count > 0 && !readFailed) {
+			const BNCServerCacheEntry* entry = server.HandleRequest(request.data, request.count);
+			const char* status = entry->failed ? BNC_SERVER_STATUS_FAILED : BNC_SERVER_STATUS_OK;
+			if (WriteAll(clientFd, status, strlen(status))) {
+				WriteAll(clientFd, entry->output.data, entry->output.count);
+			}
+		}
+
+		close(clientFd);
+	}
+
+	close(listenFd);
+	unlink(socketPath);
+	return 0;
+}
+
+int RunCompileClient(const char* socketPath, int argCount, char** args) {
+	const char* fileName = "test1.bnc";
+	bool isQuit = false;
+
+	// Options are forwarded as given, options with an operand are found by parsing them
+	CompilerOptions scratchOptions;
+	Vector<int> optionArgIndices;
+	for (int i = 0; i < argCount; i++) {
+		int optionStart = i;
+		if (StrEqual(args[i], "-quit")) {
+			isQuit = true;
+		}
+		else if (StrEqual(args[i], "-shards") || StrEqual(args[i], "-out")) {
+			printf("Error: '%s' isn't supported by the compile server, run the compiler directly.\n", args[i]);
+			return 1;
+		}
+		else if (ParseCompilerOption(args, argCount, &i, &scratchOptions)) {
+			for (int j = optionStart; j <= i; j++) {
+				optionArgIndices.PushBack(j);
+			}
+		}
+		else {
+			fileName = args[i];
+		}
+	}
+
+	if (scratchOptions.hasInvalidOperand) {
+		return 1;
+	}
+
+	Vector<char> request;
+	if (isQuit) {
+		for (const char* c = BNC_SERVER_QUIT_REQUEST; *c != '\0'; c++) {
+			request.PushBack(*c);
+		}
+	}
+	else {
+		// The server has its own working directory, so paths are sent absolute
+		char absolutePath[PATH_MAX];
+		const char* path = (realpath(fileName, absolutePath) != nullptr) ? absolutePath : fileName;
+		for (const char* c = path; *c != '\0'; c++) {
+			request.PushBack(*c);
+		}
+
+		BNS_VEC_FOREACH(optionArgIndices) {
+			request.PushBack('\t');
+			for (const char* c = args[*ptr]; *c != '\0'; c++) {
+				request.PushBack(*c);
+			}
+		}
+	}
+	request.PushBack('\n');
+
+	struct sockaddr_un addr;
+	if (!FillSocketAddress(socketPath, &addr)) {
+		return 1;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		printf("Error: could not connect to compile server at '%s'.\n", socketPath);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return 1;
+	}
+
+	if (!WriteAll(fd, request.data, request.count)) {
+		printf("Error: could not send the request to the compile server.\n");
+		close(fd);
+		return 1;
+	}
+	shutdown(fd, SHUT_WR);
+
+	// The status line is read up to its newline, the output after it is passed straight through
+	Vector<char> status;
+	bool statusEnded = false;
+	char buffer[4096];
+	ssize_t readCount;
+	while ((readCount = read(fd, buffer, sizeof(buffer))) > 0 || (readCount < 0 && errno == EINTR)) {
+		ssize_t outputStart = 0;
+		while (!statusEnded && outputStart < readCount) {
+			status.PushBack(buffer[outputStart]);
+			statusEnded = (buffer[outputStart] == '\n');
+			outputStart++;
+		}
+
+		if (outputStart < readCount) {
+			fwrite(buffer + outputStart, 1, readCount - outputStart, stdout);
+		}
+	}
+
+	close(fd);
+
+	if (isQuit) {
+		return 0;
+	}
+
+	status.PushBack('\0');
+	if (!statusEnded) {
+		printf("Error: the compile server closed the connection without a response.\n");
+		return 1;
+	}
+
+	return StrEqual(status.data, BNC_SERVER_STATUS_OK) ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#pragma once
+
+#include "AST.h"
+#include "semantics.h"
+
+// Long-running compile server: keeps each request's output warm between requests, so repeated
+// builds only recompile files that changed. Only the output text is cached, a changed file is
+// compiled from scratch.
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BNC_SERVER_SUPPORTED 1
+#else
+#define BNC_SERVER_SUPPORTED 0
+#endif
+
+struct BNCServerCacheEntry {
+	// The request line, split in place into the file path and its compiler options.
+	// The options keep pointers into it, so it's never resized after parsing
+	Vector<char> request;
+	Vector<const char*> args;
+
+	CompilerOptions options;
+
+	long long modifiedTime;
+	unsigned long long contentHash;
+
+	// Diagnostics followed by the emitted C, exactly as sent to clients
+	Vector<char> output;
+
+	// Set when the file couldn't be read or the compiler crashed on it, so clients exit non-zero.
+	// Errors in the program itself are part of a successful compile, as on the command line
+	bool failed;
+};
+
+struct BNCCompileServer {
+	// Entries are heap-allocated since their options point into their own request
+	Vector<BNCServerCacheEntry*> cache;
+
+	~BNCCompileServer();
+
+	// Returns the cached entry for a request line, recompiling if the file changed
+	const BNCServerCacheEntry* HandleRequest(const char* requestLine, int requestLen);
+};
+
+// Serves requests on a Unix socket until a client sends the quit request
+int RunCompileServer(const char* socketPath);
+
+// Sends the file name and compiler options in args to a running server, printing its output.
+// Returns non-zero if the server couldn't be reached, or couldn't read or compile the file
+int RunCompileClient(const char* socketPath, int argCount, char** args);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef BNC_TEST_H
+#define BNC_TEST_H
+
+#pragma once
+
+// Shared by the drivers in tests/. Each one is its own unity build of the compiler, the same
+// way src/main.cpp is, so it can reach internals that the command line doesn't expose.
+// tests/run_tests.sh builds and runs all of them.
+
+#include <stdio.h>
+
+#include "../src/AST.cpp"
+#include "../src/semantics.cpp"
+#include "../src/ir.cpp"
+#include "../src/backend.cpp"
+#include "../src/bytecode.cpp"
+#include "../src/jit.cpp"
+#include "../src/formula.cpp"
+#include "../src/server.cpp"
+#include "../CppUtils/vector.cpp"
+#include "../CppUtils/assert.cpp"
+#include "../CppUtils/strings.cpp"
+#include "../CppUtils/lexer.cpp"
+
+static int bncTestChecks = 0;
+static int bncTestFailures = 0;
+
+// Unlike ASSERT, a failed check is reported and the driver carries on to the next one
+#define CHECK(cond) do { \
+	bncTestChecks++; \
+	if (!(cond)) { \
+		bncTestFailures++; \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+	} \
+} while(0)
+
+// Reads everything written to a file opened for update (e.g. with tmpfile), then closes it
+static void ReadAndCloseFile(FILE* file, Vector<char>* outContents) {
+	outContents->Clear();
+	rewind(file);
+	char chunk[4096];
+	size_t readCount;
+	while ((readCount = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		for (size_t i = 0; i < readCount; i++) {
+			outContents->PushBack(chunk[i]);
+		}
+	}
+	fclose(file);
+}
+
+static int FinishTests(const char* name) {
+	printf("%s: %d of %d checks passed\n", name, bncTestChecks - bncTestFailures, bncTestChecks);
+	return (bncTestFailures == 0) ? 0 : 1;
+}
+
+#endif
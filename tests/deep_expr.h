@@ -0,0 +1,62 @@
+#ifndef DEEP_EXPR_H
+#define DEEP_EXPR_H
+
+#pragma once
+
+// Generates the machine-written programs deep_expr_test and deep_expr_bench compile: a single
+// expression with as many terms as asked for, which is as deep as it is long once parsed
+
+enum DeepExprShape {
+	// 'return a + b * a - b + ...' in a function, cycling through +, * and -
+	DES_MixedOps,
+	// 'return a + b + a + ...' in a function
+	DES_Sum,
+	// 'int[1 + 2 * 3 - 5 + ...]' as a struct field's array length, folded at compile time.
+	// Each full '+ 2 * 3 - 5' group adds one, so 1 + 3k terms (e.g. any power of ten) give a length of k + 1
+	DES_ArrayLength,
+	DES_Count
+};
+
+static const char* deepExprShapeNames[DES_Count] = { "mixed", "sum", "length" };
+
+static void AppendText(Vector<char>* text, const char* str) {
+	for (const char* c = str; *c != '\0'; c++) {
+		text->PushBack(*c);
+	}
+}
+
+// Fills text with the null-terminated source
+static void MakeDeepExprProgram(DeepExprShape shape, int termCount, Vector<char>* outText) {
+	static const char* const mixedOps[] = { " + ", " * ", " - " };
+	static const char* const lengthOperands[] = { "2", "3", "5" };
+
+	Vector<char>& text = *outText;
+	text.Clear();
+	text.EnsureCapacity(termCount * 4 + 128);
+	if (shape == DES_ArrayLength) {
+		AppendText(&text, "buffer :: struct {\n\titems: int[1");
+	}
+	else {
+		AppendText(&text, "f :: (a: int, b: int) -> int {\n\treturn a");
+	}
+
+	for (int i = 1; i < termCount; i++) {
+		AppendText(&text, (shape == DES_Sum) ? " + " : mixedOps[(i - 1) % 3]);
+		if (shape == DES_ArrayLength) {
+			AppendText(&text, lengthOperands[(i - 1) % 3]);
+		}
+		else {
+			AppendText(&text, (i % 2 == 0) ? "a" : "b");
+		}
+	}
+
+	if (shape == DES_ArrayLength) {
+		AppendText(&text, "];\n}\n\nbufferSize: int = size_of(buffer);\n");
+	}
+	else {
+		AppendText(&text, ";\n}\n");
+	}
+	text.PushBack('\0');
+}
+
+#endif
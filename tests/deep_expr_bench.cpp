@@ -0,0 +1,114 @@
+#include "bnc_test.h"
+#include "deep_expr.h"
+
+// Times each pass over single expressions of 1k to 1M terms. Run with tests/run_tests.sh -bench,
+// or write one of the inputs out with 'deep_expr_bench -emit <mixed|sum|length> <terms>'
+// to time another build of the compiler on exactly the same source.
+//
+// Recorded on a single-core x86-64 Linux VM, g++ -O2, ms (the median run of three):
+//
+//   shape     terms    parse  fixup  semantics  output C    total
+//   mixed      1000      0.4    0.0        0.1       0.1      0.7
+//   mixed     10000      4.1    0.2        1.0       1.2      6.4
+//   mixed    100000     42.1    2.4       11.3      10.3     66.1
+//   mixed   1000000    405.3   26.1      123.5     114.9    669.8
+//   sum        1000      0.4    0.0        0.1       0.1      0.6
+//   sum       10000      3.9    0.1        1.0       1.0      6.0
+//   sum      100000     39.6    2.2       10.5       9.7     62.0
+//   sum     1000000    414.2   25.6      127.3     152.6    719.7
+//   length     1000      0.2    0.0        0.1       0.2      0.5
+//   length    10000      2.8    0.3        0.7       1.4      5.2
+//   length   100000     26.4    3.3        6.9      13.8     50.4
+//   length  1000000    219.4   33.4       97.2     155.2    505.3
+//
+// Against the recursive passes these replaced (built from 4e22ed2^ with the same flags), as
+// whole runs of the command-line compiler on -emit input, ms (median of three). Both include
+// DisplayTree, which is most of the time at 1M terms:
+//
+//   shape     terms    recursive    iterative
+//   mixed        22           15          <10
+//   mixed        28          128          <10
+//   mixed        34         2266          <10
+//   mixed        40       >30000          <10
+//   mixed     10000       >30000           40
+//   mixed    100000      crashed          393
+//   mixed   1000000      crashed         3696
+//   sum          22          304          <10
+//   sum          28        17097          <10
+//   sum          34       >60000          <10
+//   sum       10000       >30000           36
+//   sum      100000      crashed          346
+//   sum     1000000      crashed         3396
+//   length       22           11          <10
+//   length       28          116          <10
+//   length       34         2081          <10
+//   length    10000       >30000           33
+//   length   100000      crashed          302
+//   length  1000000      crashed         3157
+//
+// Re-associating the right-leaning chain the old parser built was exponential in the number
+// of terms, so 30-odd terms already took seconds. The crashes at 100k terms are the parser's
+// recursion overflowing the native stack.
+
+static double MillisecondsSince(long long start) {
+	return (double)(GetProfilerTimestampNanoseconds() - start) / 1000000.0;
+}
+
+static void BenchmarkProgram(DeepExprShape shape, int termCount) {
+	Vector<char> text;
+	MakeDeepExprProgram(shape, termCount, &text);
+	String source = text.data;
+
+	FILE* outputFile = tmpfile();
+	ASSERT(outputFile != nullptr);
+
+	SemanticContext sc;
+	sc.diagnosticsFile = outputFile;
+
+	long long start = GetProfilerTimestampNanoseconds();
+	AST ast;
+	ast.ConstructFromString(source);
+	double parseTime = MillisecondsSince(start);
+
+	start = GetProfilerTimestampNanoseconds();
+	FixUpOperators(&ast.nodes.Back());
+	double fixupTime = MillisecondsSince(start);
+
+	start = GetProfilerTimestampNanoseconds();
+	DoSemantics(&ast, &sc);
+	double semanticsTime = MillisecondsSince(start);
+
+	start = GetProfilerTimestampNanoseconds();
+	OutputASTToCCode(&ast.nodes.Back(), &sc, outputFile);
+	double outputTime = MillisecondsSince(start);
+
+	fclose(outputFile);
+
+	printf("  %-7s %7d  %7.1f %6.1f %10.1f %9.1f %8.1f\n", deepExprShapeNames[shape], termCount,
+		parseTime, fixupTime, semanticsTime, outputTime, parseTime + fixupTime + semanticsTime + outputTime);
+}
+
+int main(int argc, char** argv) {
+	if (argc == 4 && StrEqual(argv[1], "-emit")) {
+		for (int shape = 0; shape < DES_Count; shape++) {
+			if (StrEqual(argv[2], deepExprShapeNames[shape])) {
+				Vector<char> text;
+				MakeDeepExprProgram((DeepExprShape)shape, Atoi(argv[3]), &text);
+				fputs(text.data, stdout);
+				return 0;
+			}
+		}
+
+		return 1;
+	}
+
+	printf("deep_expr_bench: ms per compile\n");
+	printf("  %-7s %7s  %7s %6s %10s %9s %8s\n", "shape", "terms", "parse", "fixup", "semantics", "output C", "total");
+	for (int shape = 0; shape < DES_Count; shape++) {
+		for (int termCount = 1000; termCount <= 1000000; termCount *= 10) {
+			BenchmarkProgram((DeepExprShape)shape, termCount);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include "bnc_test.h"
+#include "deep_expr.h"
+
+#include <string.h>
+
+// Compiles single expressions of a million terms, deep enough that any pass still recursing
+// once per term would overflow the native stack, and checks what comes out of them
+
+#define DEEP_EXPR_TERM_COUNT 1000000
+
+static void CompileDeepExpr(DeepExprShape shape, int termCount, const char* option, Vector<char>* outOutput) {
+	Vector<char> text;
+	MakeDeepExprProgram(shape, termCount, &text);
+	String source = text.data;
+
+	SemanticContext sc;
+	if (option != nullptr) {
+		int index = 0;
+		CHECK(ParseCompilerOption(&option, 1, &index, &sc.options));
+	}
+
+	FILE* outputFile = tmpfile();
+	ASSERT(outputFile != nullptr);
+	sc.diagnosticsFile = outputFile;
+
+	AST ast;
+	ast.ConstructFromString(source);
+	FixUpOperators(&ast.nodes.Back());
+	DoSemantics(&ast, &sc);
+	OutputASTToCCode(&ast.nodes.Back(), &sc, outputFile);
+
+	ReadAndCloseFile(outputFile, outOutput);
+	outOutput->PushBack('\0');
+}
+
+static bool HasDiagnostics(const Vector<char>& output) {
+	return strstr(output.data, "Error") != nullptr || strstr(output.data, "Failed") != nullptr;
+}
+
+// Checks that f's return statement came out with every term, in order and unparenthesised
+static void CheckFunctionOutput(DeepExprShape shape, const Vector<char>& output) {
+	CHECK(!HasDiagnostics(output));
+
+	const char* expr = strstr(output.data, "return ");
+	CHECK(expr != nullptr);
+	if (expr == nullptr) {
+		return;
+	}
+	expr += strlen("return ");
+
+	static const char mixedOps[] = { '+', '*', '-' };
+	int termCount = 0;
+	bool isInOrder = true;
+	for (const char* c = expr; *c != ';' && *c != '\0'; c++) {
+		if (*c == 'a' || *c == 'b') {
+			isInOrder &= (*c == ((termCount % 2 == 0) ? 'a' : 'b'));
+			termCount++;
+		}
+		else {
+			char expectedOp = (shape == DES_Sum) ? '+' : mixedOps[(termCount - 1) % 3];
+			isInOrder &= (*c == expectedOp);
+		}
+	}
+
+	CHECK(isInOrder);
+	CHECK(termCount == DEEP_EXPR_TERM_COUNT);
+}
+
+int main() {
+	Vector<char> output;
+
+	CompileDeepExpr(DES_MixedOps, DEEP_EXPR_TERM_COUNT, nullptr, &output);
+	CheckFunctionOutput(DES_MixedOps, output);
+
+	CompileDeepExpr(DES_Sum, DEEP_EXPR_TERM_COUNT, nullptr, &output);
+	CheckFunctionOutput(DES_Sum, output);
+
+	CompileDeepExpr(DES_MixedOps, DEEP_EXPR_TERM_COUNT, "-inline", &output);
+	CheckFunctionOutput(DES_MixedOps, output);
+
+	// Folded at compile time, through each way the compiler can evaluate an expression
+	char expectedSize[64];
+	snprintf(expectedSize, sizeof(expectedSize), "int bufferSize = %d;", 4 * ((DEEP_EXPR_TERM_COUNT - 1) / 3 + 1));
+
+	const char* lengthOptions[] = { nullptr, "-opt-bytecode", "-jit", "-ssa", "-profile-bytecode" };
+	for (int i = 0; i < BNS_ARRAY_COUNT(lengthOptions); i++) {
+		CompileDeepExpr(DES_ArrayLength, DEEP_EXPR_TERM_COUNT, lengthOptions[i], &output);
+		CHECK(!HasDiagnostics(output));
+		CHECK(strstr(output.data, expectedSize) != nullptr);
+	}
+
+	return FinishTests("deep_expr_test");
+}
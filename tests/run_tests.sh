@@ -0,0 +1,36 @@
+#!/bin/sh
+# Builds every tests/*_test.cpp driver as its own unity build and runs it, then does the same
+# for tests/*_bench.cpp when given -bench. Exits non-zero if any driver fails to build or run.
+cd "$(dirname "$0")" || exit 1
+mkdir -p build
+
+CXX="${CXX:-g++}"
+CXXFLAGS="${CXXFLAGS:--std=c++11 -O2 -g -DBNS_DEBUG -pthread}"
+# Benchmarks are timed without the debug checks
+BENCHFLAGS="${BENCHFLAGS:--std=c++11 -O2 -pthread}"
+
+drivers=$(ls *_test.cpp)
+if [ "$1" = "-bench" ]; then
+	drivers="$drivers $(ls *_bench.cpp)"
+fi
+
+failed=0
+for driver in $drivers; do
+	name="${driver%.cpp}"
+	flags="$CXXFLAGS"
+	case "$name" in
+		*_bench) flags="$BENCHFLAGS" ;;
+	esac
+
+	if ! $CXX $flags "$driver" -o "build/$name"; then
+		echo "$name: failed to build"
+		failed=1
+		continue
+	fi
+
+	if ! "./build/$name"; then
+		failed=1
+	fi
+done
+
+exit $failed
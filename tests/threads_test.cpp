@@ -0,0 +1,175 @@
+#include "bnc_test.h"
+
+#include <string.h>
+
+#include <thread>
+
+// Stress test for the guarantees documented above SemanticContext: every core compiles and
+// evaluates programs at once, each compile with its own AST and context, and all of them
+// sharing one read-only BNCFormula. Every result has to match the one computed serially first.
+
+#define THREAD_TEST_PROGRAM_COUNT 48
+#define THREAD_TEST_ROUNDS 6
+#define THREAD_TEST_ROW_COUNT 4096
+
+// Array lengths, size_of and offset_of all go through the compile-time VM, and the options
+// cover its JIT, bytecode optimizer and IR paths as well as the backend's
+static const char* threadTestOptionSets[][3] = {
+	{ nullptr },
+	{ "-jit", nullptr },
+	{ "-opt-bytecode", "-ssa", nullptr },
+	{ "-inline", "-purity-attrs", nullptr },
+	{ "-bounds-checks", "-reorder-fields", nullptr },
+	{ "-dce", "-export", "twice" }
+};
+
+static void MakeProgramSource(int index, String* outSource) {
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer),
+		"point :: struct {\n"
+		"\tx: float;\n"
+		"\ty: float;\n"
+		"}\n\n"
+		"buffer :: struct {\n"
+		"\titems: int[%d * 2 + 1];\n"
+		"\tpts: point[size_of(point) / 4 + %d];\n"
+		"\ttag: int;\n"
+		"}\n\n"
+		"bufferSize: int = size_of(buffer);\n"
+		"ptsOffset: int = offset_of(buffer, pts);\n\n"
+		"scale :: (a: int) -> int {\n"
+		"\treturn a * %d + %d;\n"
+		"}\n\n"
+		"combine :: (a: int, b: float) -> float {\n"
+		"\tp: point;\n"
+		"\tp.x = b * %d.5;\n"
+		"\treturn p.x + b;\n"
+		"}\n\n"
+		"twice :: (a: int) -> int {\n"
+		"\treturn scale(a) + scale(%d);\n"
+		"}\n",
+		index + 1, index % 5, index, 100 - index, index % 7, index * 3);
+
+	*outSource = buffer;
+}
+
+// Compiles the way the command line does, but with diagnostics and output captured
+static void CompileProgram(int index, Vector<char>* outOutput) {
+	SemanticContext sc;
+	const char** optionSet = threadTestOptionSets[index % BNS_ARRAY_COUNT(threadTestOptionSets)];
+	int optionCount = 0;
+	while (optionCount < 3 && optionSet[optionCount] != nullptr) {
+		optionCount++;
+	}
+
+	for (int i = 0; i < optionCount; i++) {
+		ParseCompilerOption(optionSet, optionCount, &i, &sc.options);
+	}
+
+	FILE* outputFile = tmpfile();
+	ASSERT(outputFile != nullptr);
+	sc.diagnosticsFile = outputFile;
+
+	String source;
+	MakeProgramSource(index, &source);
+
+	AST ast;
+	ast.ConstructFromString(source);
+	FixUpOperators(&ast.nodes.Back());
+	DoSemantics(&ast, &sc);
+	OutputASTToCCode(&ast.nodes.Back(), &sc, outputFile);
+
+	ReadAndCloseFile(outputFile, outOutput);
+}
+
+static bool AreOutputsEqual(const Vector<char>& a, const Vector<char>& b) {
+	return a.count == b.count && memcmp(a.data, b.data, a.count) == 0;
+}
+
+struct ThreadTestShared {
+	Vector<char> expectedOutputs[THREAD_TEST_PROGRAM_COUNT];
+
+	BNCFormula formula;
+	int priceColumn[THREAD_TEST_ROW_COUNT];
+	int quantityColumn[THREAD_TEST_ROW_COUNT];
+	int expectedColumn[THREAD_TEST_ROW_COUNT];
+};
+
+// Each worker counts its own mismatches, since CHECK's counters aren't atomic
+static void RunWorker(const ThreadTestShared* shared, int threadIndex, int* outFailures) {
+	int failures = 0;
+	Vector<char> output;
+	BNCBytecodeVMState state;
+	int resultColumn[THREAD_TEST_ROW_COUNT];
+
+	for (int round = 0; round < THREAD_TEST_ROUNDS; round++) {
+		for (int i = 0; i < THREAD_TEST_PROGRAM_COUNT; i++) {
+			// Threads start at different programs, so different programs are compiled concurrently
+			int programIndex = (i + threadIndex * 7) % THREAD_TEST_PROGRAM_COUNT;
+			CompileProgram(programIndex, &output);
+			if (!AreOutputsEqual(output, shared->expectedOutputs[programIndex])) {
+				failures++;
+			}
+		}
+
+		const void* columns[] = { shared->priceColumn, shared->quantityColumn };
+		EvaluateFormulaBatch(&shared->formula, columns, THREAD_TEST_ROW_COUNT, resultColumn);
+		for (int row = 0; row < THREAD_TEST_ROW_COUNT; row++) {
+			BNCCompactValue inputs[] = { CompactInt(shared->priceColumn[row]), CompactInt(shared->quantityColumn[row]) };
+			state.stack.Clear();
+			BNCBytecodeValue val = EvaluateFormulaRow(&shared->formula, inputs, &state);
+			if (resultColumn[row] != shared->expectedColumn[row] || val.AsBNCByteCodeInt() != shared->expectedColumn[row]) {
+				failures++;
+			}
+		}
+	}
+
+	*outFailures = failures;
+}
+
+int main() {
+	ThreadTestShared* shared = new ThreadTestShared();
+
+	// The expected results are all computed on this thread before any workers start
+	for (int i = 0; i < THREAD_TEST_PROGRAM_COUNT; i++) {
+		CompileProgram(i, &shared->expectedOutputs[i]);
+		CHECK(shared->expectedOutputs[i].count > 0);
+	}
+
+	const char* inputNames[] = { "price", "quantity" };
+	BNCCompactValueTag inputTypes[] = { BNCCVT_Int, BNCCVT_Int };
+	CHECK(CompileFormula("price * quantity - price / (quantity - 3) + 7", inputNames, inputTypes, 2, &shared->formula));
+	for (int row = 0; row < THREAD_TEST_ROW_COUNT; row++) {
+		shared->priceColumn[row] = row * 37 - 5000;
+		shared->quantityColumn[row] = row % 11;
+	}
+	const void* columns[] = { shared->priceColumn, shared->quantityColumn };
+	EvaluateFormulaBatch(&shared->formula, columns, THREAD_TEST_ROW_COUNT, shared->expectedColumn);
+
+	int threadCount = (int)std::thread::hardware_concurrency();
+	if (threadCount < 4) {
+		threadCount = 4;
+	}
+
+	Vector<std::thread*> threads;
+	Vector<int> failures;
+	failures.EnsureCapacity(threadCount);
+	for (int i = 0; i < threadCount; i++) {
+		failures.PushBack(0);
+	}
+	for (int i = 0; i < threadCount; i++) {
+		threads.PushBack(new std::thread(RunWorker, shared, i, &failures.data[i]));
+	}
+
+	for (int i = 0; i < threadCount; i++) {
+		threads.data[i]->join();
+		delete threads.data[i];
+		CHECK(failures.data[i] == 0);
+	}
+
+	printf("threads_test: %d threads, %d compiles and %d formula rows each\n", threadCount,
+		THREAD_TEST_ROUNDS * THREAD_TEST_PROGRAM_COUNT, THREAD_TEST_ROUNDS * THREAD_TEST_ROW_COUNT);
+
+	delete shared;
+	return FinishTests("threads_test");
+}